@@ -0,0 +1,121 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file BenchBtmNodeM.cpp
+ * @brief Benchmark of bottom node types of M-tree (BtmNodeM_StepCode vs BtmNodeM_Plain) on OnlineRlbwt.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ */
+#include <stdint.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cmdline.h"
+#include "OnlineRlbwt.hpp"
+#include "DynRleForRlbwt.hpp"
+
+
+using namespace itmmti;
+
+namespace {
+  double elapsedSec
+  (
+   const std::chrono::high_resolution_clock::time_point t1
+   ) {
+    auto t2 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+  }
+
+
+  /*!
+   * @brief Build RLBWT of "text" with bottom node type "BtmNodeMT" of M-tree, and measure construction, access and LF.
+   * @note Checksums of queries should coincide among node types.
+   */
+  template <typename BtmNodeMT>
+  void runBench
+  (
+   const char * name,
+   const std::vector<unsigned char> & text,
+   const uint64_t numQueries
+   ) {
+    using BTreeNodeT = typename BtmNodeMT::BTreeNodeT;
+    using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>;
+    using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, 8>;
+    using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>;
+    using DynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_Null, BtmMInfoT, BtmSInfoT>;
+    OnlineRlbwt<DynRleT> rlbwt(1);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (const auto uc : text) {
+      rlbwt.extend(uint8_t(uc));
+    }
+    const double secBuild = elapsedSec(t1);
+    const uint64_t n = rlbwt.getLenWithEndmarker();
+
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<uint64_t> dist(0, n - 1);
+    uint64_t sumAccess = 0;
+    t1 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      sumAccess += rlbwt[dist(rng)];
+    }
+    const double secAccess = elapsedSec(t1);
+
+    uint64_t pos = 0;
+    uint64_t sumLf = 0;
+    t1 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      pos = rlbwt.lfMap(pos);
+      sumLf += pos;
+    }
+    const double secLf = elapsedSec(t1);
+
+    std::cout << name << ": runs = " << rlbwt.calcNumRuns() << ", bytes = " << rlbwt.calcMemBytes()
+              << ", build = " << secBuild << " sec"
+              << ", access = " << secAccess * 1e9 / numQueries << " ns/query"
+              << ", lf = " << secLf * 1e9 / numQueries << " ns/query"
+              << ", checksums = " << sumAccess << " " << sumLf << std::endl;
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  cmdline::parser parser;
+  parser.add<std::string>("input",'i', "input file name", true);
+  parser.add<uint64_t>("queries", 'q', "num of queries for access and LF", false, 1000000);
+  parser.add("help", 0, "print help");
+
+  parser.parse_check(argc, argv);
+  const std::string in = parser.get<std::string>("input");
+  const uint64_t numQueries = parser.get<uint64_t>("queries");
+
+  std::ifstream ifs(in, std::ios::in | std::ios::binary);
+  if (!ifs) {
+    std::cerr << "error: failed to open " << in << std::endl;
+    exit(1);
+  }
+  const std::vector<unsigned char> text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  ifs.close();
+  if (text.empty() || numQueries == 0) {
+    std::cerr << "error: input and num of queries should be non-empty" << std::endl;
+    exit(1);
+  }
+  std::cout << "input = " << in << ", len = " << text.size() << ", queries = " << numQueries
+            << ", scan kernels = " << scankernels::getImplName() << std::endl;
+
+  using BTreeNodeT = BTreeNode<32>;
+  runBench<BtmNodeM_StepCode<BTreeNodeT, 32>>("BtmNodeM_StepCode", text, numQueries);
+  runBench<BtmNodeM_Plain<BTreeNodeT, 32>>("BtmNodeM_Plain", text, numQueries);
+  runBench<BtmNodeM_Plain<BTreeNodeT, 32, uint64_t>>("BtmNodeM_Plain(64bit)", text, numQueries);
+}
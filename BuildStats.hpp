@@ -0,0 +1,315 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file BuildStats.hpp
+ * @brief Hot-path counters of ::DynRleForRlbwt and ::OnlineRlbwt, and periodic emission of construction statistics in JSON or CSV.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Counters are compiled in only when ONLINE_RLBWT_COUNTERS is defined (e.g., "cmake -DRLBWT_COUNTERS=ON").
+ *   Otherwise ::HotCountersT is an empty class whose "inc" is a no-op, so that it costs nothing on hot paths.
+ */
+#ifndef INCLUDE_GUARD_BuildStats
+#define INCLUDE_GUARD_BuildStats
+
+#include <stdint.h>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+namespace itmmti
+{
+    /*!
+     * @brief Events counted on hot paths.
+     */
+    enum class HotCounter : uint8_t
+    {
+        kSearchPosM,        //!< Calls of DynRleForRlbwt::searchPosM.
+        kDescentDepthM,     //!< Sum of depths of M-tree descents in searchPosM (average depth = this / kSearchPosM).
+        kFingerHitM,        //!< searchPosM with finger answered in btmM of finger (no descent).
+        kInsertRun,         //!< Calls of DynRleForRlbwt::insertRun (at idxM).
+        kInsertRunMerge,    //!< insertRun merged into current or previous run.
+        kInsertRunSplit,    //!< insertRun split a run.
+        kOptInsert,         //!< Calls of optInsert or extendAndAdvance with non-empty interval.
+        kOptInsertExtend,   //!< Fast path of optInsert extending an existing run of the character.
+        kPushbackRun,       //!< Runs appended at the end.
+        kSplitBtmM,         //!< Splits of bottom nodes of M-tree.
+        kOverflowToLeftM,   //!< Rebalances of bottom nodes of M-tree to left siblings.
+        kOverflowToRightM,  //!< Rebalances of bottom nodes of M-tree to right siblings.
+        kAsgnLabel,         //!< Calls of asgnLabel for new bottom nodes of M-tree.
+        kRelabel,           //!< Bottom nodes relabeled by asgnLabel when there is no free label.
+        kSptExtend,         //!< Calls of OnlineRlbwt::sptExtend.
+        kSptSeparator,      //!< Separators appended by OnlineRlbwt::sptExtend.
+        kNum
+    };
+
+    inline const char *getHotCounterName(
+        const HotCounter c) noexcept
+    {
+        static const char *const kNames[] = {
+            "search_pos_m", "descent_depth_m", "finger_hit_m", "insert_run", "insert_run_merge", "insert_run_split",
+            "opt_insert", "opt_insert_extend", "pushback_run", "split_btm_m",
+            "overflow_to_left_m", "overflow_to_right_m", "asgn_label", "relabel",
+            "spt_extend", "spt_separator"};
+        static_assert(sizeof(kNames) / sizeof(kNames[0]) == static_cast<size_t>(HotCounter::kNum), "names of HotCounter");
+        return kNames[static_cast<uint8_t>(c)];
+    }
+
+    /*!
+     * @brief Counters of ::HotCounter events (enabled if "kEnabled").
+     * @note
+     *   Counters are per object and relaxed atomics, since some of them (e.g., kSearchPosM) are counted by const queries,
+     *   which may run in parallel on the same object (e.g., ::RindexBatchQuery.hpp and ::SnapshotIndex).
+     *   Copies take values at the time (not atomically as a whole).
+     */
+    template <bool kEnabled>
+    class HotCounters
+    {
+        mutable std::atomic<uint64_t> vals_[static_cast<size_t>(HotCounter::kNum)];
+
+    public:
+        static constexpr bool kIsEnabled{true};
+
+        HotCounters() noexcept
+        {
+            reset();
+        }
+
+        HotCounters(
+            const HotCounters &other) noexcept
+        {
+            *this = other;
+        }
+
+        HotCounters &operator=(
+            const HotCounters &other) noexcept
+        {
+            for (size_t i = 0; i < static_cast<size_t>(HotCounter::kNum); ++i)
+            {
+                vals_[i].store(other.vals_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            return *this;
+        }
+
+        void inc(
+            const HotCounter c,
+            const uint64_t val = 1) const noexcept
+        {
+            vals_[static_cast<uint8_t>(c)].fetch_add(val, std::memory_order_relaxed);
+        }
+
+        uint64_t get(
+            const HotCounter c) const noexcept
+        {
+            return vals_[static_cast<uint8_t>(c)].load(std::memory_order_relaxed);
+        }
+
+        void reset() noexcept
+        {
+            for (auto &v : vals_)
+            {
+                v.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /*!
+         * @brief Add counters of "other" (e.g., of merged shards).
+         */
+        void add(
+            const HotCounters &other) noexcept
+        {
+            for (size_t i = 0; i < static_cast<size_t>(HotCounter::kNum); ++i)
+            {
+                vals_[i].fetch_add(other.vals_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        }
+    };
+
+    template <>
+    class HotCounters<false>
+    {
+    public:
+        static constexpr bool kIsEnabled{false};
+
+        void inc(
+            const HotCounter,
+            const uint64_t = 1) const noexcept
+        {
+        }
+
+        uint64_t get(
+            const HotCounter) const noexcept
+        {
+            return 0;
+        }
+
+        void reset() noexcept
+        {
+        }
+
+        void add(
+            const HotCounters &) noexcept
+        {
+        }
+    };
+
+#ifdef ONLINE_RLBWT_COUNTERS
+    using HotCountersT = HotCounters<true>;
+#else
+    using HotCountersT = HotCounters<false>;
+#endif
+
+    /*!
+     * @brief Get current resident set size in bytes (0 if unavailable).
+     */
+    inline uint64_t getCurrentRssBytes() noexcept
+    {
+        uint64_t numPages = 0;
+        FILE *fp = std::fopen("/proc/self/statm", "r");
+        if (fp)
+        {
+            unsigned long long size, resident;
+            if (std::fscanf(fp, "%llu %llu", &size, &resident) == 2)
+            {
+                numPages = resident;
+            }
+            std::fclose(fp);
+        }
+        return numPages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    enum class StatsFormat : uint8_t
+    {
+        kText, //!< Human readable lines (as used to be printed by osptBWT).
+        kJson, //!< One JSON object per line.
+        kCsv,  //!< CSV with header line.
+    };
+
+    inline bool parseStatsFormat(
+        const std::string &str,
+        StatsFormat &format //!< [out]
+    )
+    {
+        if (str == "text")
+        {
+            format = StatsFormat::kText;
+        }
+        else if (str == "json")
+        {
+            format = StatsFormat::kJson;
+        }
+        else if (str == "csv")
+        {
+            format = StatsFormat::kCsv;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    /*!
+     * @brief Emitter of snapshots of construction statistics:
+     *        throughput (characters/sec since the previous snapshot), r, n/r, bytes/run, reserved bytes, RSS and hot counters (if enabled).
+     */
+    class StatsEmitter
+    {
+        std::ostream &os_;
+        StatsFormat format_;
+        uint64_t prevChars_;
+        double prevSec_;
+        bool isHeaderWritten_;
+
+    public:
+        StatsEmitter(
+            std::ostream &os,
+            const StatsFormat format) : os_(os),
+                                        format_(format),
+                                        prevChars_(0),
+                                        prevSec_(0.0),
+                                        isHeaderWritten_(false)
+        {
+        }
+
+        /*!
+         * @brief Emit a snapshot.
+         */
+        template <class CountersT>
+        void emit(
+            const uint64_t numSeqs,       //!< Num of sequences appended so far.
+            const uint64_t numChars,      //!< Num of characters (n) appended so far.
+            const uint64_t numRuns,       //!< Num of runs (r).
+            const uint64_t bytes,         //!< Memory usage of data structure.
+            const uint64_t reservedBytes, //!< "bytes" plus bytes reserved but not in use (e.g., by ::NodeArena).
+            const double elapsedSec,      //!< Elapsed time since construction started.
+            const CountersT &counters)   //!< ::HotCounters.
+        {
+            const double dt = elapsedSec - prevSec_;
+            const double throughput = (dt > 0) ? (numChars - prevChars_) / dt : 0.0;
+            const double nr = (numRuns) ? static_cast<double>(numChars) / numRuns : 0.0;
+            const double bpr = (numRuns) ? static_cast<double>(bytes) / numRuns : 0.0;
+            const uint64_t rss = getCurrentRssBytes();
+            prevChars_ = numChars;
+            prevSec_ = elapsedSec;
+            if (format_ == StatsFormat::kText)
+            {
+                os_ << "===================extend over=======================" << std::endl;
+                os_ << "cur_ns:" << numSeqs << "  cur_n:" << numChars << "  runs:" << numRuns
+                    << "  n/r:" << nr << "  bytes/run:" << bpr << "  reserved:" << reservedBytes << "  rss:" << rss << std::endl;
+                os_ << "Elapsed time in seconds: " << elapsedSec << "  (" << throughput << " chars/sec)" << std::endl;
+                if (CountersT::kIsEnabled)
+                {
+                    for (uint8_t i = 0; i < static_cast<uint8_t>(HotCounter::kNum); ++i)
+                    {
+                        os_ << ((i) ? "  " : "") << getHotCounterName(static_cast<HotCounter>(i)) << ":" << counters.get(static_cast<HotCounter>(i));
+                    }
+                    os_ << std::endl;
+                }
+            }
+            else if (format_ == StatsFormat::kJson)
+            {
+                os_ << "{\"num_seqs\": " << numSeqs << ", \"n\": " << numChars << ", \"r\": " << numRuns
+                    << ", \"n_per_r\": " << nr << ", \"bytes\": " << bytes << ", \"bytes_per_run\": " << bpr
+                    << ", \"reserved_bytes\": " << reservedBytes << ", \"rss\": " << rss << ", \"sec\": " << elapsedSec << ", \"chars_per_sec\": " << throughput;
+                if (CountersT::kIsEnabled)
+                {
+                    for (uint8_t i = 0; i < static_cast<uint8_t>(HotCounter::kNum); ++i)
+                    {
+                        os_ << ", \"" << getHotCounterName(static_cast<HotCounter>(i)) << "\": " << counters.get(static_cast<HotCounter>(i));
+                    }
+                }
+                os_ << "}" << std::endl;
+            }
+            else
+            {
+                if (!isHeaderWritten_)
+                {
+                    os_ << "num_seqs,n,r,n_per_r,bytes,bytes_per_run,reserved_bytes,rss,sec,chars_per_sec";
+                    for (uint8_t i = 0; CountersT::kIsEnabled && i < static_cast<uint8_t>(HotCounter::kNum); ++i)
+                    {
+                        os_ << "," << getHotCounterName(static_cast<HotCounter>(i));
+                    }
+                    os_ << std::endl;
+                    isHeaderWritten_ = true;
+                }
+                os_ << numSeqs << "," << numChars << "," << numRuns << "," << nr << "," << bytes << "," << bpr
+                    << "," << reservedBytes << "," << rss << "," << elapsedSec << "," << throughput;
+                for (uint8_t i = 0; CountersT::kIsEnabled && i < static_cast<uint8_t>(HotCounter::kNum); ++i)
+                {
+                    os_ << "," << counters.get(static_cast<HotCounter>(i));
+                }
+                os_ << std::endl;
+            }
+        }
+    };
+} // namespace itmmti
+
+#endif
@@ -0,0 +1,255 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file BwtWriter.hpp
+ * @brief Buffered block writer, reader of runs and output formats of (RL)BWT.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ */
+#ifndef INCLUDE_GUARD_BwtWriter
+#define INCLUDE_GUARD_BwtWriter
+
+#include <stdint.h>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace itmmti
+{
+    /*!
+     * @brief Output formats of BWT.
+     */
+    enum class BwtFormat : uint8_t
+    {
+        kPlain,       //!< Expanded BWT (one byte per character).
+        kRlePair,     //!< Sequence of (character byte, LEB128 varint of run length).
+        kHeadsLengths //!< Run heads (one byte per run) and run lengths (fixed-width little endian), written to two streams.
+    };
+
+    /*!
+     * @brief Parse name of BwtFormat ("plain", "rle" or "heads_lengths").
+     * @return false if "name" is unknown.
+     */
+    inline bool parseBwtFormat(
+        const std::string &name,
+        BwtFormat &format //!< [out]
+    )
+    {
+        if (name == "plain")
+        {
+            format = BwtFormat::kPlain;
+        }
+        else if (name == "rle")
+        {
+            format = BwtFormat::kRlePair;
+        }
+        else if (name == "heads_lengths")
+        {
+            format = BwtFormat::kHeadsLengths;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    /*!
+     * @brief Writer to std::ostream, which buffers bytes and writes them in large blocks.
+     */
+    class BlockWriter
+    {
+    public:
+        static constexpr size_t kDefaultBufBytes{static_cast<size_t>(1) << 20};
+
+    private:
+        std::ostream &os_;
+        std::vector<char> buf_;
+        size_t size_; //!< Current bytes in buf_.
+
+    public:
+        BlockWriter(
+            std::ostream &os,                      //!< Output stream.
+            const size_t bufBytes = kDefaultBufBytes //!< Size of buffer.
+            ) : os_(os),
+                buf_(bufBytes),
+                size_(0)
+        {
+            assert(bufBytes >= 16);
+        }
+
+        ~BlockWriter()
+        {
+            flush();
+        }
+
+        BlockWriter(const BlockWriter &) = delete;
+        BlockWriter &operator=(const BlockWriter &) = delete;
+
+        void flush()
+        {
+            if (size_)
+            {
+                os_.write(buf_.data(), static_cast<std::streamsize>(size_));
+                size_ = 0;
+            }
+        }
+
+        void putByte(
+            const uint8_t c)
+        {
+            if (size_ == buf_.size())
+            {
+                flush();
+            }
+            buf_[size_++] = static_cast<char>(c);
+        }
+
+        /*!
+         * @brief Put "c^{num}" with block fills.
+         */
+        void putRepeat(
+            const uint8_t c,
+            uint64_t num)
+        {
+            while (num)
+            {
+                if (size_ == buf_.size())
+                {
+                    flush();
+                }
+                const size_t len = (num < buf_.size() - size_) ? static_cast<size_t>(num) : buf_.size() - size_;
+                memset(buf_.data() + size_, c, len);
+                size_ += len;
+                num -= len;
+            }
+        }
+
+        /*!
+         * @brief Put "val" in LEB128 (7 bits per byte, least significant group first).
+         */
+        void putVarint(
+            uint64_t val)
+        {
+            if (buf_.size() - size_ < 10)
+            {
+                flush();
+            }
+            while (val >= 0x80)
+            {
+                buf_[size_++] = static_cast<char>((val & 0x7f) | 0x80);
+                val >>= 7;
+            }
+            buf_[size_++] = static_cast<char>(val);
+        }
+
+        /*!
+         * @brief Put lower "numBytes" bytes of "val" in little endian.
+         */
+        void putLittleEndian(
+            uint64_t val,
+            const uint8_t numBytes //!< in [1..8].
+        )
+        {
+            assert(1 <= numBytes && numBytes <= 8);
+
+            if (buf_.size() - size_ < numBytes)
+            {
+                flush();
+            }
+            for (uint8_t i = 0; i < numBytes; ++i)
+            {
+                buf_[size_++] = static_cast<char>(val & 0xff);
+                val >>= 8;
+            }
+        }
+    };
+
+    /*!
+     * @brief Read runs of BWT written in "format" (BwtFormat::kPlain or BwtFormat::kRlePair) from "is",
+     *        e.g., to give them to OnlineRlbwt::bulkLoadCollection.
+     * @return false if "format" is not supported or input is malformed.
+     * @note Adjacent runs of the same character are merged.
+     */
+    inline bool readBwtRuns(
+        std::istream &is,
+        const BwtFormat format,
+        std::vector<std::pair<uint8_t, uint64_t>> &runs //!< [out]
+    )
+    {
+        runs.clear();
+        auto pushRun = [&runs](const uint8_t ch, const uint64_t exponent)
+        {
+            if (!runs.empty() && runs.back().first == ch)
+            {
+                runs.back().second += exponent;
+            }
+            else if (exponent)
+            {
+                runs.emplace_back(ch, exponent);
+            }
+        };
+
+        std::vector<char> buf(UINT64_C(1) << 20);
+        if (format == BwtFormat::kPlain)
+        {
+            while (is)
+            {
+                is.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+                const auto num = static_cast<size_t>(is.gcount());
+                for (size_t i = 0; i < num; ++i)
+                {
+                    pushRun(static_cast<uint8_t>(buf[i]), 1);
+                }
+            }
+            return true;
+        }
+        if (format == BwtFormat::kRlePair)
+        {
+            uint8_t ch = 0;
+            uint64_t exponent = 0;
+            uint8_t shift = 0;
+            bool inVarint = false;
+            while (is)
+            {
+                is.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+                const auto num = static_cast<size_t>(is.gcount());
+                for (size_t i = 0; i < num; ++i)
+                {
+                    const auto byte = static_cast<uint8_t>(buf[i]);
+                    if (!inVarint)
+                    {
+                        ch = byte;
+                        exponent = 0;
+                        shift = 0;
+                        inVarint = true;
+                        continue;
+                    }
+                    if (shift > 63)
+                    {
+                        return false;
+                    }
+                    exponent |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    shift += 7;
+                    if (!(byte & 0x80))
+                    {
+                        pushRun(ch, exponent);
+                        inVarint = false;
+                    }
+                }
+            }
+            return !inVarint;
+        }
+        return false;
+    }
+} // namespace itmmti
+
+#endif
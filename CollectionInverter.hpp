@@ -0,0 +1,114 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file CollectionInverter.hpp
+ * @brief Multi-threaded inversion of BWT of collection of separator-terminated sequences (e.g., osptBWT).
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ */
+#ifndef INCLUDE_GUARD_CollectionInverter
+#define INCLUDE_GUARD_CollectionInverter
+
+#include <stdint.h>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace itmmti
+{
+    /*!
+     * @brief Invert BWT "srle" of concatenation of reversed sequences each terminated by a separator,
+     *        writing each sequence (in its original direction) followed by '\n' to "os".
+     * @return Num of sequences written.
+     * @note
+     *   "srle" should be static and thread-safe for const queries, and have "lfMap(pos, ch)" (e.g., ::StaticRleForRlbwt).
+     *   Characters <= "sep" are treated as separators, and so the first 'num of occ of characters <= sep' rows
+     *   of BWT are the entry points of sequences, each of which is decoded by LF steps independently.
+     *   Entry points are split into batches of "batchRows", and "numThreads" batches are decoded in parallel
+     *   and written in order, so that sequences appear in the order of their separators in BWT
+     *   (which is not necessarily the input order) and memory is bounded by the batches in flight.
+     *   Empty sequences are not written.
+     */
+    template <class SRle>
+    uint64_t invertCollection(
+        const SRle &srle,                              //!< BWT without implicit end marker.
+        const uint64_t sep,                            //!< Largest separator character.
+        std::ostream &os,                              //!< Output stream.
+        const unsigned numThreads,                     //!< Num of worker threads (0 for hardware concurrency).
+        const uint64_t batchRows = UINT64_C(1) << 14 //!< Num of entry points decoded by a thread at once.
+    )
+    {
+        using CharT = typename std::remove_reference<decltype(srle[0])>::type;
+        const uint64_t len = srle.getSumOfWeight();
+        if (len == 0)
+        {
+            return 0;
+        }
+        const uint64_t numRows = srle.rank(sep, len - 1, true);
+        const unsigned nt = (numThreads) ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+        const uint64_t numBatches = (numRows + batchRows - 1) / batchRows;
+
+        auto decodeBatch = [&srle, sep, len, batchRows, numRows](const uint64_t batch, std::vector<char> &buf, uint64_t &numSeqs)
+        {
+            buf.clear();
+            numSeqs = 0;
+            const uint64_t end = std::min(numRows, (batch + 1) * batchRows);
+            for (uint64_t row = batch * batchRows; row < end; ++row)
+            {
+                const size_t beg = buf.size();
+                uint64_t pos = row;
+                CharT ch;
+                for (uint64_t i = 0; i < len; ++i)
+                {
+                    const uint64_t next = srle.lfMap(pos, ch);
+                    if (static_cast<uint64_t>(ch) <= sep)
+                    {
+                        break;
+                    }
+                    buf.push_back(static_cast<char>(ch));
+                    pos = next;
+                }
+                if (buf.size() > beg)
+                {
+                    buf.push_back('\n');
+                    ++numSeqs;
+                }
+            }
+        };
+
+        std::vector<std::vector<char>> bufs(nt);
+        std::vector<uint64_t> nums(nt);
+        uint64_t numSeqs = 0;
+        for (uint64_t round = 0; round < numBatches; round += nt)
+        {
+            const unsigned numWorkers = static_cast<unsigned>(std::min<uint64_t>(nt, numBatches - round));
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < numWorkers; ++t)
+            {
+                workers.emplace_back(decodeBatch, round + t, std::ref(bufs[t]), std::ref(nums[t]));
+            }
+            decodeBatch(round, bufs[0], nums[0]);
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+            for (unsigned t = 0; t < numWorkers; ++t)
+            {
+                os.write(bufs[t].data(), static_cast<std::streamsize>(bufs[t].size()));
+                numSeqs += nums[t];
+            }
+        }
+        return numSeqs;
+    }
+} // namespace itmmti
+
+#endif
@@ -0,0 +1,321 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file CollectionMerger.hpp
+ * @brief Multi-threaded merging of BWTs of collections of separator-terminated sequences (e.g., shards of osptBWT).
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Rows of BWT (of OnlineRlbwt::sptExtend) are sorted by their contexts, i.e., reversed prefixes of sequences
+ *   up to separators, and the order of rows with the same context is arbitrary.
+ *   To merge BWT "b" into BWT "a", each row of "b" is assigned an insertion position of "a" within
+ *   the interval of rows of "a" having the same context. The interval is maintained along LF steps of each sequence of "b"
+ *   from its entry row, so that sequences are walked independently (and in parallel) like in invertCollection.
+ *   The result is equivalent to BWT of the union of collections: it is the same multiset of sequences when inverted.
+ */
+#ifndef INCLUDE_GUARD_CollectionMerger
+#define INCLUDE_GUARD_CollectionMerger
+
+#include <stdint.h>
+#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "StaticRleForRlbwt.hpp"
+
+namespace itmmti
+{
+    /*!
+     * @brief View of vector of runs having "forEachRun(func(ch, exponent))" (e.g., to build ::StaticRleForRlbwt).
+     */
+    template <typename CharT>
+    struct RunsView
+    {
+        const std::vector<std::pair<CharT, uint64_t>> &runs;
+
+        template <class Func>
+        void forEachRun(
+            Func &&func) const
+        {
+            for (const auto &run : runs)
+            {
+                func(run.first, run.second);
+            }
+        }
+    };
+
+    /*!
+     * @brief Counts of insertions at positions [0..size) incremented concurrently.
+     * @note
+     *   First insertion at a position sets its bit, and further ones are counted in hash maps split into "kNumShards"
+     *   shards (locked separately). So it takes 1 bit per position where at most one insertion is made,
+     *   which is the common case of merging BWTs, and counts are not bounded.
+     */
+    class InsertionCounts
+    {
+        static constexpr uint64_t kNumShards{64};
+
+        struct Shard
+        {
+            std::mutex mutex;
+            std::unordered_map<uint64_t, uint64_t> extra; //!< Position -> num of insertions minus one.
+        };
+
+        std::vector<std::atomic<uint64_t>> bits_; //!< Bit of position is set if one or more insertions are made there.
+        std::vector<Shard> shards_;
+
+    public:
+        explicit InsertionCounts(
+            const uint64_t size) : bits_((size + 63) / 64),
+                                   shards_(kNumShards)
+        {
+            for (auto &word : bits_)
+            {
+                word.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void inc(
+            const uint64_t pos)
+        {
+            const uint64_t mask = UINT64_C(1) << (pos % 64);
+            if (bits_[pos / 64].fetch_or(mask, std::memory_order_relaxed) & mask)
+            {
+                auto &shard = shards_[(pos * UINT64_C(0x9e3779b97f4a7c15)) >> 58]; // Fibonacci hashing to 64 shards.
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                ++shard.extra[pos];
+            }
+        }
+
+        /*!
+         * @brief Get count at "pos" (only after all increments are done).
+         */
+        uint64_t get(
+            const uint64_t pos) const
+        {
+            if (!((bits_[pos / 64].load(std::memory_order_relaxed) >> (pos % 64)) & 1))
+            {
+                return 0;
+            }
+            const auto &shard = shards_[(pos * UINT64_C(0x9e3779b97f4a7c15)) >> 58];
+            const auto it = shard.extra.find(pos);
+            return 1 + ((it == shard.extra.end()) ? 0 : it->second);
+        }
+    };
+
+    /*!
+     * @brief Merge BWTs "a" and "b" of collections of separator-terminated sequences into runs "runs".
+     * @note
+     *   "a" and "b" should be static and thread-safe for const queries (e.g., ::StaticRleForRlbwt),
+     *   and characters <= "sep" are treated as separators (as in invertCollection).
+     *   Within the interval of tied rows, a row of "b" with character c is inserted preferably next to c of "a"
+     *   (the first c in the interval, or c just before or after the interval) and otherwise at a run boundary of "a",
+     *   so that the run-minimal placement of sptExtend is kept as far as possible at merge boundaries.
+     *   Since rows of "b" inserted to the same interval are placed in their order in "b",
+     *   the placement is only heuristic when two or more rows of "b" share an interval.
+     *   Entry rows of "b" are split into batches of "batchRows", and "numThreads" threads walk batches in parallel.
+     *   Working space is 1 bit per row of "a" (marking rows before which rows of "b" are inserted, see ::InsertionCounts)
+     *   plus a 64-bit count per row of "a" before which two or more rows of "b" are inserted, in addition to runs of "b".
+     */
+    template <class SRle, typename CharT>
+    void mergeCollections(
+        const SRle &a,                                //!< BWT without implicit end marker.
+        const SRle &b,                                //!< BWT without implicit end marker.
+        const uint64_t sep,                           //!< Largest separator character.
+        std::vector<std::pair<CharT, uint64_t>> &runs, //!< [out] Runs of merged BWT.
+        const unsigned numThreads,                    //!< Num of worker threads (0 for hardware concurrency).
+        const uint64_t batchRows = UINT64_C(1) << 14 //!< Num of entry rows walked by a thread at once.
+    )
+    {
+        runs.clear();
+        auto push = [&runs](const CharT ch, const uint64_t exponent)
+        {
+            if (exponent == 0)
+            {
+                return;
+            }
+            if (!runs.empty() && runs.back().first == ch)
+            {
+                runs.back().second += exponent;
+            }
+            else
+            {
+                runs.emplace_back(ch, exponent);
+            }
+        };
+        const uint64_t lenA = a.getSumOfWeight();
+        const uint64_t lenB = b.getSumOfWeight();
+        if (lenA == 0 || lenB == 0)
+        {
+            ((lenA) ? a : b).forEachRun(push);
+            return;
+        }
+
+        InsertionCounts cnt(lenA + 1); // cnt.get(p) = num of rows of "b" inserted before p-th row of "a".
+        const uint64_t numEntriesA = a.countSmaller(sep + 1);
+        const uint64_t numEntriesB = b.countSmaller(sep + 1);
+        const uint64_t numBatches = (numEntriesB + batchRows - 1) / batchRows;
+        const unsigned nt = static_cast<unsigned>(std::min<uint64_t>(
+            (numThreads) ? numThreads : std::max(1u, std::thread::hardware_concurrency()), std::max<uint64_t>(numBatches, 1)));
+        std::atomic<uint64_t> nextBatch(0);
+
+        //// Num of occ of "ch" in a[0..pos).
+        auto rankBefore = [&a](const uint64_t ch, const uint64_t pos)
+        {
+            return (pos) ? a.rank(ch, pos - 1, false) : 0;
+        };
+        auto worker = [&]()
+        {
+            for (uint64_t batch = nextBatch++; batch < numBatches; batch = nextBatch++)
+            {
+                const uint64_t end = std::min(numEntriesB, (batch + 1) * batchRows);
+                for (uint64_t row = batch * batchRows; row < end; ++row)
+                {
+                    uint64_t pos = row;
+                    uint64_t lo = 0, hi = numEntriesA; // Rows of "a" in [lo..hi) have the same context as row "pos" of "b".
+                    CharT ch;
+                    for (uint64_t i = 0; i < lenB; ++i)
+                    {
+                        const uint64_t next = b.lfMap(pos, ch);
+                        const uint64_t rLo = rankBefore(ch, lo);
+                        const uint64_t rHi = (lo == hi) ? rLo : rankBefore(ch, hi);
+                        uint64_t p;
+                        if (rHi > rLo)
+                        {
+                            p = a.select(ch, rLo + 1);
+                        }
+                        else if (lo > 0 && a[lo - 1] == ch)
+                        {
+                            p = lo;
+                        }
+                        else if (hi < lenA && a[hi] == ch)
+                        {
+                            p = hi;
+                        }
+                        else if (lo == hi || lo == 0 || a[lo - 1] != a[lo])
+                        {
+                            p = lo;
+                        }
+                        else
+                        {
+                            p = std::min(hi, a.getRunEnd(lo));
+                        }
+                        cnt.inc(p);
+                        if (static_cast<uint64_t>(ch) <= sep)
+                        {
+                            break;
+                        }
+                        const uint64_t c = a.countSmaller(ch);
+                        lo = c + rLo;
+                        hi = c + rHi;
+                        pos = next;
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < nt; ++t)
+        {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+
+        //// Emit rows of "b" in their order, cnt[p] of them before p-th row of "a".
+        std::vector<std::pair<CharT, uint64_t>> runsB;
+        runsB.reserve(b.getNumRuns());
+        b.forEachRun([&runsB](const CharT ch, const uint64_t exponent)
+                     { runsB.emplace_back(ch, exponent); });
+        uint64_t runB = 0, offB = 0;
+        auto takeB = [&](uint64_t num)
+        {
+            while (num)
+            {
+                const uint64_t m = std::min(num, runsB[runB].second - offB);
+                push(runsB[runB].first, m);
+                num -= m;
+                offB += m;
+                if (offB == runsB[runB].second)
+                {
+                    ++runB;
+                    offB = 0;
+                }
+            }
+        };
+        uint64_t p = 0;
+        a.forEachRun([&](const CharT ch, const uint64_t exponent)
+                     {
+                         uint64_t numA = 0; // Num of characters of current run of "a" not pushed yet.
+                         for (const uint64_t end = p + exponent; p < end; ++p)
+                         {
+                             const uint64_t num = cnt.get(p);
+                             if (num)
+                             {
+                                 push(ch, numA);
+                                 numA = 0;
+                                 takeB(num);
+                             }
+                             ++numA;
+                         }
+                         push(ch, numA); });
+        takeB(cnt.get(lenA));
+        assert(runB == runsB.size());
+    }
+
+    /*!
+     * @brief Merge BWTs "shards" of collections of separator-terminated sequences into runs "runs" by pairwise merges.
+     * @note
+     *   "shards" are consumed. Shards are merged in rounds of a balanced tree so that each row is moved O(log P) times,
+     *   and each merge is multi-threaded by mergeCollections.
+     */
+    template <typename CharT>
+    void mergeShards(
+        std::vector<StaticRleForRlbwt<CharT>> &shards, //!< [in, out] BWTs of shards (emptied).
+        const uint64_t sep,                           //!< Largest separator character.
+        std::vector<std::pair<CharT, uint64_t>> &runs, //!< [out] Runs of merged BWT.
+        const unsigned numThreads                     //!< Num of worker threads (0 for hardware concurrency).
+    )
+    {
+        runs.clear();
+        while (shards.size() > 1)
+        {
+            std::vector<StaticRleForRlbwt<CharT>> merged;
+            for (size_t i = 0; i < shards.size(); i += 2)
+            {
+                if (i + 1 == shards.size())
+                {
+                    merged.push_back(std::move(shards[i]));
+                    break;
+                }
+                mergeCollections(shards[i], shards[i + 1], sep, runs, numThreads);
+                shards[i] = StaticRleForRlbwt<CharT>();
+                shards[i + 1] = StaticRleForRlbwt<CharT>();
+                merged.emplace_back(RunsView<CharT>{runs});
+            }
+            shards.swap(merged);
+        }
+        runs.clear();
+        if (!shards.empty())
+        {
+            shards[0].forEachRun([&runs](const CharT ch, const uint64_t exponent)
+                                 { runs.emplace_back(ch, exponent); });
+            shards.clear();
+        }
+    }
+} // namespace itmmti
+
+#endif
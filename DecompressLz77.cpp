@@ -17,13 +17,16 @@
 #include <fstream>
 #include <iomanip>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 #include "cmdline.h"
+#include "Lz77FactorIO.hpp"
+#include "SerialUtil.hpp"
 
 
-using SizeT = uint32_t; // Text length should fit in SizeT.
-using txt = std::vector<char>;
+using namespace itmmti;
 
 int main(int argc, char *argv[])
 {
@@ -31,49 +34,60 @@ int main(int argc, char *argv[])
   parser.add<std::string>("input",'i', "input file name", true);
   parser.add<std::string>("output",'o', "output file name", true);
   parser.add<bool>("verbose",'v', "verbose", false, 0);
+  parser.add<unsigned>("threads", 't', "num of threads for decoding (0: hardware concurrency)", false, 1);
+  parser.add<std::string>("reference", 'r', "reference file name for factors of relative LZ (rlz)", false, "");
   parser.add("help", 0, "print help");
 
   parser.parse_check(argc, argv);
   const std::string in = parser.get<std::string>("input");
   const std::string out = parser.get<std::string>("output");
   const bool verbose = parser.get<bool>("verbose");
+  const unsigned numThreads = parser.get<unsigned>("threads");
+  const std::string ref = parser.get<std::string>("reference");
 
   auto t1 = std::chrono::high_resolution_clock::now();
 
   std::cout << "LZ77 Decompressing ..." << std::endl;
-  txt T;
 
-  SizeT n = 0; // Length of text.
-  SizeT z = 0; // LZ phrase counter
+  uint64_t n = 0; // Length of text.
+  std::vector<lz77io::Factor> factors;
+  //// Reference of relative LZ precedes text and is not written.
+  serialutil::MappedFile refFile;
+  if (!ref.empty() && !refFile.open(ref)) {
+    std::cerr << "error: failed to open " << ref << std::endl;
+    exit(1);
+  }
+  const uint64_t refLen = refFile.size();
   {
-    std::ifstream ifs(in, std::ios::in | std::ios::binary);
-    SizeT beg;
-    SizeT len;
-    char c;
-    while (ifs.peek() != std::ios::traits_type::eof()) {
-      ifs.read((char *) &beg, sizeof(SizeT));
-      ifs.read((char *) &len, sizeof(SizeT));
-      ifs.read((char *) &c, 1);
-
-      n += len + 1;
-      ++z;
-
-      // if (verbose) {
-      //   std::cout << "LZ[" << z << "] = (" << beg << ", " << len << ", " << c << ")" << std::endl;
-      // }
-      for (SizeT i = 0; i < len; ++i) {
-        T.push_back(T[beg + i]);
-      }
-      T.push_back(c);
+    serialutil::MappedFile mf;
+    if (!mf.open(in) || !lz77io::readFactors(mf.data(), mf.size(), factors, n, refLen)) {
+      std::cerr << "error: failed to read factors from " << in << std::endl;
+      exit(1);
     }
-    ifs.close();
   }
+  const uint64_t z = factors.size(); // LZ phrase counter
+  if (verbose) {
+    std::cout << "Read " << z << " factors. "
+              << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t1).count() << " sec" << std::endl;
+  }
+  std::unique_ptr<char[]> T(new char[refLen + n + 1]);
+  if (refLen) {
+    memcpy(T.get(), refFile.data(), refLen);
+    refFile.close();
+  }
+  lz77io::decodeFactors(factors, T.get(), numThreads, UINT64_C(1) << 22, refLen);
+  std::vector<lz77io::Factor>().swap(factors);
   {
-    std::ofstream ofs(out);
-    for (SizeT i = 0; i < T.size(); ++i) {
-      ofs.write(&(T[i]), 1);
+    std::ofstream ofs(out, std::ios::out | std::ios::binary);
+    const uint64_t blockBytes = UINT64_C(1) << 26;
+    for (uint64_t i = 0; i < n; i += blockBytes) {
+      ofs.write(T.get() + refLen + i, static_cast<std::streamsize>(std::min(blockBytes, n - i)));
     }
     ofs.close();
+    if (!ofs) {
+      std::cerr << "error: failed to write " << out << std::endl;
+      exit(1);
+    }
   }
 
   auto t2 = std::chrono::high_resolution_clock::now();
@@ -0,0 +1,416 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file DocArray.hpp
+ * @brief Run-length sampled document array of BWT of collection (e.g., osptBWT) and document listing.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Document (sequence ID) of a row is the input order (0base) of the sequence whose suffix the row represents.
+ *   Since sptExtend places a new suffix anywhere in the interval of equal suffixes, LF-chains of sequences sharing a suffix
+ *   may exchange their preceding parts during construction, and so IDs attached to rows online would become stale.
+ *   Instead, ::OnlineRlbwt records ::DocFingerprint of each sequence online (see OnlineRlbwt::enableDocTracking),
+ *   and ::DocArray is built from the final BWT by decoding each sequence once and matching its fingerprint.
+ *   Rows of equal suffixes are interchangeable, and so is the assignment of IDs among them,
+ *   which does not affect document listing (patterns never split such groups of rows).
+ */
+#ifndef INCLUDE_GUARD_DocArray
+#define INCLUDE_GUARD_DocArray
+
+#include <stdint.h>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace itmmti
+{
+    /*!
+     * @brief Fingerprint (64bit hash) of sequence computed character by character in appended order.
+     */
+    class DocFingerprint
+    {
+        uint64_t hash_;
+        uint64_t len_;
+
+    public:
+        static constexpr uint64_t kBase{UINT64_C(0x100000001b3)};
+
+        DocFingerprint() noexcept : hash_(0),
+                                    len_(0)
+        {
+        }
+
+        void reset() noexcept
+        {
+            hash_ = 0;
+            len_ = 0;
+        }
+
+        void put(
+            const uint64_t ch) noexcept
+        {
+            hash_ = hash_ * kBase + ch + 1; // +1 so that leading 0s matter.
+            ++len_;
+        }
+
+        uint64_t get() const noexcept
+        {
+            uint64_t h = hash_ ^ (len_ * UINT64_C(0x9e3779b97f4a7c15)); // Finalizer of splitmix64.
+            h = (h ^ (h >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+            h = (h ^ (h >> 27)) * UINT64_C(0x94d049bb133111eb);
+            return h ^ (h >> 31);
+        }
+    };
+
+    /*!
+     * @brief Document array of BWT sampled at the first row of each run (and at every row of separators),
+     *        and at every "sampleRate" rows along LF-chains of sequences between them.
+     * @note
+     *   Since LF preserves documents except at separators, the document of any row is found by LF steps
+     *   until reaching a sampled row, a run head or a separator, which takes at most "sampleRate" steps.
+     *   Without chain samples, a piece of run can stay away from run heads for almost the whole length of the sequence
+     *   (e.g., in collections of near-identical sequences). listDocs applies LF to whole pieces of runs at once,
+     *   so that rows of an interval are resolved after at most "sampleRate" steps of pieces.
+     *   "SRle" should be ::StaticRleForRlbwt (const queries are thread-safe).
+     */
+    class DocArray
+    {
+    public:
+        static constexpr uint32_t kNoDoc{UINT32_MAX}; //!< Document of rows not matched to any input sequence.
+        static constexpr uint64_t kDefaultSampleRate{64}; //!< Default max num of LF steps between samples along LF-chains.
+
+    private:
+        uint64_t sep_;                  //!< Largest separator character.
+        uint64_t numDocs_;              //!< Num of input sequences.
+        std::vector<uint32_t> headDocs_; //!< headDocs_[j] is document of the first row of j-th run.
+        std::vector<uint64_t> sepRows_;  //!< Sorted rows whose BWT character is separator.
+        std::vector<uint32_t> sepDocs_;  //!< sepDocs_[k] is document of row sepRows_[k].
+        std::vector<uint64_t> sampleRows_; //!< Sorted rows sampled along LF-chains (neither run heads nor separators).
+        std::vector<uint32_t> sampleDocs_; //!< sampleDocs_[k] is document of row sampleRows_[k].
+
+    public:
+        DocArray() : sep_(0),
+                     numDocs_(0)
+        {
+        }
+
+        /*!
+         * @brief Build from BWT "srle" and fingerprints of input sequences in input order.
+         * @return false if the collection has too many sequences.
+         * @note
+         *   As in ::invertCollection, the first 'num of occ of characters <= sep' rows are entry points of sequences,
+         *   which are decoded by "numThreads" threads.
+         *   Chain samples take 12 bytes per "sampleRate" rows at most (0 for no chain samples).
+         */
+        template <class SRle>
+        bool build(
+            const SRle &srle,                    //!< BWT without implicit end marker.
+            const uint64_t sep,                  //!< Largest separator character.
+            const std::vector<uint64_t> &docFps, //!< docFps[d] is DocFingerprint::get() of d-th sequence.
+            const unsigned numThreads,           //!< Num of worker threads (0 for hardware concurrency).
+            const uint64_t sampleRate = kDefaultSampleRate //!< Max num of LF steps between samples along LF-chains.
+        )
+        {
+            using CharT = typename std::remove_reference<decltype(srle[0])>::type;
+            const uint64_t len = srle.getSumOfWeight();
+            const uint64_t numRows = (len) ? srle.rank(sep, len - 1, true) : 0;
+            if (numRows >= kNoDoc || docFps.size() >= kNoDoc)
+            {
+                std::cerr << "Error: DocArray supports less than " << kNoDoc << " sequences." << std::endl;
+                return false;
+            }
+            sep_ = sep;
+            numDocs_ = docFps.size();
+            headDocs_.assign(srle.getNumRuns(), static_cast<uint32_t>(kNoDoc));
+
+            //// Decode sequences from entry points, putting (temporarily) entry point in run heads and chain samples visited.
+            std::vector<uint64_t> chainFps(numRows);
+            std::vector<uint64_t> chainSepRows(numRows);
+            unsigned nt = (numThreads) ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+            nt = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>(nt, numRows)));
+            std::vector<std::vector<std::pair<uint64_t, uint64_t>>> samplesOfThreads(nt); // Pairs of row and entry point.
+            auto decode = [&](const unsigned t)
+            {
+                auto &samples = samplesOfThreads[t];
+                for (uint64_t row = t; row < numRows; row += nt)
+                {
+                    DocFingerprint fp;
+                    uint64_t pos = row;
+                    uint64_t steps = 0; // Num of LF steps since the last run head or sample.
+                    while (true)
+                    {
+                        const uint64_t run = srle.getRunIdx(pos);
+                        if (pos == srle.getRunStart(run))
+                        {
+                            headDocs_[run] = static_cast<uint32_t>(row); // Each row is visited by exactly one entry point.
+                            steps = 0;
+                        }
+                        else if (sampleRate && ++steps >= sampleRate)
+                        {
+                            samples.emplace_back(pos, row);
+                            steps = 0;
+                        }
+                        CharT ch;
+                        const uint64_t next = srle.lfMap(pos, ch);
+                        if (static_cast<uint64_t>(ch) <= sep)
+                        {
+                            chainSepRows[row] = pos;
+                            if (!samples.empty() && samples.back().first == pos)
+                            {
+                                samples.pop_back(); // Rows of separators have their own samples.
+                            }
+                            break;
+                        }
+                        fp.put(static_cast<uint64_t>(ch));
+                        pos = next;
+                    }
+                    chainFps[row] = fp.get();
+                }
+            };
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < nt; ++t)
+            {
+                workers.emplace_back(decode, t);
+            }
+            decode(0);
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+
+            //// Match entry points with input sequences by fingerprints (equal sequences are matched in input order).
+            std::vector<std::pair<uint64_t, uint32_t>> fpDocs(docFps.size());
+            for (uint64_t d = 0; d < docFps.size(); ++d)
+            {
+                fpDocs[d] = {docFps[d], static_cast<uint32_t>(d)};
+            }
+            std::sort(fpDocs.begin(), fpDocs.end());
+            std::vector<uint32_t> numUsed(fpDocs.size(), 0); // numUsed[k] for the first k of each fingerprint.
+            std::vector<uint32_t> chainDocs(numRows, static_cast<uint32_t>(kNoDoc));
+            for (uint64_t row = 0; row < numRows; ++row)
+            {
+                const auto k = static_cast<uint64_t>(std::lower_bound(fpDocs.begin(), fpDocs.end(), std::make_pair(chainFps[row], uint32_t(0))) - fpDocs.begin());
+                if (k + numUsed[k] < fpDocs.size() && fpDocs[k + numUsed[k]].first == chainFps[row])
+                {
+                    chainDocs[row] = fpDocs[k + numUsed[k]].second;
+                    ++numUsed[k];
+                }
+            }
+
+            for (auto &doc : headDocs_)
+            {
+                doc = (doc == kNoDoc) ? static_cast<uint32_t>(kNoDoc) : chainDocs[doc];
+            }
+            std::vector<std::pair<uint64_t, uint32_t>> seps(numRows);
+            for (uint64_t row = 0; row < numRows; ++row)
+            {
+                seps[row] = {chainSepRows[row], chainDocs[row]};
+            }
+            std::sort(seps.begin(), seps.end());
+            sepRows_.resize(numRows);
+            sepDocs_.resize(numRows);
+            for (uint64_t k = 0; k < numRows; ++k)
+            {
+                sepRows_[k] = seps[k].first;
+                sepDocs_[k] = seps[k].second;
+            }
+
+            std::vector<std::pair<uint64_t, uint64_t>> samples;
+            for (auto &samplesOfThread : samplesOfThreads)
+            {
+                samples.insert(samples.end(), samplesOfThread.begin(), samplesOfThread.end());
+                std::vector<std::pair<uint64_t, uint64_t>>().swap(samplesOfThread);
+            }
+            std::sort(samples.begin(), samples.end());
+            sampleRows_.resize(samples.size());
+            sampleDocs_.resize(samples.size());
+            for (uint64_t k = 0; k < samples.size(); ++k)
+            {
+                sampleRows_[k] = samples[k].first;
+                sampleDocs_[k] = chainDocs[samples[k].second];
+            }
+            return true;
+        }
+
+        uint64_t getNumDocs() const noexcept
+        {
+            return numDocs_;
+        }
+
+        /*!
+         * @brief Get document of "row" (or kNoDoc).
+         */
+        template <class SRle>
+        uint32_t getDoc(
+            const SRle &srle,
+            uint64_t row //!< Row in [0..|BWT|).
+        ) const noexcept
+        {
+            using CharT = typename std::remove_reference<decltype(srle[0])>::type;
+            while (true)
+            {
+                const uint64_t run = srle.getRunIdx(row);
+                CharT ch;
+                const uint64_t next = srle.lfMap(row, ch);
+                if (static_cast<uint64_t>(ch) <= sep_)
+                {
+                    return getSepDoc(row);
+                }
+                if (row == srle.getRunStart(run))
+                {
+                    return headDocs_[run];
+                }
+                const auto it = std::lower_bound(sampleRows_.begin(), sampleRows_.end(), row);
+                if (it != sampleRows_.end() && *it == row)
+                {
+                    return sampleDocs_[it - sampleRows_.begin()];
+                }
+                row = next;
+            }
+        }
+
+        /*!
+         * @brief Compute bwt-interval [left..right) of rows prefixed by "pat" by backward search.
+         */
+        template <class SRle>
+        static std::pair<uint64_t, uint64_t> calcBwtIntvl(
+            const SRle &srle,
+            const std::string &pat)
+        {
+            uint64_t l = 0, r = srle.getSumOfWeight();
+            for (auto it = pat.rbegin(); it != pat.rend() && l < r; ++it)
+            {
+                const auto ch = static_cast<uint64_t>(static_cast<unsigned char>(*it));
+                l = srle.rank(ch, l - 1, true); // "l - 1 == UINT64_MAX" for l == 0 is the position before BWT.
+                r = srle.rank(ch, r - 1, true);
+            }
+            return {l, r};
+        }
+
+        /*!
+         * @brief List documents of rows in [left..right) with num of rows (occurrences) in each document.
+         * @note Documents are in no particular order, and rows of kNoDoc are not listed.
+         */
+        template <class SRle>
+        void listDocs(
+            const SRle &srle,
+            const uint64_t left,
+            const uint64_t right,
+            std::vector<std::pair<uint32_t, uint64_t>> &docCounts //!< [out] Pairs of document and num of occurrences.
+        ) const
+        {
+            using CharT = typename std::remove_reference<decltype(srle[0])>::type;
+            std::unordered_map<uint32_t, uint64_t> counts;
+            std::vector<std::pair<uint64_t, uint64_t>> intvls;
+            if (left < right)
+            {
+                intvls.emplace_back(left, right);
+            }
+            while (!intvls.empty())
+            {
+                uint64_t x = intvls.back().first;
+                const uint64_t y = intvls.back().second;
+                intvls.pop_back();
+                while (x < y)
+                { // Each piece of run in [x..y) is mapped by LF at once, except for its run head and sampled rows.
+                    const uint64_t run = srle.getRunIdx(x);
+                    const uint64_t end = std::min(y, srle.getRunStart(run + 1));
+                    CharT ch;
+                    uint64_t next = srle.lfMap(x, ch);
+                    if (static_cast<uint64_t>(ch) <= sep_)
+                    {
+                        for (uint64_t row = x; row < end; ++row)
+                        {
+                            ++counts[getSepDoc(row)];
+                        }
+                    }
+                    else
+                    {
+                        uint64_t beg = x;
+                        if (x == srle.getRunStart(run))
+                        {
+                            ++counts[headDocs_[run]];
+                            ++beg;
+                            ++next;
+                        }
+                        for (auto it = std::lower_bound(sampleRows_.begin(), sampleRows_.end(), beg);
+                             it != sampleRows_.end() && *it < end; ++it)
+                        {
+                            if (beg < *it)
+                            {
+                                intvls.emplace_back(next, next + (*it - beg));
+                            }
+                            ++counts[sampleDocs_[it - sampleRows_.begin()]];
+                            next += *it - beg + 1;
+                            beg = *it + 1;
+                        }
+                        if (beg < end)
+                        {
+                            intvls.emplace_back(next, next + (end - beg));
+                        }
+                    }
+                    x = end;
+                }
+            }
+            counts.erase(static_cast<uint32_t>(kNoDoc));
+            docCounts.assign(counts.begin(), counts.end());
+        }
+
+        /*!
+         * @brief Top-"k" documents of rows in [left..right) by num of occurrences (ties by smaller document).
+         * @return Num of distinct documents.
+         */
+        template <class SRle>
+        uint64_t listTopDocs(
+            const SRle &srle,
+            const uint64_t left,
+            const uint64_t right,
+            const uint64_t k,
+            std::vector<std::pair<uint32_t, uint64_t>> &docCounts //!< [out] At most "k" pairs of document and num of occurrences.
+        ) const
+        {
+            listDocs(srle, left, right, docCounts);
+            const uint64_t numDistinct = docCounts.size();
+            auto cmp = [](const std::pair<uint32_t, uint64_t> &a, const std::pair<uint32_t, uint64_t> &b)
+            {
+                return a.second > b.second || (a.second == b.second && a.first < b.first);
+            };
+            const uint64_t numTop = std::min<uint64_t>(k, numDistinct);
+            std::partial_sort(docCounts.begin(), docCounts.begin() + numTop, docCounts.end(), cmp);
+            docCounts.resize(numTop);
+            return numDistinct;
+        }
+
+        size_t calcMemBytes(
+            const bool includeThis = true) const noexcept
+        {
+            size_t size = sizeof(*this) * includeThis;
+            size += headDocs_.capacity() * sizeof(uint32_t);
+            size += sepRows_.capacity() * sizeof(uint64_t) + sepDocs_.capacity() * sizeof(uint32_t);
+            size += sampleRows_.capacity() * sizeof(uint64_t) + sampleDocs_.capacity() * sizeof(uint32_t);
+            return size;
+        }
+
+    private:
+        uint32_t getSepDoc(
+            const uint64_t row) const noexcept
+        {
+            const auto it = std::lower_bound(sepRows_.begin(), sepRows_.end(), row);
+            assert(it != sepRows_.end() && *it == row);
+            return sepDocs_[it - sepRows_.begin()];
+        }
+    };
+} // namespace itmmti
+
+#endif
@@ -22,6 +22,9 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <limits>
+#include <vector>
 
 // include from Basics
 #include "BitsUtil.hpp"
@@ -33,8 +36,25 @@
 #include "BTree.hpp"
 #include "TagRelabelAlgo.hpp"
 
+#include "SerialUtil.hpp"
+#include "StaticRleForRlbwt.hpp"
+#include "ScanKernels.hpp"
+#include "NodeArena.hpp"
+#include "BuildStats.hpp"
+#include "FlatPSumIndex.hpp"
+
 namespace itmmti
 {
+    /*!
+     * @brief Tags to choose update algorithms of M-tree according to how bottom nodes of M-tree store weights.
+     */
+    struct StepCodeWeightTag
+    {
+    };
+    struct PlainWeightTag
+    {
+    };
+
     /*!
      * @brief
      * @tparam tparam_BTreeNodeT BTreeNode type.
@@ -47,6 +67,7 @@ namespace itmmti
         static constexpr uint8_t kBtmBM{tparam_kBtmBM};
         static constexpr size_t kUnitBits{kBtmBM * 4};
         using BTreeNodeT = tparam_BTreeNodeT;
+        using WeightTag = StepCodeWeightTag;
 
         StepCodeCore<kBtmBM> stcc_; //!< Storing weights
         uint64_t label_;            //!< TRA label of btmM.
@@ -76,6 +97,20 @@ namespace itmmti
             // stcc_ is freed.
         }
 
+        //////////////////////////////// allocation of blocks of bottom nodes (see NodeArena)
+        static void *operator new[](
+            size_t bytes)
+        {
+            return NodeArena::getInstance().allocate(bytes);
+        }
+
+        static void operator delete[](
+            void *ptr,
+            size_t bytes) noexcept
+        {
+            NodeArena::getInstance().deallocate(ptr, bytes);
+        }
+
         uint16_t getStccSize() const noexcept
         {
             return stccSize_;
@@ -184,6 +219,34 @@ namespace itmmti
             }
         }
 
+        /*!
+         * @brief Variant of searchPos, where search starts from the run at "idx".
+         * @return Index (in btmM) of the run containing 'pos'-th character (0base) counted from the beginning of run at "idx".
+         *         If the position is beyond this node, return numChildren_ (and 'pos' is meaningless).
+         */
+        uint8_t searchPosFrom(
+            uint8_t idx,  //!< in [0..numChildren_)
+            uint64_t &pos //!< [in,out] Give position to search. It is modified to relative position.
+        ) const noexcept
+        {
+            assert(idx < numChildren_);
+
+            const auto &stcc = this->getConstRef_stcc();
+            uint64_t bitPos = calcBitPos(idx);
+            for (; idx < numChildren_; ++idx)
+            {
+                const auto w = stcc.readW(idx);
+                const auto weight = stcc.readWBits(bitPos, w);
+                if (pos < weight)
+                {
+                    break;
+                }
+                bitPos += w;
+                pos -= weight;
+            }
+            return idx;
+        }
+
         /*!
          * @brief Calculate the beginning bit-pos of "idx"-th value in stcc_.
          */
@@ -409,6 +472,286 @@ namespace itmmti
         }
     }; // end of BtmNode
 
+    ////////////////////////////////////////////////////////////////
+    /*!
+     * @brief Variant of ::BtmNodeM_StepCode storing weights in fixed-width integers with in-node prefix sums,
+     *        which trades space for speed of readWeight, searchPos and replace.
+     * @tparam tparam_BTreeNodeT BTreeNode type.
+     * @tparam tparam_kBtmBM Arity for bottom node of B+tree, which should be in {32, 64, 128}.
+     * @tparam tparam_WeightT Unsigned integer type for weights (run lengths).
+     */
+    template <typename tparam_BTreeNodeT, uint8_t tparam_kBtmBM, typename tparam_WeightT = uint32_t>
+    class BtmNodeM_Plain
+    {
+    public:
+        static constexpr uint8_t kBtmBM{tparam_kBtmBM};
+        using BTreeNodeT = tparam_BTreeNodeT;
+        using WeightT = tparam_WeightT;
+        using WeightTag = PlainWeightTag;
+
+        uint64_t psums_[kBtmBM];   //!< Inclusive prefix sums of weights_.
+        WeightT weights_[kBtmBM];  //!< Storing weights
+        uint64_t label_;           //!< TRA label of btmM.
+        BTreeNodeT *parent_;       //!< Pointer to parent of btmM.
+        uint8_t idxInSibling_;     //!< idxInSibling of btmM.
+        uint8_t numChildren_;      //!< Current size (number of elements).
+
+        BtmNodeM_Plain() : label_(0),
+                           parent_(nullptr),
+                           idxInSibling_(0),
+                           numChildren_(0)
+        {
+        }
+
+        ~BtmNodeM_Plain()
+        {
+        }
+
+        //////////////////////////////// allocation of blocks of bottom nodes (see NodeArena)
+        static void *operator new[](
+            size_t bytes)
+        {
+            return NodeArena::getInstance().allocate(bytes);
+        }
+
+        static void operator delete[](
+            void *ptr,
+            size_t bytes) noexcept
+        {
+            NodeArena::getInstance().deallocate(ptr, bytes);
+        }
+
+        uint8_t getNumChildren() const noexcept
+        {
+            return numChildren_;
+        }
+
+        uint8_t getIdxInSibling() const noexcept
+        {
+            return idxInSibling_;
+        }
+
+        uint64_t getLabel() const noexcept
+        {
+            return label_;
+        }
+
+        BTreeNodeT *getParent() const noexcept
+        {
+            return parent_;
+        }
+
+        uint64_t readWeight(uint8_t idx) const noexcept
+        {
+            assert(idx < numChildren_);
+
+            return weights_[idx];
+        }
+
+        uint64_t calcSumOfWeight() const noexcept
+        {
+            return (numChildren_) ? psums_[numChildren_ - 1] : 0;
+        }
+
+        uint64_t calcSumOfWeight(
+            const uint8_t childIdx_beg,
+            const uint8_t childIdx_end) const noexcept
+        {
+            assert(childIdx_beg <= childIdx_end);
+            assert(childIdx_end <= numChildren_);
+
+            return calcPSumBefore(childIdx_end) - calcPSumBefore(childIdx_beg);
+        }
+
+        /*!
+         * @brief Return index (in btmM) corresponding to the run containing 'pos'-th character (0base).
+         * @attention 'pos' is modified to be the relative position (0base) from the beginning of the run.
+         */
+        uint64_t searchPos(
+            uint64_t &pos //!< [in,out] Give position to search (< |T|). It is modified to relative position.
+        ) const noexcept
+        {
+            const uint8_t i = static_cast<uint8_t>(scankernels::searchPSum(psums_, numChildren_, pos));
+            assert(i < numChildren_);
+            pos -= calcPSumBefore(i);
+            return i;
+        }
+
+        /*!
+         * @brief Variant of searchPos, where search starts from the run at "idx".
+         * @return Index (in btmM) of the run containing 'pos'-th character (0base) counted from the beginning of run at "idx".
+         *         If the position is beyond this node, return numChildren_ (and 'pos' is meaningless).
+         */
+        uint8_t searchPosFrom(
+            uint8_t idx,  //!< in [0..numChildren_)
+            uint64_t &pos //!< [in,out] Give position to search. It is modified to relative position.
+        ) const noexcept
+        {
+            assert(idx < numChildren_);
+
+            pos += calcPSumBefore(idx);
+            idx += static_cast<uint8_t>(scankernels::searchPSum(psums_ + idx, numChildren_ - idx, pos));
+            if (idx < numChildren_)
+            {
+                pos -= calcPSumBefore(idx);
+            }
+            return idx;
+        }
+
+        /*!
+         * @brief Sum of weights of [0..idx).
+         */
+        uint64_t calcPSumBefore(
+            const uint8_t idx //!< in [0..numChildren_]
+        ) const noexcept
+        {
+            assert(idx <= numChildren_);
+
+            return (idx) ? psums_[idx - 1] : 0;
+        }
+
+        void setLabel(
+            uint64_t newLabel) noexcept
+        {
+            label_ = newLabel;
+        }
+
+        void setParentRef(
+            BTreeNodeT *newParent,
+            uint8_t newIdxInSibling) noexcept
+        {
+            this->parent_ = newParent;
+            this->idxInSibling_ = newIdxInSibling;
+        }
+
+        /*!
+         * @brief Change "numChildren_" to "newSize".
+         * @note Prefix sums should be updated by updatePSums when weights are changed.
+         */
+        void setNumChildren(
+            const uint8_t newSize) noexcept
+        {
+            assert(newSize <= kBtmBM);
+
+            numChildren_ = newSize;
+        }
+
+        /*!
+         * @brief Write weight without updating prefix sums.
+         */
+        void writeWeight(
+            const uint64_t val,
+            const uint8_t idx //!< in [0..kBtmBM)
+            ) noexcept
+        {
+            assert(idx < kBtmBM);
+
+            if (val > std::numeric_limits<WeightT>::max())
+            {
+                std::cerr << "error: weight " << val << " does not fit in WeightT (" << sizeof(WeightT) << " bytes) of BtmNodeM_Plain." << std::endl;
+                exit(-1);
+            }
+            weights_[idx] = static_cast<WeightT>(val);
+        }
+
+        /*!
+         * @brief Move "num" weights from "src" at "srcIdx" to "tgtIdx" (overlap is allowed) without updating prefix sums.
+         */
+        void mvWeights(
+            const BtmNodeM_Plain &src,
+            const uint8_t srcIdx,
+            const uint8_t tgtIdx,
+            const uint8_t num) noexcept
+        {
+            assert(srcIdx + num <= kBtmBM);
+            assert(tgtIdx + num <= kBtmBM);
+
+            std::memmove(weights_ + tgtIdx, src.weights_ + srcIdx, sizeof(WeightT) * num);
+        }
+
+        /*!
+         * @brief Recompute prefix sums of [idxBeg..numChildren_).
+         */
+        void updatePSums(
+            const uint8_t idxBeg) noexcept
+        {
+            uint64_t sum = (idxBeg && idxBeg <= numChildren_) ? psums_[idxBeg - 1] : 0;
+            for (uint16_t i = idxBeg; i < numChildren_; ++i)
+            {
+                sum += weights_[i];
+                psums_[i] = sum;
+            }
+        }
+
+        /*!
+         * @brief Replace values.
+         */
+        void replace(
+            const uint64_t *newVals, //!< Storing weights that replace existing weights
+            const uint8_t num,       //!< Number of elements to replace.
+            const uint8_t idx        //!< in [0..numChildren_). Beginning idx of tgt.
+        )
+        {
+            assert(idx + num <= numChildren_);
+
+            for (uint8_t i = 0; i < num; ++i)
+            {
+                writeWeight(newVals[i], idx + i);
+            }
+            updatePSums(idx);
+        }
+
+        //////////////////////////////// statistics
+        size_t calcMemBytes(
+            bool includeThis = true) const noexcept
+        {
+            return sizeof(*this) * includeThis;
+        }
+
+        size_t calcMemBytes_Weights() const noexcept
+        {
+            return sizeof(psums_) + sizeof(weights_);
+        }
+
+        void printStatistics(
+            std::ostream &os,
+            const bool verbose) const noexcept
+        {
+            os << "DynRleWithValue::BtmNodeM_Plain object (" << this << ") " << __func__ << "(" << verbose << ") BEGIN" << std::endl;
+            os << "BTree arity for bottom node = " << static_cast<int>(kBtmBM) << ", label = " << label_ << std::endl;
+            os << "parent = " << parent_ << ", idxInSibling = " << (int)idxInSibling_ << ", numChildren = " << static_cast<uint64_t>(numChildren_) << std::endl;
+            os << "Total: " << calcMemBytes() << " bytes (weights of " << sizeof(WeightT) << " bytes)" << std::endl;
+            os << "DynRleWithValue::BtmNodeM_Plain object (" << this << ") " << __func__ << "(" << verbose << ") END" << std::endl;
+        }
+
+        void printDebugInfo(
+            std::ostream &os,
+            const bool verbose) const noexcept
+        {
+            os << "DynRleWithValue::BtmNodeM_Plain object (" << this << ") " << __func__ << "(" << verbose << ") BEGIN" << std::endl;
+            os << "BTree arity for bottom node = " << static_cast<int>(kBtmBM);
+            os << ", SumOfWeight = " << this->calcSumOfWeight() << ", label = " << label_ << std::endl;
+            os << "parent = " << parent_ << ", idxInSibling = " << (int)idxInSibling_ << ", numChildren = " << static_cast<uint64_t>(numChildren_) << std::endl;
+            {
+                os << "dump values" << std::endl;
+                for (uint8_t i = 0; i < numChildren_; ++i)
+                {
+                    os << weights_[i] << " ";
+                }
+                os << std::endl;
+            }
+            {
+                os << "dump prefix sums" << std::endl;
+                for (uint8_t i = 0; i < numChildren_; ++i)
+                {
+                    os << psums_[i] << " ";
+                }
+                os << std::endl;
+            }
+            os << "DynRleWithValue::BtmNodeM_Plain object (" << this << ") " << __func__ << "(" << verbose << ") END" << std::endl;
+        }
+    }; // end of BtmNodeM_Plain
+
     ////////////////////////////////////////////////////////////////
     template <typename BtmNodeMT, uint64_t tparam_kBlockSize>
     class BtmMInfo_BlockVec
@@ -416,6 +759,7 @@ namespace itmmti
     public:
         static constexpr uint8_t kBtmBM{BtmNodeMT::kBtmBM};
         using BTreeNodeT = typename BtmNodeMT::BTreeNodeT;
+        using WeightTag = typename BtmNodeMT::WeightTag;
 
     private:
         //// Private member variables.
@@ -453,6 +797,15 @@ namespace itmmti
             vec_.resize(newSize);
         }
 
+        /*!
+         * @brief Allocate blocks for "numBtms" bottom nodes in advance (size is not changed).
+         */
+        void reserve(
+            size_t numBtms)
+        {
+            vec_.reserve(numBtms);
+        }
+
         size_t getNumBtm() const noexcept
         {
             return vec_.size();
@@ -557,6 +910,24 @@ namespace itmmti
             return vec_[btmM].searchPos(pos);
         }
 
+        /*!
+         * @brief Variant of searchPos, where search starts from the run at "idxM" and does not go beyond btmM of "idxM".
+         * @return IdxM of the run containing the position, or BTreeNodeT::NOTFOUND if it is not in btmM of "idxM".
+         */
+        uint64_t searchPosFrom(
+            uint64_t idxM,
+            uint64_t &pos //!< [in,out] Give position relative to the beginning of run at "idxM". It is modified to relative position.
+        ) const noexcept
+        {
+            const auto &btmNodeM = vec_[idxM / kBtmBM];
+            const uint8_t idx = btmNodeM.searchPosFrom(idxM % kBtmBM, pos);
+            if (idx < btmNodeM.getNumChildren())
+            {
+                return idxM / kBtmBM * kBtmBM + idx;
+            }
+            return BTreeNodeT::NOTFOUND;
+        }
+
         ////////////////////////////////
         void setParentRefOfBtmM(
             uint64_t btmM,
@@ -645,6 +1016,20 @@ namespace itmmti
         {
         }
 
+        //////////////////////////////// allocation of blocks of bottom nodes (see NodeArena)
+        static void *operator new[](
+            size_t bytes)
+        {
+            return NodeArena::getInstance().allocate(bytes);
+        }
+
+        static void operator delete[](
+            void *ptr,
+            size_t bytes) noexcept
+        {
+            NodeArena::getInstance().deallocate(ptr, bytes);
+        }
+
         uint8_t getNumChildren() const noexcept
         {
             return numChildren_;
@@ -740,6 +1125,15 @@ namespace itmmti
             vec_.resize(newSize);
         }
 
+        /*!
+         * @brief Allocate blocks for "numBtms" bottom nodes in advance (size is not changed).
+         */
+        void reserve(
+            size_t numBtms)
+        {
+            vec_.reserve(numBtms);
+        }
+
         size_t capacity() const noexcept
         {
             return vec_.capacity();
@@ -750,6 +1144,14 @@ namespace itmmti
             return vec_.size();
         }
 
+        /*!
+         * @brief Get reference to "btmS"
+         */
+        const BtmNodeST &getBtmNodeRef(const uint64_t btmS) const noexcept
+        {
+            return vec_[btmS];
+        }
+
         /*!
          * @brief Get parent of "btmS"
          */
@@ -815,6 +1217,22 @@ namespace itmmti
             vec_[btmS].setNumChildren(newSize);
         }
 
+        //////////////// Direct access to separated trees (not supported)
+        /*!
+         * @brief Get first btmS of separated tree for "ch", which is always NOTFOUND as no table is kept.
+         */
+        uint64_t getFstBtmSOfChar(
+            const uint64_t) const noexcept
+        {
+            return BTreeNodeT::NOTFOUND;
+        }
+
+        void registerFstBtmSOfChar(
+            const uint64_t,
+            const uint64_t) noexcept
+        {
+        }
+
         //////////////////////////////// statistics
         size_t calcMemBytes(
             bool includeThis = true) const noexcept
@@ -839,6 +1257,80 @@ namespace itmmti
         }
     };
 
+    ////////////////////////////////////////////////////////////////
+    /*!
+     * @brief Variant of ::BtmSInfo_BlockVec for small alphabets (e.g., DNA with separators).
+     * @note
+     *   Characters in [0..256) are mapped to dense codes in order of appearance, and the first btmS of
+     *   separated tree is kept for each code, so that root of separated tree is obtained by going up from it
+     *   without searching the alphabet tree. Characters beyond "tparam_kMaxSigma" codes (or >= 256) fall back to the alphabet tree.
+     */
+    template <typename BtmNodeST, uint64_t tparam_kBlockSize, uint8_t tparam_kMaxSigma = 8>
+    class BtmSInfo_SmallSigma : public BtmSInfo_BlockVec<BtmNodeST, tparam_kBlockSize>
+    {
+    public:
+        using BaseT = BtmSInfo_BlockVec<BtmNodeST, tparam_kBlockSize>;
+        using BTreeNodeT = typename BaseT::BTreeNodeT;
+        static constexpr uint8_t kMaxSigma{tparam_kMaxSigma};
+        static constexpr uint8_t kNoCode{UINT8_MAX};
+
+    private:
+        uint8_t codes_[256];           //!< codes_[ch] = dense code of "ch" (kNoCode if not assigned).
+        uint64_t fstBtmS_[kMaxSigma]; //!< fstBtmS_[code] = first btmS of separated tree for the character.
+        uint8_t numCodes_;
+
+    public:
+        BtmSInfo_SmallSigma(
+            size_t givenCapacity = 0 //!< Initial capacity.
+            ) : BaseT(givenCapacity),
+                numCodes_(0)
+        {
+            static_assert(kMaxSigma < kNoCode, "kMaxSigma too large");
+            std::fill(codes_, codes_ + 256, kNoCode);
+        }
+
+        void clearAll()
+        {
+            BaseT::clearAll();
+            std::fill(codes_, codes_ + 256, kNoCode);
+            numCodes_ = 0;
+        }
+
+        /*!
+         * @brief Get first btmS of separated tree for "ch" (NOTFOUND if "ch" has no code).
+         */
+        uint64_t getFstBtmSOfChar(
+            const uint64_t ch) const noexcept
+        {
+            if (ch >= 256 || codes_[ch] == kNoCode)
+            {
+                return BTreeNodeT::NOTFOUND;
+            }
+            return fstBtmS_[codes_[ch]];
+        }
+
+        /*!
+         * @brief Register first btmS of separated tree for "ch" (if a code is available).
+         */
+        void registerFstBtmSOfChar(
+            const uint64_t ch,
+            const uint64_t btmS) noexcept
+        {
+            if (ch < 256 && codes_[ch] == kNoCode && numCodes_ < kMaxSigma)
+            {
+                codes_[ch] = numCodes_;
+                fstBtmS_[numCodes_++] = btmS;
+            }
+        }
+
+        //////////////////////////////// statistics
+        size_t calcMemBytes(
+            bool includeThis = true) const noexcept
+        {
+            return BaseT::calcMemBytes(includeThis) + (sizeof(*this) - sizeof(BaseT)) * includeThis;
+        }
+    };
+
     ////////////////////////////////////////////////////////////////
     template <uint64_t tparam_kBlockSize>
     class Samples_WBitsBlockVec
@@ -874,6 +1366,12 @@ namespace itmmti
             vec_.resize(newSize);
         }
 
+        void reserve(
+            size_t num)
+        {
+            vec_.reserve(num);
+        }
+
         /*!
          * @brief write sample
          */
@@ -969,6 +1467,11 @@ namespace itmmti
         {
         }
 
+        void reserve(
+            size_t num)
+        {
+        }
+
         /*!
          * @brief write sample
          */
@@ -1043,6 +1546,22 @@ namespace itmmti
         // static constexpr bool kM{0};
         // static constexpr bool kS{1};
 
+        /*!
+         * @brief Finger of M-tree remembering btmM found by the last search (see searchPosM with finger).
+         * @note
+         *   Any btmM of M-tree works as finger since its position is recomputed on each search
+         *   (btmMs are never deleted), so a stale finger only costs a longer climb.
+         */
+        struct FingerM
+        {
+            uint64_t btmM_{BTreeNodeT::NOTFOUND};
+
+            void reset() noexcept
+            {
+                btmM_ = BTreeNodeT::NOTFOUND;
+            }
+        };
+
     private:
         typename BTreeNodeT::SuperRootT srootM_; //!< Super root of mixed tree
         // Information for leaves and elements for mixed tree.
@@ -1057,6 +1576,12 @@ namespace itmmti
         SamplesT samples_; //!< Information on sample positions associated to leaves of MTree
 
         uint8_t traCode_; //!< traCode in [9..16).
+        HotCountersT counters_; //!< Hot-path counters (empty unless ONLINE_RLBWT_COUNTERS is defined; also counted by const queries).
+        // Read-only snapshot of M-tree for query phases (see buildFlatIndexM).
+        FlatPSumIndex flatM_;              //!< Flattened search tree over btmMs in text order.
+        std::vector<uint64_t> flatBtmMs_;  //!< flatBtmMs_[j] is j-th btmM in text order.
+        std::vector<uint64_t> flatSlots_;  //!< flatSlots_[btmM] is the index of "btmM" in "flatBtmMs_".
+        FingerM fingerM_;                  //!< Finger used by updates (insertRun, optInsert and extendAndAdvance).
 
     public:
         DynRleForRlbwt(
@@ -1171,6 +1696,8 @@ namespace itmmti
                 return;
             }
 
+            clearFlatIndexM();
+            fingerM_.reset();
             idxM2S_.clearAll();
             idxS2M_.clearAll();
             samples_.clearAll();
@@ -1201,6 +1728,40 @@ namespace itmmti
             samples_.increaseSampleUb(sampleUb);
         }
 
+        /*!
+         * @brief Reserve bottom nodes, links and samples for about "numRuns" runs (e.g., estimated from input size).
+         * @note
+         *   Bottom nodes are assumed to be 2/3 full. Without reservation, blocks of bottom nodes are allocated one by one,
+         *   and links are widened bit by bit (rewriting all of them each time) as the RLE grows.
+         */
+        void reserve(
+            const uint64_t numRuns)
+        {
+            assert(isReady());
+
+            const uint64_t numBtmsM = numRuns * 3 / (2 * kBtmBM) + 1;
+            const uint64_t numBtmsS = numRuns * 3 / (2 * kBtmBS) + 1;
+            btmMInfo_.reserve(numBtmsM);
+            btmSInfo_.reserve(numBtmsS);
+            samples_.reserve(numBtmsM * kBtmBM);
+            {
+                const uint8_t w = bits::bitSize(numBtmsS * kBtmBS); // idxM2S_ stores idxS.
+                if (w > idxM2S_.getW())
+                {
+                    idxM2S_.increaseW(w);
+                }
+                idxM2S_.reserve(numBtmsM * kBtmBM);
+            }
+            {
+                const uint8_t w = bits::bitSize(numBtmsM * kBtmBM); // idxS2M_ stores idxM.
+                if (w > idxS2M_.getW())
+                {
+                    idxS2M_.increaseW(w);
+                }
+                idxS2M_.reserve(numBtmsS * kBtmBS);
+            }
+        }
+
         uint64_t getSampleUb() const noexcept
         {
             return samples_.getSampleUb();
@@ -1448,6 +2009,19 @@ namespace itmmti
             return getSampleFromIdxM(idxS2M(idxS));
         }
 
+        //////////////// Prefetch
+        /*!
+         * @brief Prefetch bottom node of separated tree containing "idxS".
+         * @note It is used to overlap cache misses of independent queries (e.g., interleaved backward searches),
+         *       which later call "getCharFromIdxS", "getParentFromBtmS" and so on for "idxS".
+         */
+        void prefetchIdxS(const uint64_t idxS) const noexcept
+        {
+            assert(isValidIdxS(idxS));
+
+            __builtin_prefetch(&btmSInfo_.getBtmNodeRef(idxS / kBtmBS));
+        }
+
         //////////////// Get weight
         /*!
          * @brief Get length of run corresponding to "idxM"
@@ -1691,7 +2265,7 @@ namespace itmmti
             const auto idxS = searchPosS(pos, rootS); // pos is modified to the relative pos
             const auto idxM = idxS2M(idxS);
             pos += calcSumOfWeightOfBtmM(idxM / kBtmBM, 0, idxM % kBtmBM); // TODO: do this and next in parallel
-            return pos + getParentFromBtmM(idxM / kBtmBM)->calcPSum(getIdxInSiblingFromBtmM(idxM / kBtmBM));
+            return pos + calcPSumOfBtmM(idxM / kBtmBM);
         }
 
         /*!
@@ -1732,6 +2306,18 @@ namespace itmmti
             return select(retRootS, pos + 1); // +1 for 1base rank
         }
 
+        /*!
+         * @brief Compute beginning position (0base) of run at "idxM".
+         */
+        uint64_t calcPosFromIdxM(
+            const uint64_t idxM //!< Valid idxM.
+        ) const noexcept
+        {
+            assert(isValidIdxM(idxM));
+
+            return calcSumOfWeightOfBtmM(idxM / kBtmBM, 0, idxM % kBtmBM) + calcPSumOfBtmM(idxM / kBtmBM);
+        }
+
         /*!
          * @brief Output string represented by current RLE to std::ofstream.
          */
@@ -1751,6 +2337,46 @@ namespace itmmti
             }
         }
 
+        /*!
+         * @brief Call "func(ch, exponent)" for each run from the beginning, where adjacent runs of the same character are merged.
+         */
+        template <class Func>
+        void forEachRun(
+            Func &&func) const
+        {
+            assert(isReady());
+
+            if (getSumOfWeight() == 0)
+            {
+                return;
+            }
+            uint64_t pos = 0;
+            auto idxM = searchPosM(pos);
+            CharT ch = getCharFromIdxM(idxM);
+            uint64_t exponent = 0;
+            for (; idxM != BTreeNodeT::NOTFOUND; idxM = getNextIdxM(idxM))
+            {
+                const CharT chNext = getCharFromIdxM(idxM);
+                if (chNext != ch)
+                {
+                    func(ch, exponent);
+                    ch = chNext;
+                    exponent = 0;
+                }
+                exponent += getWeightFromIdxM(idxM);
+            }
+            func(ch, exponent);
+        }
+
+        /*!
+         * @brief Make static snapshot of current RLE, which supports rank/select/operator[] faster.
+         * @note Later updates of this object are not reflected to the snapshot.
+         */
+        StaticRleForRlbwt<CharT> freeze() const
+        {
+            return StaticRleForRlbwt<CharT>(*this);
+        }
+
         void printString(std::ostream &os) const noexcept
         {
             assert(isReady());
@@ -1773,7 +2399,85 @@ namespace itmmti
             }
         }
 
+        /*!
+         * @brief Num of B+tree nodes of M-tree above "btmM", i.e., depth of descent to "btmM".
+         */
+        uint64_t calcDepthOfBtmM(
+            const uint64_t btmM) const noexcept
+        {
+            uint64_t depth = 1;
+            for (const auto *node = getParentFromBtmM(btmM); !node->isRoot(); node = node->getParent())
+            {
+                ++depth;
+            }
+            return depth;
+        }
+
+        /*!
+         * @brief Sum of weights of btmMs preceding "btmM".
+         */
+        uint64_t calcPSumOfBtmM(
+            const uint64_t btmM) const noexcept
+        {
+            if (hasFlatIndexM())
+            {
+                return flatM_.getStart(flatSlots_[btmM]);
+            }
+            return getParentFromBtmM(btmM)->calcPSum(getIdxInSiblingFromBtmM(btmM));
+        }
+
     public:
+        //////////////////////////////// Flattened M-tree for query phases
+        /*!
+         * @brief Build read-only snapshot of M-tree by ::FlatPSumIndex, which searchPosM and select use while it is valid.
+         * @note
+         *   B+tree nodes of M-tree are scattered in heap in allocation order, and a descent chases a pointer per level.
+         *   The snapshot replaces it with cache-line sized nodes in contiguous arrays (with prefetching of next level),
+         *   which pays off when many queries follow without updates (e.g., locating and inversion after construction).
+         *   Since updates always increase the total length, the snapshot is used only if its total length matches,
+         *   and it is cleared by clearFlatIndexM (or re-initialization).
+         */
+        void buildFlatIndexM()
+        {
+            assert(isReady());
+
+            clearFlatIndexM();
+            uint64_t maxBtmM = 0;
+            for (uint64_t btmM = reinterpret_cast<uintptr_t>(srootM_.root_->getLmBtm_DirectJump());
+                 btmM != BTreeNodeT::NOTFOUND; btmM = getNextBtmM(btmM))
+            {
+                flatBtmMs_.push_back(btmM);
+                maxBtmM = std::max(maxBtmM, btmM);
+            }
+            flatSlots_.resize(maxBtmM + 1);
+            for (uint64_t j = 0; j < flatBtmMs_.size(); ++j)
+            {
+                flatSlots_[flatBtmMs_[j]] = j;
+            }
+            flatM_.build(flatBtmMs_.size(), [this](const uint64_t j)
+                         { return calcSumOfWeightOfBtmM(flatBtmMs_[j]); });
+        }
+
+        void clearFlatIndexM()
+        {
+            flatM_.clear();
+            std::vector<uint64_t>().swap(flatBtmMs_);
+            std::vector<uint64_t>().swap(flatSlots_);
+        }
+
+        /*!
+         * @brief Return true if snapshot built by buildFlatIndexM is valid (no update after building).
+         */
+        bool hasFlatIndexM() const noexcept
+        {
+            return !flatM_.empty() && flatM_.getSumOfWeight() == srootM_.root_->getSumOfWeight();
+        }
+
+        size_t calcMemBytesFlatIndexM() const noexcept
+        {
+            return flatM_.calcMemBytes(false) + (flatBtmMs_.capacity() + flatSlots_.capacity()) * sizeof(uint64_t);
+        }
+
         //////////////////////////////// Public search functions
         /*!
          * @brief Return 'idxM' corresponding to the run containing 'pos'-th character (0base).
@@ -1789,7 +2493,67 @@ namespace itmmti
             assert(isReady());
             assert(pos < srootM_.root_->getSumOfWeight());
 
-            const auto btmM = reinterpret_cast<uintptr_t>(srootM_.root_->searchPos(pos));
+            counters_.inc(HotCounter::kSearchPosM);
+            if (hasFlatIndexM())
+            {
+                const auto btmM = flatBtmMs_[flatM_.search(pos)];
+                return btmM * kBtmBM + btmMInfo_.searchPos(btmM, pos);
+            }
+            const auto btmM = reinterpret_cast<uintptr_t>(srootM_.root_->searchPos(pos));
+            if (HotCountersT::kIsEnabled)
+            {
+                counters_.inc(HotCounter::kDescentDepthM, calcDepthOfBtmM(btmM));
+            }
+            return btmM * kBtmBM + btmMInfo_.searchPos(btmM, pos);
+        }
+
+        /*!
+         * @brief Variant of searchPosM starting from "finger" and updating it to btmM found.
+         * @note
+         *   The beginning of btmM of "finger" is computed bottom-up (no search in nodes).
+         *   If "pos" is out of it, we climb to the lowest ancestor covering "pos" and descend only from there,
+         *   which saves upper levels when consecutive searches are local (e.g., positions of sptExtend steps).
+         *   Fingers are per caller, so that concurrent queries do not share them.
+         */
+        uint64_t searchPosM(
+            uint64_t &pos,  //!< [in,out] Give position to search (< |T|). It is modified to relative position.
+            FingerM &finger //!< [in,out] Finger (reset or btmM found by previous search).
+        ) const noexcept
+        {
+            assert(isReady());
+            assert(pos < srootM_.root_->getSumOfWeight());
+
+            if (hasFlatIndexM() || finger.btmM_ >= getNumBtmM())
+            {
+                const auto idxM = searchPosM(pos);
+                finger.btmM_ = idxM / kBtmBM;
+                return idxM;
+            }
+            counters_.inc(HotCounter::kSearchPosM);
+            uint64_t btmM = finger.btmM_;
+            const auto *node = getParentFromBtmM(btmM);
+            uint8_t idxInSib = getIdxInSiblingFromBtmM(btmM);
+            uint64_t beg = node->calcPSum(idxInSib); // Beginning of btmM.
+            const uint64_t weight = ((idxInSib + 1 < node->getNumChildren()) ? node->getPSum(idxInSib + 1) : node->getSumOfWeight()) - node->getPSum(idxInSib);
+            if (beg <= pos && pos - beg < weight)
+            {
+                counters_.inc(HotCounter::kFingerHitM);
+                pos -= beg;
+                return btmM * kBtmBM + btmMInfo_.searchPos(btmM, pos);
+            }
+            uint64_t depth = 1;
+            beg -= node->getPSum(idxInSib); // Beginning of "node".
+            while (!node->isRoot() && !(beg <= pos && pos - beg < node->getSumOfWeight()))
+            {
+                idxInSib = node->getIdxInSibling();
+                node = node->getParent();
+                beg -= node->getPSum(idxInSib);
+                ++depth;
+            }
+            counters_.inc(HotCounter::kDescentDepthM, depth);
+            pos -= beg;
+            btmM = reinterpret_cast<uintptr_t>(node->searchPos(pos));
+            finger.btmM_ = btmM;
             return btmM * kBtmBM + btmMInfo_.searchPos(btmM, pos);
         }
 
@@ -1801,6 +2565,16 @@ namespace itmmti
         {
             assert(isReady());
 
+            const uint64_t fstBtmS = btmSInfo_.getFstBtmSOfChar(ch);
+            if (fstBtmS != BTreeNodeT::NOTFOUND)
+            { // Direct access to separated tree of "ch" (only for BtmSInfo_SmallSigma).
+                const auto *nodeS = getParentFromBtmS(fstBtmS);
+                while (!nodeS->isRoot())
+                {
+                    nodeS = nodeS->getParent();
+                }
+                return nodeS;
+            }
             auto *nodeA = srootA_.root_;
             while (true)
             {
@@ -1964,6 +2738,30 @@ namespace itmmti
             }
         }
 
+        /*!
+         * @brief Compute num of 'ch' preceding the position specified by 'idxM' and 'relativePos',
+         *        limited to btmS of the run of 'ch' at or before the position.
+         * @note Sum of weights of btmS preceding "idxS / kBtmBS" is not included.
+         */
+        uint64_t calcRankInBtmS(
+            const BTreeNodeT *rootS,    //!< Root of separated tree for 'ch'.
+            const CharT ch,             //!< Character.
+            const uint64_t idxM,        //!< Valid idxM.
+            const uint64_t relativePos, //!< Relative pos in the run of "idxM".
+            uint64_t &idxS              //!< [out] It is set to idxS of the run at "idxM" if its char is "ch", otherwise the predecessor run of "ch".
+        ) const noexcept
+        {
+            assert(isValidIdxM(idxM));
+
+            if (ch == getCharFromIdxM(idxM))
+            {
+                idxS = idxM2S(idxM);
+                return relativePos + calcSumOfWeightOfBtmS(idxS / kBtmBS, 0, idxS % kBtmBS);
+            }
+            idxS = calcPredIdxSFromIdxM(rootS, ch, idxM);
+            return calcSumOfWeightOfBtmS(idxS / kBtmBS, 0, (idxS % kBtmBS) + 1);
+        }
+
     public:
         //////////////////////////////// Iterator like functions
         /*!
@@ -2218,6 +3016,7 @@ namespace itmmti
         void asgnLabel(
             const uint64_t btmM) noexcept
         {
+            counters_.inc(HotCounter::kAsgnLabel);
             uint64_t next = getNextBtmM(btmM);
             uint64_t prev = getPrevBtmM(btmM); // assume that prev alwarys exists
             uint64_t base = (next == BTreeNodeT::NOTFOUND) ? TagRelabelAlgo::MAX_LABEL : getLabelFromBtmM(next);
@@ -2255,6 +3054,7 @@ namespace itmmti
             }
 
             // relabel num labels
+            counters_.inc(HotCounter::kRelabel, num);
             uint64_t tmpLabel = base << l;
             const uint64_t interval = (UINT64_C(1) << l) / num;
             while (true)
@@ -2307,6 +3107,7 @@ namespace itmmti
             //   std::cerr << __FUNCTION__ << std::endl;
             // }
 
+            counters_.inc(HotCounter::kSplitBtmM);
             auto *uNode = getParentFromBtmM(btmM1);
             const auto idxInSib = getIdxInSiblingFromBtmM(btmM1);
             const auto oriNum = uNode->getNumChildren();
@@ -2490,6 +3291,7 @@ namespace itmmti
             // }
             const uint64_t btmS = setNewBtmNodeS(ch);
             const uint64_t newIdxS = btmS * kBtmBS;
+            btmSInfo_.registerFstBtmSOfChar(ch, btmS);
 
             auto *newRootS = new BTreeNodeT(reinterpret_cast<void *>(btmS), true, true, true, false);
             newRootS->putFirstBtm(reinterpret_cast<void *>(btmS), 0);
@@ -2842,40 +3644,312 @@ namespace itmmti
          * @node For simplicity, assume the following two cases (which are necessary for online construction):
          *   - numChild_ins == 1 and numChild_del == 0, or
          *   - numChild_ins == 3 and numChild_del == 1.
+         * @note Implementation is chosen by WeightTag of bottom node type of M-tree.
+         */
+        uint64_t insertNewElemM(
+            const uint64_t idxBase,
+            const uint8_t childIdx,
+            const uint64_t *newVals,  //!< Storing stcc vals to insert
+            const uint64_t *newLinks, //!< Storing new links to insert
+            const uint8_t numChild_ins,
+            const uint8_t numChild_del //!< Length of wCodes of tgt to delete
+            ) noexcept
+        {
+            return insertNewElemM(idxBase, childIdx, newVals, newLinks, numChild_ins, numChild_del, typename BtmMInfoT::WeightTag());
+        }
+
+        /*!
+         * @brief Implementation of insertNewElemM for ::BtmNodeM_StepCode.
+         */
+        uint64_t insertNewElemM(
+            const uint64_t idxBase,
+            const uint8_t childIdx,
+            const uint64_t *newVals,  //!< Storing stcc vals to insert
+            const uint64_t *newLinks, //!< Storing new links to insert
+            const uint8_t numChild_ins,
+            const uint8_t numChild_del, //!< Length of wCodes of tgt to delete
+            StepCodeWeightTag) noexcept
+        {
+            assert(numChild_ins <= kBtmBM);
+            assert(childIdx + numChild_del <= getNumChildrenFromBtmM(idxBase / kBtmBM)); // could be equal. Especialy "childIdx" could be "numChildren"
+            // {//debug
+            //   std::cerr << __func__ << ": idxBase = " << idxBase << ", childIdx = " << (int)childIdx
+            //             << ", numChild_ins = " << (int)numChild_ins << ", numChild_del = " << (int)numChild_del << std::endl;
+            //   // btmPtrs_[insertMorS][idxBase / kBtmB]->printDebugInfo(std::cerr);
+            // }
+
+            auto &btmNodeM = btmMInfo_.getBtmNodeRef(idxBase / kBtmBM);
+            uint64_t wCodesTemp[1];
+            uint16_t sumW_ins = 0;
+            for (uint8_t i = 0; i < numChild_ins; ++i)
+            {
+                uint8_t w = StepCodeUtil::calcSteppedW(newVals[i]);
+                sumW_ins += w;
+                StepCodeUtil::writeWCode(StepCodeUtil::calcWCodeFromSteppedW(w), wCodesTemp, i);
+            }
+
+            const uint8_t num_old = btmNodeM.getNumChildren();
+            const uint16_t num = static_cast<uint16_t>(num_old) + numChild_ins - numChild_del;
+            if (num <= static_cast<uint16_t>(kBtmBM))
+            { // Easy case: This node can accommodate inserting elements.
+                makeSpaceInOneBtmNodeM(idxBase + childIdx, wCodesTemp, sumW_ins, numChild_ins, numChild_del);
+                writeNewElemInOneBtmM(idxBase + childIdx, newVals, newLinks, numChild_ins);
+                return idxBase + childIdx;
+            }
+
+            const uint8_t excess = static_cast<uint8_t>(num - kBtmBM);
+            auto parent = btmNodeM.getParent();
+            const auto idxInSib = btmNodeM.getIdxInSibling();
+            if (idxInSib)
+            { // Check previous sibling.
+                uint64_t lBtmM = reinterpret_cast<uintptr_t>(parent->getChildPtr(idxInSib - 1));
+                auto &lBtmNodeM = btmMInfo_.getBtmNodeRef(lBtmM);
+                const auto numL = lBtmNodeM.getNumChildren();
+                if (kBtmBM - numL >= excess + 2)
+                { // +2 for simplisity
+                    counters_.inc(HotCounter::kOverflowToLeftM);
+                    const auto retIdx = overflowToLeftM(lBtmM * kBtmBM, idxBase, childIdx, wCodesTemp, numChild_ins, numChild_del);
+                    writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins);
+                    parent->changePSumAt(idxInSib - 1, parent->getPSum(idxInSib) + calcSumOfWeightOfBtmM(lBtmM, numL, lBtmNodeM.getNumChildren()));
+                    return retIdx;
+                }
+            }
+
+            if (idxInSib + 1 < parent->getNumChildren())
+            { // Check next sibling.
+                uint64_t rBtmM = reinterpret_cast<uintptr_t>(parent->getChildPtr(idxInSib + 1));
+                auto &rBtmNodeM = btmMInfo_.getBtmNodeRef(rBtmM);
+                const auto numR = rBtmNodeM.getNumChildren();
+                if (kBtmBM - numR >= excess + 2)
+                { // +2 for simplisity
+                    counters_.inc(HotCounter::kOverflowToRightM);
+                    const auto retIdx = overflowToRightM(idxBase, rBtmM * kBtmBM, childIdx, wCodesTemp, numChild_ins, numChild_del);
+                    writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins);
+                    parent->changePSumAt(idxInSib, parent->getPSum(idxInSib + 1) - calcSumOfWeightOfBtmM(rBtmM, 0, rBtmNodeM.getNumChildren() - numR));
+                    return retIdx;
+                }
+            }
+
+            { // This bottom node has to be split
+                const auto rBtmM = setNewBtmNodeM();
+                const auto retIdx = overflowToRightM(idxBase, rBtmM * kBtmBM, childIdx, wCodesTemp, numChild_ins, numChild_del);
+                writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins);
+                handleSplitOfBtmInBtmM(idxBase / kBtmBM, rBtmM);
+                return retIdx;
+            }
+        }
+
+        /*!
+         * @brief Move "num" elements (weights, links and samples) from "srcIdxM" to "tgtIdxM" for ::BtmNodeM_Plain.
+         * @note Prefix sums of bottom nodes are not updated.
+         */
+        void mvElemM(
+            const uint64_t srcIdxM,
+            const uint64_t tgtIdxM,
+            const uint8_t num) noexcept
+        {
+            auto &tgtNode = btmMInfo_.getBtmNodeRef(tgtIdxM / kBtmBM);
+            tgtNode.mvWeights(btmMInfo_.getBtmNodeRef(srcIdxM / kBtmBM), srcIdxM % kBtmBM, tgtIdxM % kBtmBM, num);
+            if (srcIdxM < tgtIdxM && tgtIdxM < srcIdxM + num)
+            {
+                mvIdxRL(idxM2S_, srcIdxM, tgtIdxM, num, idxS2M_);
+            }
+            else
+            {
+                mvIdxLR(idxM2S_, srcIdxM, tgtIdxM, num, idxS2M_);
+            }
+            samples_.mvSamples(srcIdxM, tgtIdxM, num);
+        }
+
+        void makeSpaceInOneBtmNodeM(
+            const uint64_t idxM,
+            const uint8_t numChild_ins,
+            const uint8_t numChild_del, //!< Num of elements of tgt to delete.
+            PlainWeightTag) noexcept
+        {
+            auto &btmNodeM = btmMInfo_.getBtmNodeRef(idxM / kBtmBM);
+            const uint8_t childIdx = idxM % kBtmBM;
+            const uint8_t tailNum = btmNodeM.getNumChildren() - (childIdx + numChild_del); // at least 0 by assumption.
+            if (tailNum)
+            {
+                mvElemM(idxM + numChild_del, idxM + numChild_ins, tailNum);
+            }
+            btmNodeM.setNumChildren(btmNodeM.getNumChildren() + numChild_ins - numChild_del);
+        }
+
+        /*!
+         * @brief Counterpart of overflowToLeftM for ::BtmNodeM_Plain, which makes space for new elements.
+         */
+        uint64_t overflowToLeftM(
+            const uint64_t lIdxBase,
+            const uint64_t rIdxBase,
+            const uint8_t childIdx,
+            const uint8_t numChild_ins,
+            const uint8_t numChild_del, //!< Num of elements of tgt to delete.
+            PlainWeightTag) noexcept
+        {
+            assert(childIdx + numChild_del <= getNumChildrenFromBtmM(rIdxBase / kBtmBM));
+
+            auto &lnode = btmMInfo_.getBtmNodeRef(lIdxBase / kBtmBM);
+            auto &rnode = btmMInfo_.getBtmNodeRef(rIdxBase / kBtmBM);
+
+            const uint8_t numL_old = lnode.getNumChildren();
+            const uint8_t numR_old = rnode.getNumChildren();
+            const uint8_t numTotal = numL_old + numR_old + numChild_ins - numChild_del;
+            const uint8_t numOldMid = (numL_old + numR_old) / 2;
+            const bool isNewElemInL = numL_old + childIdx < numOldMid;
+            const uint8_t numL_new = (isNewElemInL) ? numOldMid + numChild_ins - numChild_del : numOldMid;
+            const uint8_t numR_new = numTotal - numL_new;
+            const uint8_t numToLeft = numL_new - numL_old;
+
+            uint8_t numL = numL_old;
+            uint8_t curNumAfterDel = 0;
+            {
+                const auto num = (isNewElemInL) ? childIdx : numToLeft;
+                if (num)
+                {
+                    mvElemM(rIdxBase, lIdxBase + numL, num);
+                    numL += num;
+                }
+            }
+            if (isNewElemInL)
+            {
+                numL += numChild_ins;
+                if (numL < numL_new)
+                { // Still need to move elements to left after new elements
+                    curNumAfterDel = numL_new - numL;
+                    mvElemM(rIdxBase + childIdx + numChild_del, lIdxBase + numL, curNumAfterDel);
+                }
+            }
+            lnode.setNumChildren(numL_new);
+
+            if (numToLeft < childIdx)
+            {
+                mvElemM(rIdxBase + numToLeft, rIdxBase, childIdx - numToLeft);
+            }
+            if (numR_old != childIdx + numChild_del && numR_old != numR_new)
+            { // Need shift remaining children in tail.
+                const uint8_t srcBeg = childIdx + numChild_del + curNumAfterDel;
+                const uint8_t num = numR_old - srcBeg;
+                mvElemM(rIdxBase + srcBeg, rIdxBase + numR_new - num, num);
+            }
+            rnode.setNumChildren(numR_new);
+
+            return (isNewElemInL) ? lIdxBase + numL_old + childIdx : rIdxBase + childIdx - numToLeft;
+        }
+
+        /*!
+         * @brief Counterpart of overflowToRightM for ::BtmNodeM_Plain, which makes space for new elements.
+         */
+        uint64_t overflowToRightM(
+            const uint64_t lIdxBase,
+            const uint64_t rIdxBase,
+            const uint8_t childIdx,
+            const uint8_t numChild_ins,
+            const uint8_t numChild_del, //!< Num of elements of tgt to delete.
+            PlainWeightTag) noexcept
+        {
+            assert(childIdx + numChild_del <= getNumChildrenFromBtmM(lIdxBase / kBtmBM));
+
+            auto &lnode = btmMInfo_.getBtmNodeRef(lIdxBase / kBtmBM);
+            auto &rnode = btmMInfo_.getBtmNodeRef(rIdxBase / kBtmBM);
+
+            const uint8_t numL_old = lnode.getNumChildren();
+            const uint8_t numR_old = rnode.getNumChildren();
+            const uint8_t numOldTotal = numL_old + numR_old;
+            const uint8_t numOldMid = numOldTotal / 2;
+            const bool isNewElemInL = (childIdx < numOldMid);
+
+            uint8_t numToRight1 = 0;
+            uint8_t numToRight2 = 0;
+            uint8_t numL_new = numOldMid;
+            uint8_t numR_new = numOldTotal - numOldMid;
+            if (isNewElemInL)
+            { // new elements are in L
+                numToRight2 = numL_old - numOldMid;
+                numL_new += numChild_ins - numChild_del;
+            }
+            else
+            { // new elements are in R
+                numToRight1 = childIdx - numOldMid;
+                numToRight2 = numL_old - (childIdx + numChild_del);
+                numR_new += numChild_ins - numChild_del;
+            }
+            const uint8_t numToRight = numR_new - numR_old;
+
+            if (numR_old)
+            { // shift elements of R to make space
+                mvElemM(rIdxBase, rIdxBase + numToRight, numR_old);
+            }
+            uint8_t numR_increment = 0;
+            if (numToRight1)
+            {
+                mvElemM(lIdxBase + childIdx - numToRight1, rIdxBase, numToRight1);
+                numR_increment += numToRight1;
+            }
+            if (!isNewElemInL)
+            {
+                numR_increment += numChild_ins;
+            }
+            if (numToRight2)
+            {
+                mvElemM(lIdxBase + numL_old - numToRight2, rIdxBase + numR_increment, numToRight2);
+            }
+            rnode.setNumChildren(numR_new);
+
+            if (isNewElemInL)
+            {
+                const uint8_t numTail = numL_new - (childIdx + numChild_ins);
+                if (numTail)
+                {
+                    mvElemM(lIdxBase + childIdx + numChild_del, lIdxBase + childIdx + numChild_ins, numTail);
+                }
+            }
+            lnode.setNumChildren(numL_new);
+
+            return (isNewElemInL) ? lIdxBase + childIdx : rIdxBase + childIdx - numL_new;
+        }
+
+        void writeNewElemInOneBtmM(
+            const uint64_t idxM,
+            const uint64_t *newWeights, //!< Storing weights to insert
+            const uint64_t *newLinks,   //!< Storing new links to insert
+            const uint8_t numChild_ins,
+            PlainWeightTag) noexcept
+        {
+            const uint64_t btmM = idxM / kBtmBM;
+            const uint8_t childIdx = idxM % kBtmBM;
+            auto &btmNodeM = btmMInfo_.getBtmNodeRef(btmM);
+            for (uint8_t i = 0; i < numChild_ins; ++i)
+            {
+                idxM2S_.write(newLinks[i], idxM + i);
+                btmNodeM.writeWeight(newWeights[i], childIdx + i);
+            }
+        }
+
+        /*!
+         * @brief Counterpart of insertNewElemM for ::BtmNodeM_Plain.
          */
         uint64_t insertNewElemM(
             const uint64_t idxBase,
             const uint8_t childIdx,
-            const uint64_t *newVals,  //!< Storing stcc vals to insert
+            const uint64_t *newVals,  //!< Storing weights to insert
             const uint64_t *newLinks, //!< Storing new links to insert
             const uint8_t numChild_ins,
-            const uint8_t numChild_del //!< Length of wCodes of tgt to delete
-            ) noexcept
+            const uint8_t numChild_del, //!< Num of elements of tgt to delete
+            PlainWeightTag tag) noexcept
         {
             assert(numChild_ins <= kBtmBM);
             assert(childIdx + numChild_del <= getNumChildrenFromBtmM(idxBase / kBtmBM)); // could be equal. Especialy "childIdx" could be "numChildren"
-            // {//debug
-            //   std::cerr << __func__ << ": idxBase = " << idxBase << ", childIdx = " << (int)childIdx
-            //             << ", numChild_ins = " << (int)numChild_ins << ", numChild_del = " << (int)numChild_del << std::endl;
-            //   // btmPtrs_[insertMorS][idxBase / kBtmB]->printDebugInfo(std::cerr);
-            // }
 
             auto &btmNodeM = btmMInfo_.getBtmNodeRef(idxBase / kBtmBM);
-            uint64_t wCodesTemp[1];
-            uint16_t sumW_ins = 0;
-            for (uint8_t i = 0; i < numChild_ins; ++i)
-            {
-                uint8_t w = StepCodeUtil::calcSteppedW(newVals[i]);
-                sumW_ins += w;
-                StepCodeUtil::writeWCode(StepCodeUtil::calcWCodeFromSteppedW(w), wCodesTemp, i);
-            }
-
             const uint8_t num_old = btmNodeM.getNumChildren();
             const uint16_t num = static_cast<uint16_t>(num_old) + numChild_ins - numChild_del;
             if (num <= static_cast<uint16_t>(kBtmBM))
             { // Easy case: This node can accommodate inserting elements.
-                makeSpaceInOneBtmNodeM(idxBase + childIdx, wCodesTemp, sumW_ins, numChild_ins, numChild_del);
-                writeNewElemInOneBtmM(idxBase + childIdx, newVals, newLinks, numChild_ins);
+                makeSpaceInOneBtmNodeM(idxBase + childIdx, numChild_ins, numChild_del, tag);
+                writeNewElemInOneBtmM(idxBase + childIdx, newVals, newLinks, numChild_ins, tag);
+                btmNodeM.updatePSums(childIdx);
                 return idxBase + childIdx;
             }
 
@@ -2889,8 +3963,11 @@ namespace itmmti
                 const auto numL = lBtmNodeM.getNumChildren();
                 if (kBtmBM - numL >= excess + 2)
                 { // +2 for simplisity
-                    const auto retIdx = overflowToLeftM(lBtmM * kBtmBM, idxBase, childIdx, wCodesTemp, numChild_ins, numChild_del);
-                    writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins);
+                    counters_.inc(HotCounter::kOverflowToLeftM);
+                    const auto retIdx = overflowToLeftM(lBtmM * kBtmBM, idxBase, childIdx, numChild_ins, numChild_del, tag);
+                    writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins, tag);
+                    lBtmNodeM.updatePSums(numL);
+                    btmNodeM.updatePSums(0);
                     parent->changePSumAt(idxInSib - 1, parent->getPSum(idxInSib) + calcSumOfWeightOfBtmM(lBtmM, numL, lBtmNodeM.getNumChildren()));
                     return retIdx;
                 }
@@ -2903,8 +3980,11 @@ namespace itmmti
                 const auto numR = rBtmNodeM.getNumChildren();
                 if (kBtmBM - numR >= excess + 2)
                 { // +2 for simplisity
-                    const auto retIdx = overflowToRightM(idxBase, rBtmM * kBtmBM, childIdx, wCodesTemp, numChild_ins, numChild_del);
-                    writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins);
+                    counters_.inc(HotCounter::kOverflowToRightM);
+                    const auto retIdx = overflowToRightM(idxBase, rBtmM * kBtmBM, childIdx, numChild_ins, numChild_del, tag);
+                    writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins, tag);
+                    btmNodeM.updatePSums(childIdx);
+                    rBtmNodeM.updatePSums(0);
                     parent->changePSumAt(idxInSib, parent->getPSum(idxInSib + 1) - calcSumOfWeightOfBtmM(rBtmM, 0, rBtmNodeM.getNumChildren() - numR));
                     return retIdx;
                 }
@@ -2912,8 +3992,10 @@ namespace itmmti
 
             { // This bottom node has to be split
                 const auto rBtmM = setNewBtmNodeM();
-                const auto retIdx = overflowToRightM(idxBase, rBtmM * kBtmBM, childIdx, wCodesTemp, numChild_ins, numChild_del);
-                writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins);
+                const auto retIdx = overflowToRightM(idxBase, rBtmM * kBtmBM, childIdx, numChild_ins, numChild_del, tag);
+                writeNewElemInOneBtmM(retIdx, newVals, newLinks, numChild_ins, tag);
+                btmNodeM.updatePSums(childIdx);
+                btmMInfo_.getBtmNodeRef(rBtmM).updatePSums(0);
                 handleSplitOfBtmInBtmM(idxBase / kBtmBM, rBtmM);
                 return retIdx;
             }
@@ -3142,7 +4224,7 @@ namespace itmmti
             // }
             // update btm node
             auto &btmNodeM = btmMInfo_.getBtmNodeRef(idxM / kBtmBM);
-            const uint64_t curWeight = btmNodeM.readStccVal(idxM % kBtmBM);
+            const uint64_t curWeight = btmNodeM.readWeight(idxM % kBtmBM);
             const uint64_t uschange = static_cast<uint64_t>(change); // cast to unsigned
             // assert(curWeight + change > 0);
             const uint64_t newVals[] = {curWeight + uschange};
@@ -3258,6 +4340,182 @@ namespace itmmti
             return newIdxM;
         }
 
+        /*!
+         * @brief Variant of insertRunAfter, where idxS of the predecessor run of 'ch' is already known.
+         * @note If "predIdxS" is BTreeNodeT::NOTFOUND, it is searched (and new separated tree is set up if needed).
+         */
+        uint64_t insertRunAfter(
+            const uint64_t idxM,
+            const CharT ch,         //!< Character to insert.
+            const uint64_t predIdxS //!< IdxS of the last run of 'ch' before the inserted run.
+            ) noexcept
+        {
+            if (predIdxS == BTreeNodeT::NOTFOUND)
+            {
+                return insertRunAfter(idxM, ch);
+            }
+            changePSumFromParentM(idxM / kBtmBM, 1);
+            const auto newIdxM = insertRunAfterM(idxM, 0);
+            changePSumFromParentS(predIdxS / kBtmBS, 1);
+            const auto newIdxS = insertRunAfterS(predIdxS, newIdxM, ch);
+            idxM2S_.write(newIdxS, newIdxM);
+            return newIdxM;
+        }
+
+        /*!
+         * @brief Variant of insertRunWithSplit, where idxS of the predecessor run of 'ch' is already known.
+         * @note If "predIdxS" is BTreeNodeT::NOTFOUND, it is searched (and new separated tree is set up if needed).
+         */
+        uint64_t insertRunWithSplit(
+            const uint64_t idxM,
+            const uint64_t splitPos,
+            const CharT ch,         //!< Character to insert.
+            const uint64_t predIdxS //!< IdxS of the last run of 'ch' before the inserted run.
+            ) noexcept
+        {
+            if (predIdxS == BTreeNodeT::NOTFOUND)
+            {
+                return insertRunWithSplit(idxM, splitPos, ch);
+            }
+            const uint64_t idxS0 = idxM2S(idxM);
+            uint64_t tempIdxM = insertRunWithSplitM(idxM, splitPos);
+            if (idxM != tempIdxM)
+            {
+                idxS2M_.write(tempIdxM, idxS0);
+            }
+            const auto newIdxM = getNextIdxM(tempIdxM);
+            { // insert new run with character "ch"
+                changePSumFromParentS(predIdxS / kBtmBS, 1);
+                const auto idxS = insertRunAfterS(predIdxS, newIdxM, ch);
+                idxM2S_.write(idxS, newIdxM);
+            }
+            { // insert second half of splitted run
+                tempIdxM = getNextIdxM(newIdxM);
+                const auto idxS = insertRunAfterS(idxS0, tempIdxM, ch);
+                idxM2S_.write(idxS, tempIdxM);
+            }
+            return newIdxM;
+        }
+
+        /*!
+         * @brief Append run of "ch^{exponent}" at the end without merge, used for bulk loading.
+         * @return IdxM of the run.
+         * @note
+         *   The run is put into the last bottom node of M-tree and the one of S-tree of "ch" as long as it has room,
+         *   and otherwise a new bottom node holding only the run is linked to the tree,
+         *   so that bottom nodes are filled up (in contrast to splitting them in half).
+         */
+        uint64_t appendRunForBulkLoad(
+            const CharT ch,           //!< Character of new run.
+            const uint64_t exponent,  //!< Exponent (> 0) of new run.
+            uint64_t &predIdxS,       //!< [in,out] IdxS of the last run of "ch" (BTreeNodeT::NOTFOUND if unknown). It is set to idxS of new run.
+            const uint64_t labelStep  //!< Interval of TRA-labels for new bottom nodes of M-tree (0 to leave them to asgnLabel).
+            ) noexcept
+        {
+            assert(exponent > 0);
+
+            uint64_t newIdxM;
+            { // M-tree
+                const auto btmM = reinterpret_cast<uint64_t>(srootM_.root_->getRmBtm());
+                const uint8_t numM = getNumChildrenFromBtmM(btmM);
+                const uint64_t newVals[] = {exponent};
+                const uint64_t newLinks[] = {0}; // set later
+                changePSumFromParentM(btmM, static_cast<int64_t>(exponent));
+                if (numM < kBtmBM)
+                {
+                    newIdxM = insertNewElemM(btmM * kBtmBM, numM, newVals, newLinks, 1, 0);
+                }
+                else
+                {
+                    const auto rBtmM = setNewBtmNodeM();
+                    newIdxM = insertNewElemM(rBtmM * kBtmBM, 0, newVals, newLinks, 1, 0);
+                    handleSplitOfBtmInBtmM(btmM, rBtmM); // weight of rBtmM is moved from btmM
+                    const uint64_t predLabel = getLabelFromBtmM(btmM);
+                    if (labelStep && predLabel < TagRelabelAlgo::MAX_LABEL - labelStep)
+                    { // Overwrite label given by asgnLabel, which halves the remaining label space.
+                        btmMInfo_.setLabel(rBtmM, predLabel + labelStep);
+                    }
+                }
+            }
+
+            if (predIdxS == BTreeNodeT::NOTFOUND)
+            {
+                auto *retRootS = searchCharA(ch);
+                if (retRootS->isDummy() || getCharFromNodeS(retRootS) != ch)
+                {
+                    predIdxS = setupNewSTree(retRootS, ch);
+                }
+                else
+                {
+                    predIdxS = calcPredIdxSFromIdxM(retRootS, ch, newIdxM);
+                }
+            }
+            { // S-tree
+                const auto btmS = predIdxS / kBtmBS;
+                const uint8_t numS = getNumChildrenFromBtmS(btmS);
+                assert(predIdxS % kBtmBS + 1 == numS); // "predIdxS" is the last in S-tree of "ch"
+                changePSumFromParentS(btmS, static_cast<int64_t>(exponent));
+                if (numS < kBtmBS)
+                {
+                    predIdxS = insertRunAfterS(predIdxS, newIdxM, ch);
+                }
+                else
+                {
+                    const auto rBtmS = setNewBtmNodeS(ch);
+                    predIdxS = rBtmS * kBtmBS;
+                    btmSInfo_.setNumChildren(rBtmS, 1);
+                    idxS2M_.write(newIdxM, predIdxS);
+                    handleSplitOfBtmInBtmS(btmS, rBtmS); // weight of rBtmS is moved from btmS
+                }
+            }
+            idxM2S_.write(predIdxS, newIdxM);
+            return newIdxM;
+        }
+
+        /*!
+         * @brief States kept between runs in bulk loading.
+         */
+        struct BulkLoadCursor
+        {
+            static constexpr uint64_t kNumTableChars{256}; //!< Characters whose last idxS are tabulated (others are searched).
+
+            std::vector<uint64_t> lastIdxS; //!< IdxS of the last run of each character.
+            uint64_t lastIdxM;              //!< IdxM of the last run (0 if none).
+            uint64_t labelStep;             //!< Interval of TRA-labels for new bottom nodes of M-tree.
+
+            explicit BulkLoadCursor(
+                const uint64_t givenLabelStep) : lastIdxS(kNumTableChars, BTreeNodeT::NOTFOUND),
+                                                 lastIdxM(0),
+                                                 labelStep(givenLabelStep)
+            {
+            }
+        };
+
+        /*!
+         * @brief Append run of "ch^{exponent}" at the end, merging into the last run if possible and "merge" is true.
+         * @return IdxM of the last run.
+         */
+        uint64_t bulkLoadRun(
+            const CharT ch,
+            const uint64_t exponent,
+            BulkLoadCursor &cursor,
+            const bool merge = true) noexcept
+        {
+            if (exponent == 0)
+            {
+                return cursor.lastIdxM;
+            }
+            if (merge && cursor.lastIdxM && getCharFromIdxM(cursor.lastIdxM) == ch)
+            {
+                changeWeight(cursor.lastIdxM, static_cast<int64_t>(exponent));
+                return cursor.lastIdxM;
+            }
+            uint64_t predIdxS = BTreeNodeT::NOTFOUND;
+            uint64_t &tgtIdxS = (static_cast<uint64_t>(ch) < BulkLoadCursor::kNumTableChars) ? cursor.lastIdxS[static_cast<uint64_t>(ch)] : predIdxS;
+            cursor.lastIdxM = appendRunForBulkLoad(ch, exponent, tgtIdxS, cursor.labelStep);
+            return cursor.lastIdxM;
+        }
+
     public:
         //////////////////////////////// Public functions (interface)
         /*!
@@ -3284,6 +4542,7 @@ namespace itmmti
             //   std::cerr << __func__ << ": pos = " << pos << ", ch = " << ch << std::endl;
             // }
 
+            counters_.inc(HotCounter::kPushbackRun);
             const auto btmM = reinterpret_cast<uint64_t>(srootM_.root_->getRmBtm());
             const auto idxM = btmM * kBtmBM + getNumChildrenFromBtmM(btmM) - 1;
             const auto idxS = idxM2S(idxM);
@@ -3339,17 +4598,48 @@ namespace itmmti
         }
 
         /*!
-         * @brief Pushback a run without merge.
+         * @brief Pushback a run of "ch^{exponent}" without merge.
+         * @return IdxM of the run.
          */
-        // uint64_t pushbackRunWithoutMerge
-        // (
-        //  const uint64_t ch, //!< 64bit-char.
-        //  const uint64_t weight, //!< Weight (exponent) of new run.
-        //  const uint64_t leafVal
-        //  ) {
-        //   const auto btmNodeM = reinterpret_cast<BtmNode *>(srootM_.root_->getRmBtm());
-        //   return insertRunAfter(calcIdxBase(btmNodeM, btmPtrs_[kS]) + btmNodeM.getNumChildrenFromBtmM() - 1, weight, leafVal, ch);
-        // }
+        uint64_t pushbackRunWithoutMerge(
+            const CharT ch,         //!< Character of new run.
+            const uint64_t exponent //!< Exponent (> 0) of new run.
+        )
+        {
+            assert(exponent > 0);
+
+            const auto btmM = reinterpret_cast<uint64_t>(srootM_.root_->getRmBtm());
+            const auto idxM = insertRunAfter(btmM * kBtmBM + getNumChildrenFromBtmM(btmM) - 1, ch);
+            if (exponent > 1)
+            {
+                changeWeight(idxM, static_cast<int64_t>(exponent - 1));
+            }
+            return idxM;
+        }
+
+        /*!
+         * @brief Build from runs in ["beg", "end") in time linear in num of runs (previous data is cleared).
+         * @note
+         *   "*it" should give pair-like (first: character, second: exponent), e.g., std::pair<CharT, uint64_t>.
+         *   Runs of exponent 0 are ignored and adjacent runs of the same character are merged.
+         *   Bottom nodes are filled up and, if "numRunsHint" is given, TRA-labels are spread evenly in advance,
+         *   while B+tree nodes above bottoms are linked by the usual handling of splits.
+         */
+        template <class RunIterator>
+        void bulkLoad(
+            RunIterator beg,
+            RunIterator end,
+            const uint64_t numRunsHint = 0 //!< Expected num of runs (0 if unknown).
+        )
+        {
+            const uint64_t numBtmsHint = numRunsHint / kBtmBM + 1;
+            init(numBtmsHint, 0);
+            BulkLoadCursor cursor(numRunsHint ? TagRelabelAlgo::MAX_LABEL / (numBtmsHint + 1) : 0);
+            for (; beg != end; ++beg)
+            {
+                bulkLoadRun(static_cast<CharT>((*beg).first), static_cast<uint64_t>((*beg).second), cursor);
+            }
+        }
 
         /*!
          * @brief Insert run of "ch^{1}" at relative position in "idxM", merging into adjacent runs if possible.
@@ -3363,9 +4653,11 @@ namespace itmmti
             // {//debug
             //   std::cerr << __func__ << ": idxM = " << idxM << ", pos = " << pos << ", ch = " << ch << std::endl;
             // }
+            counters_.inc(HotCounter::kInsertRun);
             auto chNow = getCharFromIdxM(idxM);
             if (ch == chNow)
             {
+                counters_.inc(HotCounter::kInsertRunMerge);
                 changeWeight(idxM, 1);
             }
             else if (pos == 0)
@@ -3373,6 +4665,7 @@ namespace itmmti
                 idxM = getPrevIdxM(idxM); // Move to previous idxM.
                 if (idxM > 0 && ch == getCharFromIdxM(idxM))
                 { // Check if 'ch' can be merged with the previous run.
+                    counters_.inc(HotCounter::kInsertRunMerge);
                     pos = getWeightFromIdxM(idxM);
                     changeWeight(idxM, 1);
                 }
@@ -3383,12 +4676,53 @@ namespace itmmti
             }
             else
             { // Current run is split with fstHalf of weight 'pos'.
+                counters_.inc(HotCounter::kInsertRunSplit);
                 idxM = insertRunWithSplit(idxM, pos, ch);
                 pos = 0;
             }
             return idxM;
         }
 
+        /*!
+         * @brief Variant of insertRun, where idxS of the last run of 'ch' before "idxM" is already known.
+         */
+        uint64_t insertRun(
+            uint64_t idxM,
+            uint64_t &pos,          //!< [in,out] 0base position where inserted run will start. It is modified to relative position in a run.
+            const CharT ch,         //!< Character to insert.
+            const uint64_t predIdxS //!< IdxS of the last run of 'ch' before "idxM", or BTreeNodeT::NOTFOUND if unknown.
+        )
+        {
+            counters_.inc(HotCounter::kInsertRun);
+            auto chNow = getCharFromIdxM(idxM);
+            if (ch == chNow)
+            {
+                counters_.inc(HotCounter::kInsertRunMerge);
+                changeWeight(idxM, 1);
+            }
+            else if (pos == 0)
+            {
+                idxM = getPrevIdxM(idxM); // Move to previous idxM.
+                if (idxM > 0 && ch == getCharFromIdxM(idxM))
+                { // Check if 'ch' can be merged with the previous run.
+                    counters_.inc(HotCounter::kInsertRunMerge);
+                    pos = getWeightFromIdxM(idxM);
+                    changeWeight(idxM, 1);
+                }
+                else
+                {
+                    idxM = insertRunAfter(idxM, ch, predIdxS);
+                }
+            }
+            else
+            { // Current run is split with fstHalf of weight 'pos'.
+                counters_.inc(HotCounter::kInsertRunSplit);
+                idxM = insertRunWithSplit(idxM, pos, ch, predIdxS);
+                pos = 0;
+            }
+            return idxM;
+        }
+
         /*!
          * @brief Insert run of "ch^{1}" at "pos", merging into adjacent runs if possible.
          */
@@ -3405,7 +4739,7 @@ namespace itmmti
             {
                 return pushbackRun(pos, ch);
             }
-            auto idxM = searchPosM(pos); // 'pos' is modified to be the relative pos in the run of 'idxM'.
+            auto idxM = searchPosM(pos, fingerM_); // 'pos' is modified to be the relative pos in the run of 'idxM'.
             return insertRun(idxM, pos, ch);
         }
 
@@ -3428,22 +4762,24 @@ namespace itmmti
         {
             // first: Find if the position of sap_s − 1 is exactly ch
             // std::cout << "sap_s: " << sap_s << std::endl;
+            counters_.inc(HotCounter::kOptInsert);
             uint64_t idxM = 0;
             uint64_t pos = 0;
             if (sap_s != 0)
             {
                 uint64_t pos = sap_s - 1;
-                idxM = searchPosM(pos);
+                idxM = searchPosM(pos, fingerM_);
                 auto chNow = getCharFromIdxM(idxM);
                 if (ch == chNow)
                 {
+                    counters_.inc(HotCounter::kOptInsertExtend);
                     changeWeight(idxM, 1);
                     return idxM;
                 }
             }
             // second: Determine whether the run at this position sap_s exceeds sap_e
             pos = sap_s;
-            idxM = searchPosM(pos);
+            idxM = searchPosM(pos, fingerM_);
             auto weight = getWeightFromIdxM(idxM);
             if (sap_s - pos + weight - 1 < sap_e)
             {
@@ -3453,6 +4789,202 @@ namespace itmmti
             return insertRun(pos, ch);
         }
 
+        /*!
+         * @brief Insert "ch" into sap-interval [sap_s..sap_e] and advance the interval by "ch" in one step.
+         * @return IdxM of the run where "ch" is inserted.
+         * @note The insertion follows the same rules as insertRun/optInsert used by OnlineRlbwt::sptExtend,
+         *       and the next interval is [C[ch] + rank_{ch}[0..sap_s) + 1, C[ch] + rank_{ch}[0..sap_e) + 1] w.r.t. T before the insertion.
+         *       Runs found for computing ranks are reused for the insertion, and the run of 'sap_e' is first searched in btmM of 'sap_s'.
+         */
+        uint64_t extendAndAdvance(
+            uint64_t &sap_s, //!< [in,out] Beginning of sap-interval. It is modified to the one of next interval.
+            uint64_t &sap_e, //!< [in,out] End of sap-interval (sap_s <= sap_e <= |T|). It is modified to the one of next interval.
+            const CharT ch   //!< Character to insert.
+        )
+        {
+            assert(isReady());
+            assert(sap_s <= sap_e);
+            assert(sap_e <= srootM_.root_->getSumOfWeight());
+
+            const uint64_t totalLen = srootM_.root_->getSumOfWeight();
+            const auto *rootS = searchCharA(ch);
+            const bool isNewChar = (rootS->isDummy() || getCharFromNodeS(rootS) != ch);
+            uint64_t numSmaller = rootS->getParent()->calcPSum(rootS->getIdxInSibling());
+            if (isNewChar)
+            { // 'rootS' is the one for the largest character smaller than 'ch'.
+                numSmaller += rootS->getSumOfWeight();
+            }
+
+            uint64_t idxM = BTreeNodeT::NOTFOUND;
+            uint64_t relPos = sap_s;
+            uint64_t predIdxS = BTreeNodeT::NOTFOUND;
+            uint64_t rank_s = 0; // rank_{ch}[0..sap_s)
+            uint64_t psumS = 0;  // Sum of weights of btmS preceding btmS of "predIdxS".
+            if (sap_s < totalLen)
+            {
+                idxM = searchPosM(relPos, fingerM_); // 'relPos' is modified to be the relative pos in the run of 'idxM'.
+                if (!isNewChar)
+                {
+                    rank_s = calcRankInBtmS(rootS, ch, idxM, relPos, predIdxS);
+                    psumS = getParentFromBtmS(predIdxS / kBtmBS)->calcPSum(getIdxInSiblingFromBtmS(predIdxS / kBtmBS));
+                    rank_s += psumS;
+                }
+            }
+            else if (!isNewChar)
+            {
+                rank_s = rootS->getSumOfWeight();
+            }
+
+            uint64_t rank_e = rank_s; // rank_{ch}[0..sap_e)
+            bool hasChInIntvl = false;
+            if (sap_s < sap_e)
+            {
+                uint64_t idxME = BTreeNodeT::NOTFOUND;
+                uint64_t relPosE = relPos + (sap_e - sap_s);
+                if (sap_e < totalLen)
+                {
+                    idxME = btmMInfo_.searchPosFrom(idxM, relPosE);
+                    if (idxME == BTreeNodeT::NOTFOUND)
+                    {
+                        relPosE = sap_e;
+                        idxME = searchPosM(relPosE, fingerM_);
+                    }
+                }
+                if (!isNewChar)
+                {
+                    if (idxME != BTreeNodeT::NOTFOUND)
+                    {
+                        uint64_t idxSE;
+                        rank_e = calcRankInBtmS(rootS, ch, idxME, relPosE, idxSE);
+                        if (idxSE / kBtmBS == predIdxS / kBtmBS)
+                        {
+                            rank_e += psumS;
+                        }
+                        else
+                        {
+                            rank_e += getParentFromBtmS(idxSE / kBtmBS)->calcPSum(getIdxInSiblingFromBtmS(idxSE / kBtmBS));
+                        }
+                        hasChInIntvl = (rank_e + (ch == getCharFromIdxM(idxME)) > rank_s);
+                    }
+                    else
+                    {
+                        rank_e = rootS->getSumOfWeight();
+                        hasChInIntvl = (rank_e > rank_s);
+                    }
+                }
+            }
+
+            uint64_t retIdxM;
+            if (sap_s == totalLen)
+            {
+                retIdxM = pushbackRun(relPos, ch);
+            }
+            else if (sap_s == sap_e)
+            {
+                retIdxM = insertRun(idxM, relPos, ch, predIdxS);
+            }
+            else if (hasChInIntvl)
+            { // Merge into the first run of 'ch' in the interval.
+                counters_.inc(HotCounter::kOptInsert);
+                counters_.inc(HotCounter::kOptInsertExtend);
+                retIdxM = (ch == getCharFromIdxM(idxM)) ? idxM : idxS2M(getNextIdxS(predIdxS));
+                changeWeight(retIdxM, 1);
+            }
+            else
+            { // Same as optInsert.
+                counters_.inc(HotCounter::kOptInsert);
+                retIdxM = (sap_s != 0 && relPos == 0) ? getPrevIdxM(idxM) : 0;
+                if (retIdxM > 0 && ch == getCharFromIdxM(retIdxM))
+                {
+                    counters_.inc(HotCounter::kOptInsertExtend);
+                    changeWeight(retIdxM, 1);
+                }
+                else if (sap_s - relPos + getWeightFromIdxM(idxM) - 1 < sap_e)
+                {
+                    retIdxM = insertRunAfter(idxM, ch, predIdxS);
+                }
+                else
+                {
+                    retIdxM = insertRun(idxM, relPos, ch, predIdxS);
+                }
+            }
+
+            sap_s = numSmaller + rank_s + 1;
+            sap_e = numSmaller + rank_e + 1;
+            return retIdxM;
+        }
+
+    public:
+        //////////////////////////////// serialization
+        static constexpr uint64_t kSerialMagic{UINT64_C(0x656c526e7944)}; //!< "DynRle"
+        static constexpr uint64_t kSerialVersion{1};
+
+        /*!
+         * @brief Write runs (character, exponent and sample if used) in binary.
+         * @note Only the sequence of runs is stored, and B+trees are rebuilt by load.
+         */
+        void serialize(
+            std::ostream &os) const
+        {
+            assert(isReady());
+
+            const uint64_t sampleUb = samples_.getSampleUb();
+            uint64_t numRuns = 0;
+            for (uint64_t idxM = getNextIdxM(0); idxM != BTreeNodeT::NOTFOUND; idxM = getNextIdxM(idxM))
+            {
+                ++numRuns;
+            }
+            serialutil::writeHeader(os, kSerialMagic, kSerialVersion);
+            serialutil::writeVal(os, static_cast<uint64_t>(sizeof(CharT)));
+            serialutil::writeVal(os, numRuns);
+            serialutil::writeVal(os, sampleUb);
+            for (uint64_t idxM = getNextIdxM(0); idxM != BTreeNodeT::NOTFOUND; idxM = getNextIdxM(idxM))
+            {
+                serialutil::writeVal(os, getCharFromIdxM(idxM));
+                serialutil::writeVal(os, getWeightFromIdxM(idxM));
+                if (sampleUb)
+                {
+                    serialutil::writeVal(os, samples_.read(idxM));
+                }
+            }
+        }
+
+        /*!
+         * @brief Load data written by serialize (previous data is cleared).
+         * @return false if the format does not match.
+         * @note Use serialutil::MappedFile and serialutil::MemStreamBuf to load from mmap-ed file.
+         */
+        bool load(
+            std::istream &is)
+        {
+            uint64_t charBytes, numRuns, sampleUb;
+            if (!serialutil::readHeader(is, kSerialMagic, kSerialVersion) ||
+                !serialutil::readVal(is, charBytes) || charBytes != sizeof(CharT) ||
+                !serialutil::readVal(is, numRuns) || !serialutil::readVal(is, sampleUb))
+            {
+                return false;
+            }
+            init(numRuns / kBtmBM + 1, sampleUb);
+            BulkLoadCursor cursor(TagRelabelAlgo::MAX_LABEL / (numRuns / kBtmBM + 2));
+            for (uint64_t i = 0; i < numRuns; ++i)
+            {
+                CharT ch;
+                uint64_t exponent, sample = 0;
+                if (!serialutil::readVal(is, ch) || !serialutil::readVal(is, exponent) || exponent == 0 ||
+                    (sampleUb && !serialutil::readVal(is, sample)))
+                {
+                    clearAll();
+                    return false;
+                }
+                const auto idxM = bulkLoadRun(ch, exponent, cursor, false); // Keep runs as serialized so that each sample stays on its run.
+                if (sampleUb)
+                {
+                    samples_.write(sample, idxM);
+                }
+            }
+            return true;
+        }
+
     public:
         //////////////////////////////// statistics
         size_t calcMemBytesMTree() const noexcept
@@ -3579,9 +5111,20 @@ namespace itmmti
             size += calcMemBytesSTree();
             size += calcMemBytesLinks(false);
             size += calcMemBytesSamples(false);
+            size += calcMemBytesFlatIndexM();
             return size;
         }
 
+        /*!
+         * @brief calcMemBytes plus bytes reserved by ::NodeArena but not in use.
+         * @note The arena is process-wide, so that its overhead is shared by all objects allocating from it.
+         */
+        size_t calcMemBytesReserved(
+            bool includeThis = true) const noexcept
+        {
+            return calcMemBytes(includeThis) + NodeArena::getInstance().calcMemBytesOverhead();
+        }
+
         size_t calcNumUsedSTree() const noexcept
         {
             size_t numUsed = 0;
@@ -3638,6 +5181,19 @@ namespace itmmti
             return getNumBtmS() * kBtmBS;
         }
 
+        /*!
+         * @brief Get hot-path counters (all zero unless ONLINE_RLBWT_COUNTERS is defined).
+         */
+        const HotCountersT &getCounters() const noexcept
+        {
+            return counters_;
+        }
+
+        void resetCounters() noexcept
+        {
+            counters_.reset();
+        }
+
         size_t calcNumRuns() const noexcept
         {
             return calcNumUsedBtmM() - 1; // -1 due to the first dummy
@@ -3689,6 +5245,11 @@ namespace itmmti
                 os << "MTree bottom array size = " << getNumBtmM() << ", capacity = " << btmMInfo_.capacity() << std::endl;
                 os << "STree bottom array size = " << getNumBtmS() << ", capacity = " << btmSInfo_.capacity() << std::endl;
                 os << "Total: " << totalBytes << " bytes = " << (double)(totalBytes) / 1024 << " KiB = " << ((double)(totalBytes) / 1024) / 1024 << " MiB" << std::endl;
+                if (NodeArena::getInstance().isEnabled())
+                {
+                    const size_t reservedBytes = totalBytes + NodeArena::getInstance().calcMemBytesOverhead();
+                    os << "Total reserved (with NodeArena overhead): " << reservedBytes << " bytes = " << (double)(reservedBytes) / 1024 << " KiB = " << ((double)(reservedBytes) / 1024) / 1024 << " MiB" << std::endl;
+                }
                 os << "MTree: " << calcMemBytesMTree() << " bytes, OccuRate = " << ((numSlotsM) ? 100.0 * numUsedM / numSlotsM : 0)
                    << " (= 100*" << numUsedM << "/" << numSlotsM << ")" << std::endl;
                 os << "ATree: " << calcMemBytesATree() << " bytes, OccuRate = " << ((numSlotsA) ? 100.0 * numUsedA / numSlotsA : 0)
@@ -3723,6 +5284,23 @@ namespace itmmti
                 os << "Over reserved: " << bytesOverReserved << " bytes = "
                    << bytesOverReserved / 1024.0 << " KiB = "
                    << bytesOverReserved / 1024.0 / 1024.0 << " MiB" << std::endl;
+                if (NodeArena::getInstance().isEnabled())
+                { // Blocks of bottom nodes are in arena shared in the process.
+                    NodeArena::getInstance().printStatistics(os);
+                }
+                if (HotCountersT::kIsEnabled)
+                {
+                    os << "---------------- hot-path counters ----------------" << std::endl;
+                    for (uint8_t i = 0; i < static_cast<uint8_t>(HotCounter::kNum); ++i)
+                    {
+                        os << getHotCounterName(static_cast<HotCounter>(i)) << " = " << counters_.get(static_cast<HotCounter>(i)) << std::endl;
+                    }
+                    if (counters_.get(HotCounter::kSearchPosM))
+                    {
+                        os << "Average descent depth of MTree = "
+                           << static_cast<double>(counters_.get(HotCounter::kDescentDepthM)) / counters_.get(HotCounter::kSearchPosM) << std::endl;
+                    }
+                }
                 os << "DynRleForRlbwt object (" << this << ") " << __func__ << "(" << verbose << ") END" << std::endl;
             }
         }
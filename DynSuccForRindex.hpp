@@ -29,6 +29,7 @@
 //
 
 #include "PSumWithValue.hpp"
+#include "SerialUtil.hpp"
 
 
 namespace itmmti
@@ -52,6 +53,23 @@ namespace itmmti
     // using KeyVal = std::pair<uint64_t, uint64_t>;
 
 
+    /*!
+     * @brief Cursor to reuse the bottom node (and element) found by previous successor search.
+     * @note
+     *   Text-positions in [btmBeg..knownEnd] are known to be in "btm", and those in [elemBeg..elemKey] to be in the element
+     *   having key "elemKey" and value "elemVal". The cursor is invalidated by updates (setKeyVal, removeKey).
+     */
+    struct Cursor
+    {
+      const BtmNodeT * btm{nullptr};
+      uint64_t btmBeg{0};
+      uint64_t knownEnd{0};
+      uint64_t elemBeg{1};
+      uint64_t elemKey{0};
+      uint64_t elemVal{0};
+    };
+
+
   private:
     //// Private member variables.
     PSumT psum_; //!< Dynamic PSum data structure.
@@ -158,6 +176,48 @@ namespace itmmti
     }
 
 
+    /*!
+     * @brief Variant of "calcNextPos" that reuses "cursor" when "txtPos" falls in the bottom node searched previously,
+     *        which avoids descending from the root for consecutive queries (e.g., locating all occurrences).
+     */
+    uint64_t calcNextPos
+    (
+     const uint64_t txtPos, //!< Text-position for currently focused character.
+     const uint64_t txtLen, //!< Text length without end marker.
+     const uint64_t emPrev, //!< Text-position for previous character of implicit end marker.
+     const uint64_t emNext, //!< Text-position for next character of implicit end marker.
+     Cursor & cursor //!< [in,out] Cursor (default constructed for the first query).
+     ) const noexcept {
+      assert(txtPos <= txtLen);
+
+      if (!(cursor.elemBeg <= txtPos && txtPos <= cursor.elemKey)) {
+        uint64_t q = txtPos;
+        if (cursor.btm && cursor.btmBeg <= txtPos && txtPos <= cursor.knownEnd) {
+          q -= cursor.btmBeg;
+        } else {
+          BTreeNodeT * parent;
+          uint8_t idxInSib;
+          cursor.btm = psum_.searchBtm(q, parent, idxInSib); // q is modified.
+          cursor.btmBeg = txtPos - q;
+          cursor.knownEnd = txtPos;
+        }
+        uint64_t retWeight;
+        cursor.btm->searchPos(q, retWeight, cursor.elemVal); // q is modified.
+        cursor.elemBeg = txtPos - q;
+        cursor.elemKey = cursor.elemBeg + (retWeight - 1);
+        cursor.knownEnd = std::max(cursor.knownEnd, cursor.elemKey);
+      }
+      const uint64_t dist = cursor.elemKey - txtPos; // distance to sampled position
+      if (txtPos <= emPrev && emPrev - txtPos <= dist) {
+        return txtLen - (emPrev - txtPos);
+      } else if (txtLen - txtPos <= dist) {
+        return emNext - (txtLen - txtPos);
+      } else {
+        return cursor.elemVal - dist;
+      }
+    }
+
+
     /*!
      * @brief Register (key, val) in successor data structure.
      */
@@ -223,6 +283,82 @@ namespace itmmti
     }
 
 
+  public:
+    //// serialization
+    static constexpr uint64_t kSerialMagic{UINT64_C(0x636375536e7944)}; //!< "DynSucc"
+    static constexpr uint64_t kSerialVersion{1};
+
+
+    /*!
+     * @brief Call "func(key, val)" for each registered key in increasing order (the sentinel is excluded).
+     */
+    template<class Func>
+    void forEachKeyVal
+    (
+     Func && func
+     ) const {
+      uint64_t txtPos = 0;
+      while (true) {
+        uint64_t q = txtPos;
+        BTreeNodeT * parent;
+        uint8_t idxInSib;
+        auto btm = psum_.searchBtm(q, parent, idxInSib); // q is modified.
+
+        uint64_t retWeight, retVal;
+        btm->searchPos(q, retWeight, retVal); // q is modified.
+        const uint64_t key = txtPos + (retWeight - q - 1);
+        if (key == UINT64_MAX - 1) { // sentinel
+          return;
+        }
+        func(key, retVal);
+        txtPos = key + 1;
+      }
+    }
+
+
+    /*!
+     * @brief Write (key, val) pairs in binary.
+     */
+    void serialize
+    (
+     std::ostream & os
+     ) const {
+      uint64_t numKeys = 0;
+      forEachKeyVal([&numKeys](uint64_t, uint64_t) { ++numKeys; });
+      serialutil::writeHeader(os, kSerialMagic, kSerialVersion);
+      serialutil::writeVal(os, numKeys);
+      forEachKeyVal([&os](const uint64_t key, const uint64_t val) {
+          serialutil::writeVal(os, key);
+          serialutil::writeVal(os, val);
+        });
+    }
+
+
+    /*!
+     * @brief Load data written by serialize (previous data is cleared).
+     * @return false if the format does not match.
+     */
+    bool load
+    (
+     std::istream & is
+     ) {
+      uint64_t numKeys;
+      if (!serialutil::readHeader(is, kSerialMagic, kSerialVersion) || !serialutil::readVal(is, numKeys)) {
+        return false;
+      }
+      init();
+      for (uint64_t i = 0; i < numKeys; ++i) {
+        uint64_t key, val;
+        if (!serialutil::readVal(is, key) || !serialutil::readVal(is, val)) {
+          init();
+          return false;
+        }
+        setKeyVal(key, val);
+      }
+      return true;
+    }
+
+
   public:
     //// statistics
     size_t calcMemBytes
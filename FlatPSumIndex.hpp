@@ -0,0 +1,180 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file FlatPSumIndex.hpp
+ * @brief Static, pointer-free search tree over prefix sums of weights laid out level by level in contiguous cache-line-aligned arrays.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Each node has kW = 16 keys (two cache lines), where a key is the (absolute) end position of the subtree of a child,
+ *   and children of k-th node of a level are nodes [k * kW..(k + 1) * kW) of the next level.
+ *   So a descent reads one node per level with scankernels::searchPSum and no pointer chasing.
+ *   Before the leaf is scanned, "starts_" of its kW candidates (contiguous) are prefetched,
+ *   which overlaps the last two dependent misses of a search.
+ *   It is used as read-only snapshot of upper levels of M-tree of ::DynRleForRlbwt (see DynRleForRlbwt::buildFlatIndexM).
+ */
+#ifndef INCLUDE_GUARD_FlatPSumIndex
+#define INCLUDE_GUARD_FlatPSumIndex
+
+#include <stdint.h>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include "ScanKernels.hpp"
+
+namespace itmmti
+{
+    class FlatPSumIndex
+    {
+    public:
+        static constexpr uint64_t kW{16};                                  //!< Num of keys in a node.
+        static constexpr uint64_t kPad{UINT64_C(0x7fffffffffffffff)}; //!< Key of empty slots (larger than any position, also in signed comparison).
+
+    private:
+        std::vector<uint64_t> keys_;     //!< Keys of all levels from root to leaves (with margin to align them to cache lines when built).
+        std::vector<uint64_t> levelBeg_; //!< Offset (in keys) of each level.
+        std::vector<uint64_t> starts_;   //!< starts_[j] is the beginning position of j-th element, and starts_[num] is the total weight.
+        uint64_t keysOff_;               //!< Num of keys skipped at the beginning of "keys_" so that nodes start at cache-line boundaries when built.
+
+    public:
+        FlatPSumIndex() : keys_(),
+                          levelBeg_(),
+                          starts_(),
+                          keysOff_(0)
+        {
+        }
+
+        /*!
+         * @brief Build from weights of elements given by "weightOf(j)" for j in [0..num).
+         */
+        template <class Func>
+        void build(
+            const uint64_t num,
+            Func &&weightOf)
+        {
+            clear();
+            if (num == 0)
+            {
+                return;
+            }
+            starts_.resize(num + 1);
+            starts_[0] = 0;
+            for (uint64_t j = 0; j < num; ++j)
+            {
+                starts_[j + 1] = starts_[j] + weightOf(j);
+            }
+            assert(starts_[num] < kPad);
+
+            //// Num of nodes of each level from leaves.
+            std::vector<uint64_t> numNodes{(num + kW - 1) / kW};
+            while (numNodes.back() > 1)
+            {
+                numNodes.push_back((numNodes.back() + kW - 1) / kW);
+            }
+            const uint64_t numLevels = numNodes.size();
+            levelBeg_.resize(numLevels + 1);
+            levelBeg_[0] = 0;
+            for (uint64_t l = 0; l < numLevels; ++l)
+            {
+                levelBeg_[l + 1] = levelBeg_[l] + numNodes[numLevels - 1 - l] * kW;
+            }
+            keys_.assign(levelBeg_[numLevels] + 7, static_cast<uint64_t>(kPad));
+            keysOff_ = ((64 - reinterpret_cast<uintptr_t>(keys_.data()) % 64) % 64) / sizeof(uint64_t);
+            uint64_t *keys = keys_.data() + keysOff_;
+
+            //// Leaves have end positions of elements, and other keys are the last keys of children.
+            uint64_t *leaves = keys + levelBeg_[numLevels - 1];
+            for (uint64_t j = 0; j < num; ++j)
+            {
+                leaves[j] = starts_[j + 1];
+            }
+            for (uint64_t l = numLevels - 1; l > 0; --l)
+            {
+                const uint64_t *children = keys + levelBeg_[l];
+                uint64_t *parents = keys + levelBeg_[l - 1];
+                const uint64_t numChildren = numNodes[numLevels - 1 - l];
+                for (uint64_t k = 0; k < numChildren; ++k)
+                {
+                    const uint64_t *child = children + k * kW;
+                    uint64_t last = kW;
+                    while (child[last - 1] == kPad)
+                    {
+                        --last;
+                    }
+                    parents[k] = child[last - 1];
+                }
+            }
+        }
+
+        void clear()
+        {
+            std::vector<uint64_t>().swap(keys_);
+            std::vector<uint64_t>().swap(levelBeg_);
+            std::vector<uint64_t>().swap(starts_);
+        }
+
+        bool empty() const noexcept
+        {
+            return starts_.empty();
+        }
+
+        uint64_t getNum() const noexcept
+        {
+            return (starts_.empty()) ? 0 : starts_.size() - 1;
+        }
+
+        uint64_t getSumOfWeight() const noexcept
+        {
+            return (starts_.empty()) ? 0 : starts_.back();
+        }
+
+        /*!
+         * @brief Get beginning position of "j"-th element.
+         */
+        uint64_t getStart(
+            const uint64_t j) const noexcept
+        {
+            return starts_[j];
+        }
+
+        /*!
+         * @brief Return index of element containing "pos", modifying "pos" to relative position in the element.
+         */
+        uint64_t search(
+            uint64_t &pos //!< [in,out] Position (< getSumOfWeight()).
+        ) const noexcept
+        {
+            assert(pos < getSumOfWeight());
+
+            const uint64_t *keys = keys_.data() + keysOff_;
+            const uint64_t numLevels = levelBeg_.size() - 1;
+            uint64_t k = 0;
+            for (uint64_t l = 0; l + 1 < numLevels; ++l)
+            {
+                k = k * kW + scankernels::searchPSum(keys + levelBeg_[l] + k * kW, kW, pos);
+            }
+            // "starts_" of the kW candidates of the leaf are fetched while the leaf is scanned.
+            __builtin_prefetch(starts_.data() + k * kW);
+            __builtin_prefetch(starts_.data() + k * kW + kW);
+            const uint64_t j = k * kW + scankernels::searchPSum(keys + levelBeg_[numLevels - 1] + k * kW, kW, pos);
+            pos -= starts_[j];
+            return j;
+        }
+
+        size_t calcMemBytes(
+            const bool includeThis = true) const noexcept
+        {
+            size_t size = sizeof(*this) * includeThis;
+            size += (keys_.capacity() + levelBeg_.capacity() + starts_.capacity()) * sizeof(uint64_t);
+            return size;
+        }
+    };
+} // namespace itmmti
+
+#endif
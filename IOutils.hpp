@@ -1,64 +1,320 @@
+#ifndef INCLUDE_GUARD_IOutils
+#define INCLUDE_GUARD_IOutils
+
 #include <fstream>
 #include <cstring>
 #include <vector>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <string>
 
-void load_fasta(std::string filename, std::vector<char> &Text, uint64_t &sum, uint64_t &ns)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef OSPTBWT_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+/*!
+ * @brief Streaming reader of FASTA/FASTQ files, which may be gzip compressed.
+ * @note
+ *   Plain files are memory-mapped and scanned window by window (pages already scanned are released),
+ *   and gzip files are decompressed chunk by chunk.
+ *   Each record is passed to a callback as a reversed sequence followed by the terminator,
+ *   using a buffer reused over records, so the whole text is never held in memory.
+ */
+class SeqFileReader
 {
-    // open the input stream
-    std::ifstream input(filename);
-    if (!input.good())
+public:
+    static constexpr size_t kMapWindow = static_cast<size_t>(1) << 26; //!< Bytes of mmap window scanned at once.
+    static constexpr size_t kGzChunk = static_cast<size_t>(1) << 20;   //!< Bytes of chunk decompressed at once.
+
+private:
+    enum class LineType : uint8_t
     {
-        std::cerr << "Error opening " << filename << ". exiting..." << std::endl;
-        exit(-1);
+        kNone,   //!< Not decided (at the beginning or after quality of FASTQ).
+        kHeader, //!< '>' or '@' line.
+        kSeq,    //!< Sequence line.
+        kPlus,   //!< '+' line of FASTQ.
+        kQual    //!< Quality line of FASTQ.
+    };
+
+    std::string filename_;
+    int fd_;
+    size_t fileSize_;
+    const uint8_t *map_;
+    bool isGzip_;
+    uint8_t terminator_;
+    std::vector<uint8_t> seq_; //!< Buffer for the current record (reused).
+    uint64_t numSeqs_;
+    uint64_t sumLen_;
+    uint64_t numSkip_; //!< Num of records to be skipped before calling callback.
+    // parser state
+    LineType lineType_;
+    bool atLineStart_;
+    bool isFastq_;
+    uint64_t qualRemaining_;
+
+public:
+    SeqFileReader(
+        const std::string &filename, //!< Input file (FASTA or FASTQ, gzip supported).
+        const uint8_t terminator = 1 //!< Character appended to each reversed sequence.
+        ) : filename_(filename),
+            fd_(-1),
+            fileSize_(0),
+            map_(nullptr),
+            isGzip_(false),
+            terminator_(terminator),
+            seq_(),
+            numSeqs_(0),
+            sumLen_(0),
+            numSkip_(0),
+            lineType_(LineType::kNone),
+            atLineStart_(true),
+            isFastq_(false),
+            qualRemaining_(0)
+    {
+        fd_ = open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd_ < 0 || fstat(fd_, &st) != 0)
+        {
+            std::cerr << "Error opening " << filename << ". exiting..." << std::endl;
+            exit(-1);
+        }
+        fileSize_ = static_cast<size_t>(st.st_size);
+        if (fileSize_ > 0)
+        {
+            void *ptr = mmap(nullptr, fileSize_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (ptr == MAP_FAILED)
+            {
+                std::cerr << "Error mapping " << filename << ". exiting..." << std::endl;
+                exit(-1);
+            }
+            map_ = static_cast<const uint8_t *>(ptr);
+            madvise(ptr, fileSize_, MADV_SEQUENTIAL);
+            isGzip_ = (fileSize_ >= 2 && map_[0] == 0x1f && map_[1] == 0x8b);
+        }
     }
-    input.seekg(0, std::ios::end);
-    Text.resize(input.tellg());
-    input.seekg(0, std::ios::beg);
 
-    std::string line, DNA_sequence;
-    sum = 0, ns = 0;
-    while (std::getline(input, line))
+    ~SeqFileReader()
     {
-        // skip empty lines
-        if (line.empty())
+        if (map_ != nullptr)
         {
-            continue;
+            munmap(const_cast<uint8_t *>(map_), fileSize_);
         }
-        // header of a new sequence
-        if (line[0] == '>')
+        if (fd_ >= 0)
         {
-            ns++; // increase sequence count
-            size_t seqlen = DNA_sequence.size();
-            // insert previous DNA sequence
-            if (seqlen > 0)
+            close(fd_);
+        }
+    }
+
+    SeqFileReader(const SeqFileReader &) = delete;
+    SeqFileReader &operator=(const SeqFileReader &) = delete;
+
+    bool isGzip() const noexcept
+    {
+        return isGzip_;
+    }
+
+    /*!
+     * @brief Get size of input file in bytes (compressed size for gzip).
+     */
+    size_t getFileSize() const noexcept
+    {
+        return fileSize_;
+    }
+
+    /*!
+     * @brief Get num of records read so far (records with empty sequence are skipped).
+     */
+    uint64_t getNumSeqs() const noexcept
+    {
+        return numSeqs_;
+    }
+
+    /*!
+     * @brief Get total length (including terminators) of records read so far.
+     */
+    uint64_t getSumLen() const noexcept
+    {
+        return sumLen_;
+    }
+
+    /*!
+     * @brief Skip first "numSkip" records (with non-empty sequence) in forEachReversedSeq, e.g., to resume from checkpoint.
+     */
+    void setNumSkip(
+        const uint64_t numSkip) noexcept
+    {
+        numSkip_ = numSkip;
+    }
+
+    /*!
+     * @brief Read all records, calling "func(const uint8_t *seq, size_t len)" for each reversed sequence followed by the terminator.
+     * @return Num of records.
+     * @note "seq" is valid only during the call.
+     */
+    template <class Func>
+    uint64_t forEachReversedSeq(
+        Func &&func)
+    {
+        if (isGzip_)
+        {
+#ifdef OSPTBWT_HAS_ZLIB
+            munmap(const_cast<uint8_t *>(map_), fileSize_);
+            map_ = nullptr;
+            lseek(fd_, 0, SEEK_SET);
+            gzFile gz = gzdopen(dup(fd_), "rb");
+            if (gz == nullptr)
+            {
+                std::cerr << "Error opening " << filename_ << " as gzip. exiting..." << std::endl;
+                exit(-1);
+            }
+            gzbuffer(gz, kGzChunk);
+            std::vector<uint8_t> chunk(kGzChunk);
+            int len;
+            while ((len = gzread(gz, chunk.data(), static_cast<unsigned>(kGzChunk))) > 0)
             {
-                // 1. reverse DNA_sequence
-                std::reverse(DNA_sequence.begin(), DNA_sequence.end());
-
-                // 2. write Text
-                memcpy(&Text[sum], &DNA_sequence[0], seqlen);
-                // increase current text size
-                sum += seqlen;
-                // add separator
-                Text[sum++] = 1;
+                parse(chunk.data(), chunk.data() + len, func);
             }
-            // the current DNA sequence
-            DNA_sequence.clear();
+            if (len < 0)
+            {
+                std::cerr << "Error decompressing " << filename_ << ". exiting..." << std::endl;
+                exit(-1);
+            }
+            gzclose(gz);
+#else
+            std::cerr << "Error: gzip input (" << filename_ << ") is not supported in this build (zlib not found). exiting..." << std::endl;
+            exit(-1);
+#endif
         }
         else
         {
-            DNA_sequence += line;
+            for (size_t beg = 0; beg < fileSize_; beg += kMapWindow)
+            {
+                const size_t end = std::min(beg + kMapWindow, fileSize_);
+                parse(map_ + beg, map_ + end, func);
+                // kMapWindow is a multiple of page size, and so "map_ + beg" is page-aligned.
+                madvise(const_cast<uint8_t *>(map_ + beg), end - beg, MADV_DONTNEED);
+            }
         }
+        emit(func);
+        return numSeqs_;
     }
-    memcpy(&Text[sum], &DNA_sequence[0], DNA_sequence.size());
-    sum += DNA_sequence.size();
-    Text[sum++] = 1;
-    Text.resize(sum);
+
+private:
+    template <class Func>
+    void emit(
+        Func &func)
+    {
+        if (!seq_.empty() && numSkip_)
+        {
+            --numSkip_;
+            seq_.clear();
+        }
+        else if (!seq_.empty())
+        {
+            std::reverse(seq_.begin(), seq_.end());
+            seq_.push_back(terminator_);
+            func(static_cast<const uint8_t *>(seq_.data()), seq_.size());
+            ++numSeqs_;
+            sumLen_ += seq_.size();
+            seq_.clear();
+        }
+    }
+
+    /*!
+     * @brief Parse bytes in [beg..end), which may end in the middle of a line.
+     */
+    template <class Func>
+    void parse(
+        const uint8_t *p,
+        const uint8_t *const end,
+        Func &func)
+    {
+        while (p < end)
+        {
+            if (atLineStart_)
+            {
+                const uint8_t c = *p;
+                if (c == '\n' || c == '\r')
+                { // skip empty lines
+                    ++p;
+                    continue;
+                }
+                atLineStart_ = false;
+                if (lineType_ != LineType::kQual)
+                {
+                    if (c == '>' || (c == '@' && (isFastq_ || (numSeqs_ == 0 && seq_.empty()))))
+                    { // header of a new record
+                        isFastq_ = (c == '@');
+                        emit(func);
+                        lineType_ = LineType::kHeader;
+                    }
+                    else if (c == '+' && isFastq_)
+                    {
+                        lineType_ = LineType::kPlus;
+                    }
+                    else
+                    {
+                        lineType_ = LineType::kSeq;
+                    }
+                }
+            }
+
+            const auto *nl = static_cast<const uint8_t *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            const uint8_t *lineEnd = (nl != nullptr) ? nl : end;
+            if (lineType_ == LineType::kSeq)
+            {
+                seq_.insert(seq_.end(), p, lineEnd);
+                if (nl != nullptr && !seq_.empty() && seq_.back() == '\r')
+                {
+                    seq_.pop_back();
+                }
+            }
+            else if (lineType_ == LineType::kQual)
+            {
+                const uint64_t num = static_cast<uint64_t>(lineEnd - p) - std::count(p, lineEnd, '\r');
+                qualRemaining_ -= std::min(num, qualRemaining_);
+            }
+
+            if (nl == nullptr)
+            {
+                return;
+            }
+            p = nl + 1;
+            atLineStart_ = true;
+            if (lineType_ == LineType::kPlus)
+            {
+                qualRemaining_ = seq_.size();
+                lineType_ = (qualRemaining_ > 0) ? LineType::kQual : LineType::kNone;
+            }
+            else if (lineType_ == LineType::kQual && qualRemaining_ == 0)
+            {
+                lineType_ = LineType::kNone;
+            }
+        }
+    }
+};
+
+/*!
+ * @brief Load FASTA/FASTQ file into "Text" as concatenation of reversed sequences each followed by separator 1.
+ */
+void load_fasta(std::string filename, std::vector<char> &Text, uint64_t &sum, uint64_t &ns)
+{
+    SeqFileReader reader(filename, 1);
+    Text.clear();
+    if (!reader.isGzip())
+    {
+        Text.reserve(reader.getFileSize() + 1);
+    }
+    ns = reader.forEachReversedSeq([&Text](const uint8_t *seq, size_t len)
+                                   { Text.insert(Text.end(), seq, seq + len); });
+    sum = Text.size();
     Text.shrink_to_fit();
-    // close stream
-    input.close();
 }
 
 void writeTextToFile(const std::string &filename, const std::vector<char> &Text)
@@ -86,4 +342,6 @@ void writeTextToFile(const std::string &filename, const std::vector<char> &Text)
     }
 
     outfile.close();
-}
\ No newline at end of file
+}
+
+#endif
@@ -0,0 +1,425 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file Lz77FactorIO.hpp
+ * @brief Buffered writer/reader of LZ77 factors and (multi-threaded) decoder of them.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Factor (beg, len, ch) means that "len" characters are copied from text position "beg" (possibly overlapping),
+ *   followed by character "ch". Two formats are supported:
+ *   - Version 1 (legacy): sequence of (32-bit beg, 32-bit len, 1-byte ch) in native byte order without header.
+ *   - Version 2: header (kFactorMagic, kFactorVersion, 64-bit text length n and num of factors z)
+ *     followed by (LEB128 varint of len, LEB128 varint of distance 'pos - beg' if len > 0, 1-byte ch) per factor,
+ *     where "pos" is the text position of the factor. n and z in the header are filled by FactorWriter::finish,
+ *     so that decoders can preallocate the text.
+ *   Factors of relative LZ (see ::OnlineLzParser) are decoded after reference, i.e.,
+ *   text positions are offset by the length of reference, which is not counted in n.
+ */
+#ifndef INCLUDE_GUARD_Lz77FactorIO
+#define INCLUDE_GUARD_Lz77FactorIO
+
+#include <stdint.h>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "BwtWriter.hpp"
+#include "SerialUtil.hpp"
+
+namespace itmmti
+{
+    namespace lz77io
+    {
+        static constexpr uint64_t kFactorMagic{UINT64_C(0x7463614637375a4c)}; //!< "LZ77Fact"
+        static constexpr uint64_t kFactorVersion{2};
+        static constexpr uint64_t kLegacyVersion{1};
+        static constexpr uint64_t kHeaderBytes{4 * sizeof(uint64_t)};
+        static constexpr uint64_t kLegacyFactorBytes{2 * sizeof(uint32_t) + 1};
+
+        struct Factor
+        {
+            uint64_t beg; //!< Beginning position of source (meaningful only if len > 0).
+            uint64_t len; //!< Length of copy.
+            uint8_t ch;   //!< Character following copy.
+        };
+
+        /*!
+         * @brief Fixed-size buffer of factors handing them over to "func(const Factor *factors, size_t num)" in batches,
+         *        e.g., as a sink of ::OnlineLzParser without per-factor I/O or allocation.
+         */
+        template <class Func>
+        class FactorBuffer
+        {
+            std::vector<Factor> buf_;
+            size_t size_;
+            Func &func_;
+
+        public:
+            FactorBuffer(
+                Func &func,                              //!< Consumer of batches.
+                const size_t capacity = UINT64_C(1) << 16 //!< Num of factors per batch.
+                ) : buf_(capacity),
+                    size_(0),
+                    func_(func)
+            {
+                assert(capacity > 0);
+            }
+
+            ~FactorBuffer()
+            {
+                flush();
+            }
+
+            FactorBuffer(const FactorBuffer &) = delete;
+            FactorBuffer &operator=(const FactorBuffer &) = delete;
+
+            void operator()(
+                const uint64_t beg,
+                const uint64_t len,
+                const uint8_t ch)
+            {
+                buf_[size_++] = Factor{beg, len, ch};
+                if (size_ == buf_.size())
+                {
+                    flush();
+                }
+            }
+
+            void flush()
+            {
+                if (size_)
+                {
+                    func_(static_cast<const Factor *>(buf_.data()), size_);
+                    size_ = 0;
+                }
+            }
+        };
+
+        /*!
+         * @brief Buffered writer of LZ77 factors.
+         * @note
+         *   Factors should be given in text order. "os" should be seekable to fill header by "finish" in version 2.
+         *   In version 1, text positions and lengths should fit in 32 bits.
+         */
+        class FactorWriter
+        {
+            std::ostream &os_;
+            BlockWriter writer_;
+            std::streampos headerPos_;
+            const uint64_t offset_; //!< Length of text preceding factors (e.g., reference of relative LZ).
+            uint64_t n_; //!< Length of text covered by factors so far (including offset).
+            uint64_t z_; //!< Num of factors so far.
+            const uint64_t version_;
+            bool ok_;
+
+        public:
+            FactorWriter(
+                std::ostream &os,                      //!< Output stream.
+                const uint64_t version = kFactorVersion, //!< Format version (kFactorVersion or kLegacyVersion).
+                const uint64_t offset = 0               //!< Length of text preceding factors (e.g., reference of relative LZ).
+                ) : os_(os),
+                    writer_(os),
+                    headerPos_(os.tellp()),
+                    offset_(offset),
+                    n_(offset),
+                    z_(0),
+                    version_(version),
+                    ok_(true)
+            {
+                assert(version == kFactorVersion || version == kLegacyVersion);
+
+                if (version_ == kFactorVersion)
+                { // n and z are filled by finish.
+                    serialutil::writeHeader(os_, kFactorMagic, kFactorVersion);
+                    serialutil::writeVal(os_, getLen());
+                    serialutil::writeVal(os_, z_);
+                }
+            }
+
+            /*!
+             * @brief Put factor (beg, len, ch) as sink of ::OnlineLzParser.
+             */
+            void operator()(
+                const uint64_t beg,
+                const uint64_t len,
+                const uint8_t ch)
+            {
+                put(beg, len, ch);
+            }
+
+            FactorWriter(const FactorWriter &) = delete;
+            FactorWriter &operator=(const FactorWriter &) = delete;
+
+            /*!
+             * @brief Put factor (beg, len, ch).
+             */
+            void put(
+                const uint64_t beg,
+                const uint64_t len,
+                const uint8_t ch)
+            {
+                if (len && beg >= n_)
+                { // Source should begin before the factor.
+                    ok_ = false;
+                }
+                if (version_ == kFactorVersion)
+                {
+                    writer_.putVarint(len);
+                    if (len)
+                    {
+                        writer_.putVarint(n_ - beg);
+                    }
+                    writer_.putByte(ch);
+                }
+                else
+                {
+                    if (beg > UINT32_MAX || len > UINT32_MAX || n_ + len + 1 > UINT32_MAX)
+                    {
+                        ok_ = false;
+                    }
+                    writer_.putLittleEndian(beg, sizeof(uint32_t));
+                    writer_.putLittleEndian(len, sizeof(uint32_t));
+                    writer_.putByte(ch);
+                }
+                n_ += len + 1;
+                ++z_;
+            }
+
+            /*!
+             * @brief Flush factors and fill header.
+             * @return false if writing failed, some factor is invalid, or text is too long for version 1.
+             */
+            bool finish()
+            {
+                writer_.flush();
+                if (version_ == kFactorVersion && os_)
+                {
+                    const std::streampos endPos = os_.tellp();
+                    os_.seekp(headerPos_ + static_cast<std::streamoff>(2 * sizeof(uint64_t)));
+                    serialutil::writeVal(os_, getLen());
+                    serialutil::writeVal(os_, z_);
+                    os_.seekp(endPos);
+                }
+                os_.flush();
+                return ok_ && static_cast<bool>(os_);
+            }
+
+            /*!
+             * @brief Length of text covered by factors so far (not including offset).
+             */
+            uint64_t getLen() const noexcept
+            {
+                return n_ - offset_;
+            }
+
+            uint64_t getNumFactors() const noexcept
+            {
+                return z_;
+            }
+        };
+
+        /*!
+         * @brief Read factors of version 1 or 2 (detected by header) from "data[0..size)" (e.g., serialutil::MappedFile).
+         * @return false if input is malformed (e.g., a source beginning at or after its factor).
+         */
+        inline bool readFactors(
+            const char *data,
+            const size_t size,
+            std::vector<Factor> &factors, //!< [out]
+            uint64_t &n,                  //!< [out] Text length (not including offset).
+            const uint64_t offset = 0     //!< Length of text preceding factors (e.g., reference of relative LZ).
+        )
+        {
+            factors.clear();
+            n = offset;
+            const auto *p = reinterpret_cast<const uint8_t *>(data);
+            const auto *const end = p + size;
+            uint64_t magic = 0, version = 0;
+            if (size >= kHeaderBytes)
+            {
+                memcpy(&magic, p, sizeof(uint64_t));
+                memcpy(&version, p + sizeof(uint64_t), sizeof(uint64_t));
+            }
+            if (magic != kFactorMagic)
+            { // version 1
+                if (size % kLegacyFactorBytes)
+                {
+                    return false;
+                }
+                factors.reserve(size / kLegacyFactorBytes);
+                for (; p < end; p += kLegacyFactorBytes)
+                {
+                    uint32_t beg, len;
+                    memcpy(&beg, p, sizeof(uint32_t));
+                    memcpy(&len, p + sizeof(uint32_t), sizeof(uint32_t));
+                    if (len && beg >= n)
+                    {
+                        return false;
+                    }
+                    factors.push_back(Factor{beg, len, p[2 * sizeof(uint32_t)]});
+                    n += static_cast<uint64_t>(len) + 1;
+                }
+                n -= offset;
+                return true;
+            }
+            if (version != kFactorVersion)
+            {
+                return false;
+            }
+            uint64_t headerN, z;
+            memcpy(&headerN, p + 2 * sizeof(uint64_t), sizeof(uint64_t));
+            memcpy(&z, p + 3 * sizeof(uint64_t), sizeof(uint64_t));
+            if (z > size)
+            { // Each factor takes at least 2 bytes.
+                return false;
+            }
+            p += kHeaderBytes;
+            auto getVarint = [&p, end](uint64_t &val)
+            {
+                val = 0;
+                for (uint8_t shift = 0; p < end && shift < 64; shift += 7)
+                {
+                    const uint8_t byte = *p++;
+                    val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if (!(byte & 0x80))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            factors.reserve(z);
+            while (p < end)
+            {
+                uint64_t len, dist = 0;
+                if (!getVarint(len) || (len && (!getVarint(dist) || dist == 0 || dist > n)) || p == end)
+                {
+                    return false;
+                }
+                factors.push_back(Factor{n - dist, len, *p++});
+                n += len + 1;
+            }
+            n -= offset;
+            return n == headerN && factors.size() == z;
+        }
+
+        /*!
+         * @brief Copy "out[src..src + len)" to "out[dst..dst + len)" (src < dst), where they may overlap.
+         * @note Overlapping source is periodic with period 'dst - src', so that copied length doubles by each memcpy.
+         */
+        inline void copyFactor(
+            char *out,
+            const uint64_t src,
+            const uint64_t dst,
+            const uint64_t len)
+        {
+            assert(src < dst);
+
+            if (src + len <= dst)
+            {
+                memcpy(out + dst, out + src, len);
+                return;
+            }
+            for (uint64_t copied = 0; copied < len;)
+            {
+                const uint64_t m = std::min(len - copied, dst + copied - src);
+                memcpy(out + dst + copied, out + src, m);
+                copied += m;
+            }
+        }
+
+        /*!
+         * @brief Decode "factors" to "out[offset..offset + n)", where n is the text length.
+         * @note
+         *   "out[0..offset)" should be given in advance (e.g., reference of relative LZ).
+         *   Factors are split into chunks of about "chunkBytes" of output, which are dynamically assigned to "numThreads"
+         *   threads in increasing order. Each chunk publishes its decoded prefix, and a factor whose source extends to
+         *   preceding chunks waits until the source is decoded there. Since chunks are assigned in order and
+         *   sources always precede factors, every chunk waited for is already being decoded, that is, no deadlock.
+         *   Decoding is parallel as far as sources are local (or already decoded), and otherwise it degrades to a pipeline.
+         */
+        inline void decodeFactors(
+            const std::vector<Factor> &factors,
+            char *out,                                   //!< [out] Should have space for the text.
+            const unsigned numThreads,                   //!< Num of threads (0 for hardware concurrency).
+            const uint64_t chunkBytes = UINT64_C(1) << 22, //!< Num of output bytes per chunk.
+            const uint64_t offset = 0                     //!< Length of text preceding factors.
+        )
+        {
+            std::vector<uint64_t> chunkFac{0};      // Chunk k has factors[chunkFac[k]..chunkFac[k + 1]).
+            std::vector<uint64_t> chunkPos{offset}; // Chunk k decodes out[chunkPos[k]..chunkPos[k + 1]).
+            uint64_t n = offset;
+            for (uint64_t i = 0; i < factors.size(); ++i)
+            {
+                n += factors[i].len + 1;
+                if (n - chunkPos.back() >= chunkBytes || i + 1 == factors.size())
+                {
+                    chunkFac.push_back(i + 1);
+                    chunkPos.push_back(n);
+                }
+            }
+            const uint64_t numChunks = chunkFac.size() - 1;
+            const unsigned nt = static_cast<unsigned>(std::min<uint64_t>(
+                (numThreads) ? numThreads : std::max(1u, std::thread::hardware_concurrency()), std::max<uint64_t>(numChunks, 1)));
+            std::vector<std::atomic<uint64_t>> progress(numChunks); // out[chunkPos[k]..progress[k]) is decoded.
+            for (uint64_t k = 0; k < numChunks; ++k)
+            {
+                progress[k].store(chunkPos[k], std::memory_order_relaxed);
+            }
+            std::atomic<uint64_t> nextChunk(0);
+
+            auto worker = [&]()
+            {
+                for (uint64_t k = nextChunk++; k < numChunks; k = nextChunk++)
+                {
+                    uint64_t pos = chunkPos[k];
+                    for (uint64_t i = chunkFac[k]; i < chunkFac[k + 1]; ++i)
+                    {
+                        const auto &f = factors[i];
+                        if (f.len)
+                        {
+                            //// Wait for part of source in preceding chunks.
+                            const uint64_t srcEnd = std::min(f.beg + f.len, chunkPos[k]);
+                            const auto it = std::upper_bound(chunkPos.begin(), chunkPos.end(), f.beg);
+                            uint64_t j = (it == chunkPos.begin()) ? 0 : static_cast<uint64_t>(it - chunkPos.begin()) - 1;
+                            for (; j < k && chunkPos[j] < srcEnd; ++j)
+                            {
+                                const uint64_t target = std::min(chunkPos[j + 1], srcEnd);
+                                while (progress[j].load(std::memory_order_acquire) < target)
+                                {
+                                    std::this_thread::yield();
+                                }
+                            }
+                            copyFactor(out, f.beg, pos, f.len);
+                            pos += f.len;
+                        }
+                        out[pos++] = static_cast<char>(f.ch);
+                        progress[k].store(pos, std::memory_order_release);
+                    }
+                }
+            };
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < nt; ++t)
+            {
+                workers.emplace_back(worker);
+            }
+            worker();
+            for (auto &w : workers)
+            {
+                w.join();
+            }
+        }
+    } // namespace lz77io
+} // namespace itmmti
+
+#endif
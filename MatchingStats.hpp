@@ -0,0 +1,157 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file MatchingStats.hpp
+ * @brief Matching statistics and maximal exact matches (MEMs) of query against r-index (e.g., ::OnlineRlbwtIndex).
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Since "lfMap(PatTracker &, ch)" of online r-index appends "ch" to the pattern (the index is built on reversed text),
+ *   the query is streamed from left to right and, for each position i, the longest suffix of "query[0..i]"
+ *   occurring in the text is reported. The longest match ending at i can only be extended by "query[i + 1]",
+ *   and when it fails, the longest occurring suffix is found by galloping over its length
+ *   (testing lengths 1, 2, 4, ... and then binary search), which needs O(len log len) LF steps per mismatch
+ *   in contrast to O(len^2) of restarting from every next position.
+ */
+#ifndef INCLUDE_GUARD_MatchingStats
+#define INCLUDE_GUARD_MatchingStats
+
+#include <stdint.h>
+#include <cassert>
+#include <string>
+
+namespace itmmti
+{
+    namespace matchingstats
+    {
+        static constexpr uint64_t NOTFOUND{UINT64_MAX};
+
+        /*!
+         * @brief Search "query[beg..end)" from scratch, and set its tracker to "tracker" if it occurs.
+         */
+        template <class RindexT>
+        bool searchSubstr(
+            const RindexT &rindex,
+            const std::string &query,
+            const uint64_t beg,
+            const uint64_t end,
+            typename RindexT::PatTracker &tracker //!< [out]
+        )
+        {
+            auto t = rindex.getInitialPatTracker();
+            for (uint64_t j = beg; j < end; ++j)
+            {
+                if (!rindex.lfMap(t, static_cast<unsigned char>(query[j])))
+                {
+                    return false;
+                }
+            }
+            tracker = t;
+            return true;
+        }
+
+        /*!
+         * @brief Compute matching statistics of "query" against "rindex",
+         *        calling "func(i, len, occ)" for each position i of "query" in increasing order, where
+         *        "len" is the length of the longest suffix of "query[0..i]" occurring in the text and
+         *        "occ" is beginning position of one of its occurrences (NOTFOUND if len == 0).
+         * @note "rindex" should not be updated during the computation.
+         */
+        template <class RindexT, class Func>
+        void computeMatchingStats(
+            const RindexT &rindex,
+            const std::string &query,
+            Func &&func)
+        {
+            using PatTracker = typename RindexT::PatTracker;
+            const auto initTracker = rindex.getInitialPatTracker();
+            PatTracker tracker = initTracker; // Tracker for the current match "query[i - len..i)".
+            uint64_t len = 0;
+            for (uint64_t i = 0; i < query.size(); ++i)
+            {
+                PatTracker t = tracker;
+                if (rindex.lfMap(t, static_cast<unsigned char>(query[i])))
+                {
+                    tracker = t;
+                    ++len;
+                }
+                else
+                { // Find the longest occurring "query[i + 1 - l..i + 1)" with l <= len by galloping.
+                    uint64_t lo = 0;      // Known to occur.
+                    uint64_t hi = len + 1; // Known not to occur.
+                    PatTracker loTracker = initTracker;
+                    for (uint64_t l = 1; l < hi; l *= 2)
+                    {
+                        if (searchSubstr(rindex, query, i + 1 - l, i + 1, t))
+                        {
+                            lo = l;
+                            loTracker = t;
+                        }
+                        else
+                        {
+                            hi = l;
+                            break;
+                        }
+                    }
+                    while (lo + 1 < hi)
+                    {
+                        const uint64_t mid = lo + (hi - lo) / 2;
+                        if (searchSubstr(rindex, query, i + 1 - mid, i + 1, t))
+                        {
+                            lo = mid;
+                            loTracker = t;
+                        }
+                        else
+                        {
+                            hi = mid;
+                        }
+                    }
+                    len = lo;
+                    tracker = loTracker;
+                }
+                //// Note that occ computed from tracker is end position (exclusive) of pattern.
+                func(i, len, (len) ? rindex.calcFstOcc(tracker) - len : NOTFOUND);
+            }
+        }
+
+        /*!
+         * @brief Find MEMs of "query" of length at least "minLen" (> 0),
+         *        calling "func(qBeg, len, occ)" for each MEM "query[qBeg..qBeg + len)" in increasing order of qBeg,
+         *        where "occ" is beginning position of one of its occurrences in the text.
+         * @note MEM ends at i iff the longest match ending at i is not extended by "query[i + 1]".
+         */
+        template <class RindexT, class Func>
+        void findMems(
+            const RindexT &rindex,
+            const std::string &query,
+            const uint64_t minLen,
+            Func &&func)
+        {
+            assert(minLen > 0);
+
+            uint64_t prevLen = 0;
+            uint64_t prevOcc = NOTFOUND;
+            auto step = [&](const uint64_t i, const uint64_t len, const uint64_t occ)
+            {
+                if (i && len != prevLen + 1 && prevLen >= minLen)
+                {
+                    func(i - prevLen, prevLen, prevOcc);
+                }
+                prevLen = len;
+                prevOcc = occ;
+            };
+            computeMatchingStats(rindex, query, step);
+            if (prevLen >= minLen)
+            {
+                func(query.size() - prevLen, prevLen, prevOcc);
+            }
+        }
+    } // namespace matchingstats
+} // namespace itmmti
+
+#endif
@@ -0,0 +1,445 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file MoveTable.hpp
+ * @brief Move structure (table of runs with precomputed LF) for constant-time LF steps on finished RLBWT.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ */
+#ifndef INCLUDE_GUARD_MoveTable
+#define INCLUDE_GUARD_MoveTable
+
+#include <stdint.h>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+namespace itmmti
+{
+    /*!
+     * @brief Move structure of RLBWT with implicit end marker, built from finished RLE (e.g., by OnlineRlbwt::buildMoveTable).
+     * @note
+     *   Each row represents a (possibly split) run of BWT, storing its starting pos "p", LF of p ("q"),
+     *   and index "d" of the row containing q, so that LF of a pos in the row is computed
+     *   as "q + (pos - p)" followed by fast-forwarding rows from d.
+     *   Rows are split so that the LF image of each row intersects at most "maxFanout" rows,
+     *   which bounds the fast-forwarding.
+     */
+    template <typename CharT>
+    class MoveTable
+    {
+    public:
+        using bwtintvl = std::pair<uint64_t, uint64_t>;
+        static constexpr uint64_t NOTFOUND{UINTPTR_MAX};
+        static constexpr uint64_t kDefaultMaxFanout{4};
+
+        /*!
+         * @brief Non-empty bwt-interval [l..r] (both inclusive) with rows containing l and r.
+         */
+        struct MoveIntvl
+        {
+            uint64_t l;
+            uint64_t lRow;
+            uint64_t r;
+            uint64_t rRow;
+        };
+
+    private:
+        struct Row
+        {
+            uint64_t p; //!< Starting pos of the row.
+            uint64_t q; //!< LF(p).
+            uint64_t d; //!< Index of row containing q.
+            CharT ch;   //!< Character of the row.
+        };
+
+        std::vector<Row> rows_;                          //!< Rows sorted by p followed by sentinel row with p = len.
+        uint64_t emRow_;                                 //!< Index of row of end marker.
+        std::vector<CharT> alph_;                        //!< Sorted alphabet (end marker is excluded).
+        std::vector<std::vector<uint64_t>> rowsOfChar_; //!< rowsOfChar_[c] = sorted indexes of rows of "alph_[c]".
+
+    public:
+        MoveTable() : rows_(),
+                      emRow_(0)
+        {
+        }
+
+        /*!
+         * @brief Build from "drle", which has "forEachRun(func(ch, exponent))" (e.g., ::DynRleForRlbwt),
+         *        with end marker "em" at "emPos".
+         */
+        template <class DynRle>
+        MoveTable(
+            const DynRle &drle,                          //!< RLE of BWT without end marker.
+            const uint64_t emPos,                        //!< Pos of end marker in BWT.
+            const CharT em,                              //!< End marker.
+            const uint64_t maxFanout = kDefaultMaxFanout //!< Max fan-out of rows (0 for no splitting). It should be >= 4.
+        )
+        {
+            //// Rows of runs with end marker inserted (run containing emPos is split).
+            uint64_t pos = 0;
+            emRow_ = NOTFOUND;
+            auto pushRow = [this](const uint64_t p, const CharT ch)
+            {
+                rows_.push_back({p, 0, 0, ch});
+            };
+            drle.forEachRun([&](const CharT ch, const uint64_t exponent)
+                            {
+                                if (emRow_ == NOTFOUND && pos + exponent > emPos)
+                                {
+                                    if (emPos > pos)
+                                    {
+                                        pushRow(pos, ch);
+                                    }
+                                    emRow_ = rows_.size();
+                                    pushRow(emPos, em);
+                                    pushRow(emPos + 1, ch);
+                                    pos += exponent + 1;
+                                    return;
+                                }
+                                pushRow(pos, ch);
+                                pos += exponent; });
+            if (emRow_ == NOTFOUND)
+            {
+                emRow_ = rows_.size();
+                pushRow(pos++, em);
+            }
+            const uint64_t len = pos;
+
+            //// Alphabet, and LF of starting pos of rows (F[0] is end marker).
+            for (uint64_t i = 0; i < rows_.size(); ++i)
+            {
+                if (i != emRow_ && std::find(alph_.begin(), alph_.end(), rows_[i].ch) == alph_.end())
+                {
+                    alph_.push_back(rows_[i].ch);
+                }
+            }
+            std::sort(alph_.begin(), alph_.end());
+            std::vector<uint64_t> occ(alph_.size(), 0);
+            for (uint64_t i = 0; i < rows_.size(); ++i)
+            {
+                if (i != emRow_)
+                {
+                    occ[charToCode(rows_[i].ch)] += calcRowLen(i, len);
+                }
+            }
+            uint64_t sum = 1;
+            for (auto &num : occ)
+            {
+                const uint64_t tmp = num;
+                num = sum;
+                sum += tmp;
+            }
+            for (uint64_t i = 0; i < rows_.size(); ++i)
+            {
+                if (i == emRow_)
+                {
+                    rows_[i].q = 0;
+                }
+                else
+                {
+                    auto &num = occ[charToCode(rows_[i].ch)];
+                    rows_[i].q = num;
+                    num += calcRowLen(i, len);
+                }
+            }
+            rows_.push_back({len, len, 0, em}); // sentinel
+
+            if (maxFanout)
+            {
+                balance(std::max<uint64_t>(maxFanout, 4));
+            }
+            for (uint64_t i = 0; i + 1 < rows_.size(); ++i)
+            {
+                rows_[i].d = findRow(rows_[i].q);
+            }
+            rowsOfChar_.resize(alph_.size());
+            for (uint64_t i = 0; i + 1 < rows_.size(); ++i)
+            {
+                if (i != emRow_)
+                {
+                    rowsOfChar_[charToCode(rows_[i].ch)].push_back(i);
+                }
+            }
+        }
+
+        /*!
+         * @brief Return length of BWT including end marker.
+         */
+        uint64_t getLenWithEndmarker() const noexcept
+        {
+            return rows_.empty() ? 0 : rows_.back().p;
+        }
+
+        uint64_t getNumRows() const noexcept
+        {
+            return rows_.empty() ? 0 : rows_.size() - 1;
+        }
+
+        /*!
+         * @brief Return index of row containing "pos" by binary search.
+         */
+        uint64_t findRow(
+            const uint64_t pos //!< in [0..getLenWithEndmarker()).
+        ) const noexcept
+        {
+            assert(pos < getLenWithEndmarker());
+
+            const auto it = std::upper_bound(rows_.begin(), rows_.end(), pos, [](const uint64_t p, const Row &row)
+                                             { return p < row.p; });
+            return static_cast<uint64_t>(it - rows_.begin()) - 1;
+        }
+
+        /*!
+         * @brief Return BWT[pos] for "pos" in row "row".
+         */
+        CharT getChar(
+            const uint64_t row) const noexcept
+        {
+            return rows_[row].ch;
+        }
+
+        /*!
+         * @brief LF step: replace "pos" in row "row" with LF(pos) and its row.
+         */
+        void lfStep(
+            uint64_t &pos, //!< [in,out] Pos in BWT.
+            uint64_t &row  //!< [in,out] Row containing "pos".
+        ) const noexcept
+        {
+            assert(rows_[row].p <= pos && pos < rows_[row + 1].p);
+
+            const Row &cur = rows_[row];
+            pos = cur.q + (pos - cur.p);
+            row = cur.d;
+            while (rows_[row + 1].p <= pos)
+            {
+                ++row;
+            }
+        }
+
+        /*!
+         * @brief LF map.
+         */
+        uint64_t lfMap(
+            uint64_t i) const noexcept
+        {
+            uint64_t row = findRow(i);
+            lfStep(i, row);
+            return i;
+        }
+
+        /*!
+         * @brief Return interval of whole BWT for backward search.
+         */
+        MoveIntvl getFullIntvl() const noexcept
+        {
+            assert(getLenWithEndmarker() > 0);
+
+            return {0, 0, getLenWithEndmarker() - 1, getNumRows() - 1};
+        }
+
+        /*!
+         * @brief Compute interval for cW from interval for W (backward search step).
+         * @return false if the interval for cW is empty ("intvl" is then unspecified).
+         */
+        bool lfMap(
+            MoveIntvl &intvl, //!< [in,out] Non-empty interval.
+            const CharT ch) const noexcept
+        {
+            const uint64_t c = charToCode(ch);
+            if (c == NOTFOUND)
+            {
+                return false;
+            }
+            const auto &rows = rowsOfChar_[c];
+            if (intvl.lRow == emRow_ || rows_[intvl.lRow].ch != ch)
+            { // Move to the first row of ch after lRow.
+                const auto it = std::upper_bound(rows.begin(), rows.end(), intvl.lRow);
+                if (it == rows.end() || *it > intvl.rRow)
+                {
+                    return false;
+                }
+                intvl.lRow = *it;
+                intvl.l = rows_[intvl.lRow].p;
+            }
+            if (intvl.rRow == emRow_ || rows_[intvl.rRow].ch != ch)
+            { // Move to the last row of ch before rRow (it exists since lRow has ch).
+                const auto it = std::lower_bound(rows.begin(), rows.end(), intvl.rRow);
+                intvl.rRow = *(it - 1);
+                intvl.r = rows_[intvl.rRow + 1].p - 1;
+            }
+            lfStep(intvl.l, intvl.lRow);
+            lfStep(intvl.r, intvl.rRow);
+            return true;
+        }
+
+        /*!
+         * @brief Compute bwt-interval for cW from bwt-interval for W
+         * @note Intervals are [left, right) : right bound is excluded
+         */
+        bwtintvl lfMap(
+            const bwtintvl intvl,
+            const CharT ch) const noexcept
+        {
+            assert(intvl.first <= getLenWithEndmarker() && intvl.second <= getLenWithEndmarker());
+
+            if (intvl.first >= intvl.second)
+            {
+                return {0, 0};
+            }
+            MoveIntvl mi{intvl.first, findRow(intvl.first), intvl.second - 1, findRow(intvl.second - 1)};
+            if (!lfMap(mi, ch))
+            {
+                return {0, 0};
+            }
+            return {mi.l, mi.r + 1};
+        }
+
+        /*!
+         * @brief Output original text to std::ofstream (in the same order as OnlineRlbwt::invert).
+         */
+        void invert(
+            std::ofstream &ofs) const noexcept
+        {
+            uint64_t pos = 0, row = 0;
+            for (uint64_t i = 0; i + 1 < getLenWithEndmarker(); ++i)
+            {
+                ofs.put(static_cast<signed char>(static_cast<unsigned char>(rows_[row].ch)));
+                lfStep(pos, row);
+            }
+        }
+
+        /*!
+         * @brief Check if the text obtained by inversion equals the content of "ifs" (as OnlineRlbwt::checkDecompress).
+         */
+        bool checkDecompress(
+            std::ifstream &ifs) const noexcept
+        {
+            uint64_t pos = 0, row = 0;
+            for (uint64_t i = 0; i + 1 < getLenWithEndmarker(); ++i)
+            {
+                const auto ch = static_cast<unsigned char>(rows_[row].ch);
+                char c; // Assume that the input character fits in char.
+                ifs.get(c);
+                if (static_cast<unsigned char>(c) != ch)
+                {
+                    std::cerr << "error: bad expansion at i = " << i << ", (" << ch << ") should be (" << c << ")"
+                              << ", row = " << row << ", pos = " << pos << std::endl;
+                    return false;
+                }
+                lfStep(pos, row);
+            }
+            return true;
+        }
+
+        //////////////////////////////// statistics
+        size_t calcMemBytes(
+            bool includeThis = true) const noexcept
+        {
+            size_t size = sizeof(*this) * includeThis;
+            size += sizeof(Row) * rows_.capacity() + sizeof(CharT) * alph_.capacity();
+            for (const auto &rows : rowsOfChar_)
+            {
+                size += sizeof(rows) + sizeof(uint64_t) * rows.capacity();
+            }
+            return size;
+        }
+
+        void printStatistics(
+            std::ostream &os,
+            const bool verbose) const noexcept
+        {
+            os << "MoveTable object (" << this << ") " << __func__ << "(" << verbose << ") BEGIN" << std::endl;
+            os << "Len with endmarker = " << getLenWithEndmarker() << ", num of rows = " << getNumRows() << std::endl;
+            os << "Total: " << calcMemBytes() << " bytes" << std::endl;
+            os << "MoveTable object (" << this << ") " << __func__ << "(" << verbose << ") END" << std::endl;
+        }
+
+    private:
+        uint64_t charToCode(
+            const CharT ch) const noexcept
+        {
+            const auto it = std::lower_bound(alph_.begin(), alph_.end(), ch);
+            return (it == alph_.end() || *it != ch) ? NOTFOUND : static_cast<uint64_t>(it - alph_.begin());
+        }
+
+        uint64_t calcRowLen(
+            const uint64_t i,
+            const uint64_t len) const noexcept
+        {
+            return ((i + 1 < rows_.size()) ? rows_[i + 1].p : len) - rows_[i].p;
+        }
+
+        /*!
+         * @brief Split rows until LF image of every row intersects at most "maxFanout" rows.
+         * @note
+         *   In each pass, LF image [q..q+len) of each row is checked against starting positions of the previous pass,
+         *   and if it contains more than "maxFanout - 1" of them, the row is split at the "(maxFanout / 2)"-th one.
+         *   Passes are repeated until no row is split.
+         */
+        void balance(
+            const uint64_t maxFanout)
+        {
+            bool split = true;
+            while (split)
+            {
+                split = false;
+                std::vector<Row> newRows;
+                newRows.reserve(rows_.size());
+                auto startOf = [this](const uint64_t j)
+                {
+                    return rows_[j].p;
+                };
+                for (uint64_t i = 0; i + 1 < rows_.size(); ++i)
+                {
+                    Row row = rows_[i];
+                    const uint64_t end = rows_[i + 1].p;
+                    while (true)
+                    {
+                        const uint64_t qEnd = row.q + (end - row.p);
+                        // Rows starting in (q..qEnd).
+                        const uint64_t beg = findRow(row.q) + 1;
+                        uint64_t last = beg;
+                        while (last < rows_.size() && startOf(last) < qEnd && last - beg < maxFanout)
+                        {
+                            ++last;
+                        }
+                        if (last - beg < maxFanout)
+                        {
+                            break;
+                        }
+                        const uint64_t offset = startOf(beg + maxFanout / 2 - 1) - row.q;
+                        newRows.push_back(row);
+                        row.p += offset;
+                        row.q += offset;
+                        split = true;
+                    }
+                    newRows.push_back(row);
+                }
+                newRows.push_back(rows_.back());
+                if (split)
+                {
+                    for (uint64_t i = 0; i < newRows.size(); ++i)
+                    {
+                        if (newRows[i].p == rows_[emRow_].p)
+                        {
+                            emRow_ = i;
+                            break;
+                        }
+                    }
+                }
+                rows_.swap(newRows);
+            }
+        }
+    };
+} // namespace itmmti
+
+#endif
@@ -0,0 +1,243 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file NodeArena.hpp
+ * @brief Size-class pool carving allocations of node blocks from large (optionally huge-page backed) regions.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Bottom node types in DynRleForRlbwt.hpp route "new[]"/"delete[]" of their blocks (made by BtmMInfo_BlockVec and
+ *   BtmSInfo_BlockVec) to NodeArena::getInstance(), which uses the general-purpose allocator until enabled by NodeArena::enable.
+ *   Freed blocks are kept in free lists of their size classes for reuse and regions are never returned to OS,
+ *   so that repeated growth does not fragment the heap and reserved bytes are exactly what the process maps for nodes.
+ */
+#ifndef INCLUDE_GUARD_NodeArena
+#define INCLUDE_GUARD_NodeArena
+
+#include <stdint.h>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace itmmti
+{
+    class NodeArena
+    {
+    public:
+        static constexpr size_t kRegionBytes{UINT64_C(32) << 20};   //!< Size of regions (multiple of huge page size).
+        static constexpr size_t kHugePageBytes{UINT64_C(2) << 20};  //!< Huge page size assumed for alignment.
+        static constexpr size_t kSmallClassBytes{64};                //!< Granularity of size classes up to kPageBytes.
+        static constexpr size_t kPageBytes{4096};                    //!< Granularity of size classes beyond kPageBytes.
+
+    private:
+        //// Private member variables.
+        std::mutex mutex_;
+        std::map<uintptr_t, size_t> regions_;             //!< Mapped regions (beginning address -> bytes).
+        std::map<size_t, std::vector<void *>> freeLists_; //!< Free blocks of each size class.
+        char *cur_;          //!< Beginning of unused part of the current region.
+        size_t curRemain_;   //!< Bytes of unused part of the current region.
+        size_t reserved_;    //!< Bytes mapped for regions.
+        size_t inUse_;       //!< Bytes of size classes allocated and not freed.
+        bool enabled_;
+        bool hugePages_;
+
+        NodeArena() : cur_(nullptr),
+                      curRemain_(0),
+                      reserved_(0),
+                      inUse_(0),
+                      enabled_(false),
+                      hugePages_(false)
+        {
+        }
+
+    public:
+        NodeArena(const NodeArena &) = delete;
+        NodeArena &operator=(const NodeArena &) = delete;
+
+        /*!
+         * @brief Get process-wide arena.
+         * @note It is never destructed so that blocks can be freed at any time of termination.
+         */
+        static NodeArena &getInstance()
+        {
+            static NodeArena *arena = new NodeArena();
+            return *arena;
+        }
+
+        /*!
+         * @brief Serve subsequent allocations from arena.
+         * @note Blocks allocated before are still freed correctly.
+         */
+        void enable(
+            const bool hugePages //!< Back regions by huge pages (MAP_HUGETLB if available, transparent huge pages otherwise).
+        )
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            enabled_ = true;
+            hugePages_ = hugePages;
+        }
+
+        bool isEnabled() const noexcept
+        {
+            return enabled_;
+        }
+
+        bool usesHugePages() const noexcept
+        {
+            return hugePages_;
+        }
+
+        static size_t calcClassBytes(
+            const size_t bytes) noexcept
+        {
+            if (bytes <= kPageBytes)
+            {
+                return (bytes + kSmallClassBytes - 1) / kSmallClassBytes * kSmallClassBytes;
+            }
+            return (bytes + kPageBytes - 1) / kPageBytes * kPageBytes;
+        }
+
+        void *allocate(
+            const size_t bytes)
+        {
+            if (!enabled_)
+            {
+                return ::operator new[](bytes);
+            }
+            const size_t classBytes = calcClassBytes(bytes);
+            std::lock_guard<std::mutex> lock(mutex_);
+            inUse_ += classBytes;
+            auto &freeList = freeLists_[classBytes];
+            if (!freeList.empty())
+            {
+                void *ptr = freeList.back();
+                freeList.pop_back();
+                return ptr;
+            }
+            if (classBytes > kRegionBytes / 4)
+            { // dedicated region
+                return mapRegion(classBytes);
+            }
+            if (classBytes > curRemain_)
+            {
+                cur_ = static_cast<char *>(mapRegion(kRegionBytes));
+                curRemain_ = kRegionBytes;
+            }
+            void *ptr = cur_;
+            cur_ += classBytes;
+            curRemain_ -= classBytes;
+            return ptr;
+        }
+
+        void deallocate(
+            void *ptr,
+            const size_t bytes //!< Bytes given to allocate.
+            ) noexcept
+        {
+            if (ptr == nullptr)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!isInRegion(ptr))
+            { // allocated by general-purpose allocator
+                ::operator delete[](ptr);
+                return;
+            }
+            const size_t classBytes = calcClassBytes(bytes);
+            inUse_ -= classBytes;
+            freeLists_[classBytes].push_back(ptr);
+        }
+
+        //////////////////////////////// statistics
+        /*!
+         * @brief Bytes mapped from OS (i.e., actually reserved for nodes) including unused parts of regions and free blocks.
+         */
+        size_t calcMemBytesReserved() const noexcept
+        {
+            return reserved_;
+        }
+
+        /*!
+         * @brief Bytes of blocks in use (rounded up to size classes).
+         */
+        size_t calcMemBytesInUse() const noexcept
+        {
+            return inUse_;
+        }
+
+        /*!
+         * @brief Bytes reserved but not in use (unused parts of regions and free blocks), which add to RSS but not to calcMemBytes of indexes.
+         */
+        size_t calcMemBytesOverhead() const noexcept
+        {
+            return reserved_ - inUse_;
+        }
+
+        void printStatistics(
+            std::ostream &os) const noexcept
+        {
+            os << "NodeArena: enabled = " << enabled_ << ", huge pages = " << hugePages_
+               << ", #regions = " << regions_.size()
+               << ", reserved = " << reserved_ << " bytes = " << reserved_ / 1024.0 / 1024.0 << " MiB"
+               << ", in use = " << inUse_ << " bytes = " << inUse_ / 1024.0 / 1024.0 << " MiB" << std::endl;
+        }
+
+    private:
+        bool isInRegion(
+            const void *ptr) const noexcept
+        {
+            const auto addr = reinterpret_cast<uintptr_t>(ptr);
+            auto it = regions_.upper_bound(addr);
+            if (it == regions_.begin())
+            {
+                return false;
+            }
+            --it;
+            return addr < it->first + it->second;
+        }
+
+        void *mapRegion(
+            size_t bytes)
+        {
+            void *ptr = MAP_FAILED;
+            if (hugePages_)
+            {
+                bytes = (bytes + kHugePageBytes - 1) / kHugePageBytes * kHugePageBytes;
+#ifdef MAP_HUGETLB
+                ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+            }
+            if (ptr == MAP_FAILED)
+            {
+                ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (ptr == MAP_FAILED)
+                {
+                    throw std::bad_alloc();
+                }
+#ifdef MADV_HUGEPAGE
+                if (hugePages_)
+                { // fall back to transparent huge pages
+                    madvise(ptr, bytes, MADV_HUGEPAGE);
+                }
+#endif
+            }
+            regions_[reinterpret_cast<uintptr_t>(ptr)] = bytes;
+            reserved_ += bytes;
+            return ptr;
+        }
+    };
+} // namespace itmmti
+
+#endif
@@ -0,0 +1,163 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file NumaUtil.hpp
+ * @brief Minimal NUMA memory placement utilities (Linux, without libnuma).
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Linux places a page on the node of the thread touching it first, so that an index built (or loaded) by one thread
+ *   lives on one node, and query threads on the other nodes pay remote accesses and share the bandwidth of that node.
+ *   numautil::ScopedInterleave makes pages first touched in its scope interleaved over all online nodes instead.
+ *   It covers every allocation of the calling thread (including B-tree nodes of external modules and ::NodeArena regions),
+ *   and does nothing on single-node machines or where set_mempolicy is unavailable.
+ */
+#ifndef INCLUDE_GUARD_NumaUtil
+#define INCLUDE_GUARD_NumaUtil
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace itmmti
+{
+    namespace numautil
+    {
+        /*!
+         * @brief Get bit mask of online NUMA nodes (empty if unknown).
+         * @note Parsed from /sys/devices/system/node/online, which is a list of ranges like "0-3,8".
+         */
+        inline std::vector<uint64_t> getOnlineNodeMask()
+        {
+            std::vector<uint64_t> mask;
+            std::ifstream ifs("/sys/devices/system/node/online");
+            std::string list;
+            if (!ifs || !std::getline(ifs, list))
+            {
+                return mask;
+            }
+            size_t i = 0;
+            while (i < list.size())
+            {
+                size_t end = 0;
+                const uint64_t beg = std::stoull(list.substr(i), &end);
+                i += end;
+                uint64_t last = beg;
+                if (i < list.size() && list[i] == '-')
+                {
+                    ++i;
+                    last = std::stoull(list.substr(i), &end);
+                    i += end;
+                }
+                for (uint64_t node = beg; node <= last; ++node)
+                {
+                    if (node / 64 >= mask.size())
+                    {
+                        mask.resize(node / 64 + 1, 0);
+                    }
+                    mask[node / 64] |= UINT64_C(1) << (node % 64);
+                }
+                while (i < list.size() && (list[i] == ',' || list[i] == '\n' || list[i] == ' '))
+                {
+                    ++i;
+                }
+            }
+            return mask;
+        }
+
+        /*!
+         * @brief Get num of online NUMA nodes (1 if unknown).
+         */
+        inline uint64_t getNumNodes()
+        {
+            uint64_t num = 0;
+            for (const auto word : getOnlineNodeMask())
+            {
+                num += __builtin_popcountll(word);
+            }
+            return (num) ? num : 1;
+        }
+
+        /*!
+         * @brief Make pages first touched by the calling thread interleaved over online nodes during its lifetime.
+         * @note The previous memory policy of the thread is restored on destruction.
+         */
+        class ScopedInterleave
+        {
+            static constexpr int kMpolInterleave{3}; //!< MPOL_INTERLEAVE of <linux/mempolicy.h>.
+
+            std::vector<uint64_t> oldMask_; //!< Node mask of previous policy.
+            int oldMode_;                   //!< Mode of previous policy.
+            bool active_;                   //!< True if policy was changed.
+
+        public:
+            explicit ScopedInterleave(
+                const bool enable = true) : oldMask_(),
+                                            oldMode_(0),
+                                            active_(false)
+            {
+#if defined(SYS_set_mempolicy) && defined(SYS_get_mempolicy)
+                if (!enable)
+                {
+                    return;
+                }
+                const std::vector<uint64_t> mask = getOnlineNodeMask();
+                if (getNumNodes() <= 1)
+                {
+                    return;
+                }
+                const unsigned long maxNode = mask.size() * 64 + 1; // Kernel reads "maxNode - 1" bits.
+                oldMask_.assign(mask.size(), 0);
+                if (syscall(SYS_get_mempolicy, &oldMode_, oldMask_.data(), maxNode, nullptr, 0) != 0)
+                {
+                    return;
+                }
+                active_ = (syscall(SYS_set_mempolicy, kMpolInterleave, mask.data(), maxNode) == 0);
+#else
+                (void)enable;
+#endif
+            }
+
+            ~ScopedInterleave()
+            {
+#if defined(SYS_set_mempolicy) && defined(SYS_get_mempolicy)
+                if (active_)
+                {
+                    if (oldMode_ == 0) // MPOL_DEFAULT takes no nodes.
+                    {
+                        syscall(SYS_set_mempolicy, 0, nullptr, 0);
+                    }
+                    else
+                    {
+                        syscall(SYS_set_mempolicy, oldMode_, oldMask_.data(), oldMask_.size() * 64 + 1);
+                    }
+                }
+#endif
+            }
+
+            ScopedInterleave(const ScopedInterleave &) = delete;
+            ScopedInterleave &operator=(const ScopedInterleave &) = delete;
+
+            /*!
+             * @brief True if interleaving is in effect.
+             */
+            bool isActive() const noexcept
+            {
+                return active_;
+            }
+        };
+    } // namespace numautil
+} // namespace itmmti
+
+#endif
@@ -17,130 +17,140 @@
 #include <fstream>
 #include <iomanip>
 #include <chrono>
+#include <cstring>
+#include <iterator>
+#include <vector>
 
 #include "cmdline.h"
 #include "OnlineLz77ViaRlbwt.hpp"
 #include "DynRleForRlbwt.hpp"
+#include "RlbwtConfigs.hpp"
+#include "Lz77FactorIO.hpp"
 
 
 using namespace itmmti;
-using SizeT = uint32_t; // Text length should fit in SizeT.
+using SizeT = uint64_t;
 
 int main(int argc, char *argv[])
 {
   cmdline::parser parser;
   parser.add<std::string>("input", 'i', "input file name", true);
   parser.add<std::string>("output", 'o', "output file name", true);
+  parser.add<std::string>("config", 0, "template configuration (e.g., b32m32s8) or auto (chosen by profiling input)", false, "b32m32s8");
   parser.add<bool>("verbose", 'v', "verbose", false, 0);
+  parser.add<bool>("legacy", 0, "write factors in legacy format (version 1: 32-bit fields without header)", false, 0);
+  parser.add<std::string>("mode", 'm', "parsing: lz77, lzend (restricted online LZ-End) or rlz (relative LZ against --reference)", false, "lz77");
+  parser.add<std::string>("reference", 'r', "reference file name for rlz", false, "");
+  parser.add<bool>("check", 0, "check correctness by decoding written factors", false, 0);
   parser.add("help", 0, "print help");
 
   parser.parse_check(argc, argv);
   const std::string in = parser.get<std::string>("input");
   const std::string out = parser.get<std::string>("output");
   const bool verbose = parser.get<bool>("verbose");
+  const std::string config = parser.get<std::string>("config");
+  const bool legacy = parser.get<bool>("legacy");
+  const std::string modeName = parser.get<std::string>("mode");
+  const std::string ref = parser.get<std::string>("reference");
+  const bool check = parser.get<bool>("check");
+  LzParseMode mode;
+  if (modeName == "lz77") {
+    mode = LzParseMode::kLz77;
+  } else if (modeName == "lzend") {
+    mode = LzParseMode::kLzEnd;
+  } else if (modeName == "rlz") {
+    mode = LzParseMode::kRlz;
+  } else {
+    std::cerr << "error: unknown mode " << modeName << std::endl;
+    exit(1);
+  }
+  if ((mode == LzParseMode::kRlz) == ref.empty()) {
+    std::cerr << "error: --reference should be given iff mode is rlz" << std::endl;
+    exit(1);
+  }
 
-  auto t1 = std::chrono::high_resolution_clock::now();
-  std::cout << "LZ77 Parsing ..." << std::endl;
+  return runWithRlbwtConfig(config, in, [&](auto cfg) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::cout << "LZ Parsing (" << modeName << ") ..." << std::endl;
 
-  std::ifstream ifs(in);
-  std::ofstream ofs(out);
+    using DynRleT = typename decltype(cfg)::DynRleWithSamplesT; // See RlbwtConfigs.hpp for configurations.
 
-  const size_t step = 1000000; // Print status every step characters.
-  size_t last_step = 0;
+    std::vector<char> buf(1 << 20);
+    std::vector<char> refText;
+    if (mode == LzParseMode::kRlz) {
+      std::ifstream ifsRef(ref, std::ios::in | std::ios::binary);
+      if (!ifsRef) {
+        std::cerr << "error: failed to open " << ref << std::endl;
+        exit(1);
+      }
+      refText.assign(std::istreambuf_iterator<char>(ifsRef), std::istreambuf_iterator<char>());
+    }
 
-  using BTreeNodeT = BTreeNode<32>;
-  using BtmNodeMT = BtmNodeM_StepCode<BTreeNodeT, 32>;
-  using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>;
-  using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, 8>;
-  using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>;
-  using DynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_WBitsBlockVec<1024>, BtmMInfoT, BtmSInfoT>;
-  using Lz77ParserT = OnlineLz77ViaRlbwt<DynRleT>;
-  Lz77ParserT rlbwt(1);
-  SizeT pos = 0; // Current txt-pos (0base)
-  SizeT l = 0; // Length of current LZ phrase prefix
-  SizeT z = 0; // LZ phrase counter
-  Lz77ParserT::bwttracker tracker = {0, 1, 0}; // BWT tracker for current LZ phrase prefix.
-  char c; // Assume that the input character fits in char.
-  unsigned char uc;
+    std::ifstream ifs(in, std::ios::in | std::ios::binary);
+    std::ofstream ofs(out, std::ios::out | std::ios::binary);
+    //// Sources of rlz are in reference, which is regarded as text preceding factors.
+    lz77io::FactorWriter writer(ofs, (legacy) ? lz77io::kLegacyVersion : lz77io::kFactorVersion, refText.size());
+    using ParserT = OnlineLzParser<DynRleT, lz77io::FactorWriter>;
+    ParserT lzParser(writer, mode);
+    if (mode == LzParseMode::kRlz) {
+      lzParser.setReference(reinterpret_cast<const uint8_t *>(refText.data()), refText.size());
+      std::vector<char>().swap(refText);
+    }
 
-  while (ifs.peek() != std::ios::traits_type::eof()) {
-    ifs.get(c);
-    uc = static_cast<unsigned char>(c);
-    if (verbose) {
-      // if (pos >= 0) {
-      //   std::cout << pos << ": z = " << z << ", l = " << l << ", ref = " << std::get<2>(tracker) - l << ", succ = " << rlbwt.getSuccSamplePos()
-      //             << ", tracker = (" << std::get<0>(tracker) << ", " << std::get<1>(tracker) << ", " << std::get<2>(tracker) << "), "
-      //             << "insert " << (int)c << "(" << c << ")" << " at " << rlbwt.getEndmarkerPos() << std::endl;
-      // }
-      if (pos > last_step + (step - 1)) {
+    const size_t step = 1000000; // Print status every step characters.
+    size_t last_step = 0;
+    while (ifs) {
+      ifs.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+      const auto num = static_cast<size_t>(ifs.gcount());
+      lzParser.feed(reinterpret_cast<const uint8_t *>(buf.data()), num);
+      const SizeT pos = lzParser.getNumParsed();
+      if (verbose && pos > last_step + (step - 1)) {
         last_step = pos;
         std::cout << " " << pos << " characters processed ..." << std::endl;
-        // {//debug
-        //   std::ifstream ifssss(in);
-        //   if (!(rlbwt.checkDecompress(ifssss))) {
-        //     exit(1);
-        //   }
-        // }
       }
     }
+    lzParser.finish();
 
-    if (rlbwt.lfMap(tracker, uc)) {
-      ++l;
-      ++(std::get<1>(tracker)); // New suffix falls inside range
-    } else { // Extension failed: End of an LZ factor.
-      //// Output an LZ factor.
-      ++z;
-      SizeT beg = static_cast<SizeT>(std::get<2>(tracker) - l);
-      ofs.write(reinterpret_cast<char *>(&beg), sizeof(SizeT));
-      ofs.write(reinterpret_cast<char *>(&l), sizeof(SizeT));
-      ofs.write(&c, 1);
-      // if (verbose) {
-      //   std::cout << "LZ[" << z << "] = (" << beg << ", " << l << ", " << c << ")" << std::endl;
-      // }
-      //// Reset variables.
-      l = 0;
-      tracker = {0, rlbwt.getLenWithEndmarker() + 1, 0}; // +1 because we have not inserted "ch".
+    ifs.close();
+    if (!writer.finish()) {
+      std::cerr << "error: failed to write factors to " << out
+                << ((legacy) ? " (text may be too long for legacy format)" : "") << std::endl;
+      exit(1);
     }
-
-    rlbwt.extend(uc);
-    ++pos;
-    if (std::get<0>(tracker) == rlbwt.getEndmarkerPos()) {
-      std::get<2>(tracker) = rlbwt.getSuccSamplePos();
+    ofs.close();
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
+    std::cout << "LZ compression done. " << sec << " sec" << std::endl;
+    std::cout << "Number of factors z = " << lzParser.getNumFactors() << std::endl;
+    lzParser.getRlbwt().printStatistics(std::cout, false);
+
+    if (check) { // Decoded factors (following reference for rlz) should be the input.
+      std::cout << "Checking LZ decompression ..." << std::endl;
+      serialutil::MappedFile refFile, outFile, inFile;
+      if ((!ref.empty() && !refFile.open(ref)) || !outFile.open(out) || !inFile.open(in)) {
+        std::cerr << "error: failed to open files to check" << std::endl;
+        exit(1);
+      }
+      const uint64_t refLen = refFile.size();
+      std::vector<lz77io::Factor> factors;
+      uint64_t n = 0;
+      if (!lz77io::readFactors(outFile.data(), outFile.size(), factors, n, refLen)) {
+        std::cout << "LZ decompression failed: malformed factors." << std::endl;
+        return 0;
+      }
+      std::vector<char> T(refLen + n + 1);
+      if (refLen) {
+        memcpy(T.data(), refFile.data(), refLen);
+      }
+      lz77io::decodeFactors(factors, T.data(), 1, UINT64_C(1) << 22, refLen);
+      if (n == inFile.size() && (n == 0 || memcmp(T.data() + refLen, inFile.data(), n) == 0)) {
+        std::cout << "LZ decompressed correctly." << std::endl;
+      } else {
+        std::cout << "LZ decompression failed." << std::endl;
+      }
     }
 
-    // if (verbose) {
-    //   if (pos >= 5544) {
-    //     std::cout << "Status after inserting pos = " << pos - 1 << std::endl;
-    //     rlbwt.printDebugInfo(std::cout);
-    //     {//debug check if text can be decompressed correctly from rlbwt
-    //       std::ifstream ifssss(in);
-    //       if (!(rlbwt.checkDecompress(ifssss))) {
-    //         exit(1);
-    //       }
-    //     }
-    //   }
-    // }
-  }
-  if (l) {
-    ++z;
-    SizeT beg = static_cast<SizeT>(std::get<2>(tracker) - l);
-    SizeT len = l - 1;
-    ofs.write(reinterpret_cast<char *>(&beg), sizeof(SizeT));
-    ofs.write(reinterpret_cast<char *>(&len), sizeof(SizeT));
-    ofs.write(&c, 1);
-    // if (verbose) {
-    //   std::cout << "LZ[" << z << "] = (" << beg << ", " << l-1 << ", " << c << ")" << std::endl;
-    // }
-  }
-
-  ifs.close();
-  ofs.close();
-
-  auto t2 = std::chrono::high_resolution_clock::now();
-  double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
-  std::cout << "LZ compression done. " << sec << " sec" << std::endl;
-  std::cout << "Number of factors z = " << z << std::endl;
-  rlbwt.printStatistics(std::cout, false);
-
-  return 0;
+    return 0;
+  });
 }
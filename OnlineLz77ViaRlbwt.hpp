@@ -15,8 +15,10 @@
 
 #include <stdint.h>
 #include <cassert>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <tuple>
 
 namespace itmmti 
 {
@@ -402,6 +404,303 @@ namespace itmmti
       return true;
     }
   };
+
+
+  /*!
+   * @brief Parsing modes of ::OnlineLzParser.
+   */
+  enum class LzParseMode : uint8_t {
+    kLz77, //!< LZ77 (self-referencing), where each factor is the longest prefix occurring before plus a character.
+    kLzEnd, //!< Restricted LZ-End, where source of each factor ends at the end of a previous factor (see ::OnlineLzParser).
+    kRlz //!< Relative LZ, where sources are in reference given by OnlineLzParser::setReference (and text is not indexed).
+  };
+
+
+  /*!
+   * @brief Online LZ parser on ::OnlineLz77ViaRlbwt pushing factors to "sink".
+   * @tparam Sink Callable as "sink(beg, len, ch)" for each factor (beg, len, ch),
+   *   meaning that "len" characters are copied from "beg" (possibly overlapping) followed by "ch".
+   * @note
+   *   Factors are pushed as soon as they end, without allocation per factor.
+   *   Factor positions are in text positions, where for kRlz the text is the reference.
+   *   For kLzEnd, phrase ends are marked on rows of RLBWT by "marks_" (another DynRle whose rows correspond to the RLBWT),
+   *   where each marked row is a run of its own (of character in {1, 2, 3} different from adjacent marks) sampling its text position,
+   *   so that a marked row in bwt-interval and the end of a source are found by a single search.
+   *   The phrase prefix of kLzEnd is extended only while each of its prefixes ends at a phrase end somewhere (checked online).
+   *   Since this is not monotone in the prefix length, a longer valid phrase beyond the first failure is not searched,
+   *   i.e., it is a restricted (online) variant of greedy LZ-End, which may produce more factors.
+   */
+  template<class DynRle, class Sink>
+  class OnlineLzParser
+  {
+  public:
+    using RlbwtT = OnlineLz77ViaRlbwt<DynRle>;
+    using bwttracker = typename RlbwtT::bwttracker;
+    using BTreeNodeT = typename DynRle::BTreeNodeT;
+    static constexpr uint64_t NOTFOUND{UINT64_MAX};
+
+
+  private:
+    RlbwtT rlbwt_;
+    DynRle marks_; //!< (Only for kLzEnd) Rows of RLBWT, where rows of phrase ends are marked by characters in {1, 2, 3}.
+    Sink & sink_;
+    bwttracker tracker_; //!< BWT tracker for current phrase prefix.
+    uint64_t l_; //!< Length of current phrase prefix.
+    uint64_t srcEnd_; //!< (Only for kLzEnd) End of source (phrase end) for current phrase prefix.
+    uint64_t z_; //!< Num of factors pushed.
+    uint64_t n_; //!< Num of characters parsed.
+    uint64_t refLen_; //!< Length of reference (only for kRlz).
+    const LzParseMode mode_;
+    uint8_t lastCh_;
+
+
+  public:
+    OnlineLzParser
+    (
+     Sink & sink, //!< Sink of factors.
+     const LzParseMode mode = LzParseMode::kLz77,
+     const size_t initNumBtms = 1 //!< Initial size of DynRle to reserve.
+     ) :
+      rlbwt_(initNumBtms),
+      marks_(initNumBtms, (mode == LzParseMode::kLzEnd) ? 256 : 0),
+      sink_(sink),
+      tracker_(0, 1, 0),
+      l_(0),
+      srcEnd_(0),
+      z_(0),
+      n_(0),
+      refLen_(0),
+      mode_(mode),
+      lastCh_(0)
+    {
+      if (mode_ == LzParseMode::kLzEnd) {
+        uint64_t pos = 0;
+        marks_.pushbackRun(pos, 0); // Row of empty prefix.
+      }
+    }
+
+
+    /*!
+     * @brief Index reference (only for kRlz, and before parsing any text).
+     */
+    void setReference
+    (
+     const uint8_t * ref,
+     const size_t len
+     ) {
+      assert(mode_ == LzParseMode::kRlz && n_ == 0);
+
+      for (size_t i = 0; i < len; ++i) {
+        rlbwt_.extend(ref[i]);
+      }
+      refLen_ += len;
+      tracker_ = bwttracker(0, rlbwt_.getLenWithEndmarker(), 0);
+    }
+
+
+    /*!
+     * @brief Parse next character "uc".
+     */
+    void feed
+    (
+     const uint8_t uc
+     ) {
+      ++n_;
+      lastCh_ = uc;
+      if (mode_ == LzParseMode::kRlz) {
+        if (rlbwt_.lfMap(tracker_, uc)) {
+          ++l_;
+          //// The end-marker row (suffix of reference) cannot be extended and lfMap of its interval goes through the next row,
+          //// so exclude it unless it is the only row (for which "refLen_" tracked by lfMap is kept).
+          if (std::get<0>(tracker_) == rlbwt_.getEndmarkerPos() && std::get<1>(tracker_) > std::get<0>(tracker_) + 1) {
+            ++(std::get<0>(tracker_));
+            std::get<2>(tracker_) = rlbwt_.getSuccSamplePos();
+          }
+        } else {
+          pushFactor(std::get<2>(tracker_) - l_, uc);
+          tracker_ = bwttracker(0, rlbwt_.getLenWithEndmarker(), 0);
+        }
+        return;
+      }
+
+      bwttracker tracker = tracker_;
+      bool extended = rlbwt_.lfMap(tracker, uc);
+      if (extended && mode_ == LzParseMode::kLzEnd) {
+        const uint64_t e = searchMark(std::get<0>(tracker), std::get<1>(tracker));
+        extended = (e != NOTFOUND);
+        if (extended) {
+          srcEnd_ = e;
+        }
+      }
+      if (extended) {
+        ++l_;
+        tracker_ = tracker;
+        ++(std::get<1>(tracker_)); // New suffix falls inside range
+      } else { // Extension failed: End of an LZ factor.
+        pushFactor((mode_ == LzParseMode::kLzEnd) ? srcEnd_ - l_ : std::get<2>(tracker_) - l_, uc);
+        tracker_ = bwttracker(0, rlbwt_.getLenWithEndmarker() + 1, 0); // +1 because we have not inserted "ch".
+      }
+
+      rlbwt_.extend(uc);
+      if (mode_ == LzParseMode::kLzEnd) {
+        insertMark(rlbwt_.getEndmarkerPos(), !extended);
+      }
+      if (std::get<0>(tracker_) == rlbwt_.getEndmarkerPos()) {
+        std::get<2>(tracker_) = rlbwt_.getSuccSamplePos();
+      }
+    }
+
+
+    /*!
+     * @brief Parse "len" characters of "text".
+     */
+    void feed
+    (
+     const uint8_t * text,
+     const size_t len
+     ) {
+      for (size_t i = 0; i < len; ++i) {
+        feed(text[i]);
+      }
+    }
+
+
+    /*!
+     * @brief Push last factor if the text ends in the middle of a phrase.
+     * @note
+     *   The last factor copies all but the last character of the phrase prefix, followed by the last character.
+     *   No character should be fed after finish.
+     */
+    void finish() {
+      if (l_) {
+        const uint64_t end = (mode_ == LzParseMode::kLzEnd) ? srcEnd_ : std::get<2>(tracker_);
+        pushFactor(end - l_, lastCh_, l_ - 1);
+        l_ = 0;
+      }
+    }
+
+
+    uint64_t getNumFactors() const noexcept {
+      return z_;
+    }
+
+
+    /*!
+     * @brief Num of characters parsed (not including reference).
+     */
+    uint64_t getNumParsed() const noexcept {
+      return n_;
+    }
+
+
+    uint64_t getRefLen() const noexcept {
+      return refLen_;
+    }
+
+
+    const RlbwtT & getRlbwt() const noexcept {
+      return rlbwt_;
+    }
+
+
+    //////////////////////////////// statistics
+    size_t calcMemBytes
+    (
+     bool includeThis = true
+     ) const noexcept {
+      size_t size = sizeof(*this) * includeThis;
+      size += rlbwt_.calcMemBytes(false);
+      if (mode_ == LzParseMode::kLzEnd) {
+        size += marks_.calcMemBytes(false);
+      }
+      return size;
+    }
+
+
+  private:
+    void pushFactor
+    (
+     const uint64_t beg,
+     const uint8_t ch,
+     const uint64_t len
+     ) {
+      sink_(beg, len, ch);
+      ++z_;
+    }
+
+
+    void pushFactor
+    (
+     const uint64_t beg,
+     const uint8_t ch
+     ) {
+      pushFactor(beg, ch, l_);
+      l_ = 0;
+    }
+
+
+    /*!
+     * @brief Return text position (phrase end) of first marked row in [left..right) (NOTFOUND if none).
+     */
+    uint64_t searchMark
+    (
+     const uint64_t left,
+     const uint64_t right
+     ) const noexcept {
+      if (left >= right) {
+        return NOTFOUND;
+      }
+      uint64_t relPos = left;
+      uint64_t idxM = marks_.searchPosM(relPos);
+      uint64_t pos = left - relPos; // Beginning of run of "idxM".
+      while (marks_.getCharFromIdxM(idxM) == 0) {
+        pos += marks_.getWeightFromIdxM(idxM);
+        if (pos >= right) {
+          return NOTFOUND;
+        }
+        idxM = marks_.getNextIdxM(idxM);
+        if (idxM == BTreeNodeT::NOTFOUND) {
+          return NOTFOUND;
+        }
+      }
+      return marks_.getSampleFromIdxM(idxM);
+    }
+
+
+    /*!
+     * @brief Insert row at "pos" for prefix of length "n_", marked if "mark".
+     */
+    void insertMark
+    (
+     uint64_t pos,
+     const bool mark
+     ) {
+      if (!mark) {
+        marks_.insertRun(pos, 0);
+        return;
+      }
+      const uint64_t prevCh = (pos > 0) ? charAtMarks(pos - 1) : 0;
+      const uint64_t nextCh = (pos < marks_.getSumOfWeight()) ? charAtMarks(pos) : 0;
+      uint8_t ch = 1;
+      while (ch == prevCh || ch == nextCh) {
+        ++ch;
+      }
+      const auto sampleUb = marks_.getSampleUb();
+      if (n_ >= sampleUb) {
+        marks_.increaseSampleUb(std::max(n_ + 1, 2 * sampleUb));
+      }
+      const uint64_t idxM = marks_.insertRun(pos, ch);
+      marks_.setSample(idxM, n_);
+    }
+
+
+    uint64_t charAtMarks
+    (
+     uint64_t pos
+     ) const noexcept {
+      return marks_.getCharFromIdxM(marks_.searchPosM(pos));
+    }
+  };
 };
 
 #endif
@@ -17,11 +17,21 @@
 #include <fstream>
 #include <iomanip>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <string>
+#include <vector>
 
 #include "cmdline.h"
 #include "OnlineRindex.hpp"
 #include "DynRleForRlbwt.hpp"
 #include "DynSuccForRindex.hpp"
+#include "RlbwtConfigs.hpp"
+#include "RindexBatchQuery.hpp"
+#include "RindexSnapshot.hpp"
+#include "MatchingStats.hpp"
+#include "NumaUtil.hpp"
 
 
 using namespace itmmti;
@@ -30,92 +40,360 @@ using SizeT = uint64_t; // Text length should fit in SizeT.
 int main(int argc, char *argv[])
 {
   cmdline::parser parser;
-  parser.add<std::string>("input", 'i', "input file name", true);
+  parser.add<std::string>("input", 'i', "input file name", false, "");
+  parser.add<std::string>("save", 0, "file name to save the constructed index", false, "");
+  parser.add<std::string>("load", 0, "file name of saved index to load (input, if given, is appended to it)", false, "");
+  parser.add<std::string>("checkpoint", 0, "checkpoint file name", false, "");
+  parser.add<uint64_t>("ckpt_chars", 0, "write checkpoint every given number of characters (0: only at the end)", false, 0);
+  parser.add<bool>("resume", 0, "resume construction from checkpoint, skipping characters already processed", false, 0);
   parser.add<bool>("check", 0, "check correctness", false, 0);
+  parser.add<std::string>("patterns", 0, "file of patterns (one per line) to count on the index", false, "");
+  parser.add<bool>("locate", 0, "locate occurrences of patterns", false, 0);
+  parser.add<uint64_t>("max_occs", 0, "max num of occurrences located for each pattern (0: all)", false, 0);
+  parser.add<std::string>("query_out", 0, "output file of query results (default: stdout); results of ms follow those of patterns (tsv only)", false, "");
+  parser.add<std::string>("query_format", 0, "format of query results: tsv or bin (LEB128 varints)", false, "tsv");
+  parser.add<unsigned>("threads", 0, "num of threads for queries (0: hardware concurrency)", false, 0);
+  parser.add<unsigned>("group", 0, "num of patterns interleaved in a thread", false, 8);
+  parser.add<std::string>("ms", 0, "file of queries (one per line) to compute matching statistics against the index", false, "");
+  parser.add<uint64_t>("mem_len", 0, "report MEMs of at least given length instead of matching statistics (0: matching statistics)", false, 0);
+  parser.add<uint64_t>("snapshot_chars", 0, "publish snapshot every given number of characters, which a reader thread queries with patterns during construction (0: no)", false, 0);
+  parser.add<bool>("compact", 0, "replace successor data structure by compact static one for queries (after saving)", false, 0);
+  parser.add<uint64_t>("succ_rate", 0, "with compact, drop successor entries recoverable by at most given num of LF steps (0: none)", false, 0);
+  parser.add<std::string>("config", 0, "template configuration (e.g., b32m32s8) or auto (chosen by profiling input)", false, "b32m32s8");
+  parser.add<std::string>("expected_runs", 0, "num of runs to reserve space for (0 for none) or auto (estimated by profiling input)", false, "0");
+  parser.add<bool>("numa", 0, "interleave index queried (and snapshots) over NUMA nodes; copies index after construction (peak memory: index, its serialized bytes and the copy)", false, 0);
   parser.add<bool>("verbose", 'v', "verbose", false, 0);
   parser.add("help", 0, "print help");
 
   parser.parse_check(argc, argv);
   const std::string in = parser.get<std::string>("input");
+  const std::string saveFile = parser.get<std::string>("save");
+  const std::string loadFile = parser.get<std::string>("load");
+  const std::string ckptFile = parser.get<std::string>("checkpoint");
+  const uint64_t ckptChars = parser.get<uint64_t>("ckpt_chars");
+  const bool resume = parser.get<bool>("resume");
   const bool check = parser.get<bool>("check");
+  const std::string patFile = parser.get<std::string>("patterns");
+  const bool locate = parser.get<bool>("locate");
+  const uint64_t maxOccs = parser.get<uint64_t>("max_occs");
+  const std::string queryOut = parser.get<std::string>("query_out");
+  const std::string queryFormat = parser.get<std::string>("query_format");
+  const unsigned numThreads = parser.get<unsigned>("threads");
+  const unsigned groupSize = parser.get<unsigned>("group");
+  const uint64_t snapshotChars = parser.get<uint64_t>("snapshot_chars");
+  const std::string msFile = parser.get<std::string>("ms");
+  const uint64_t memLen = parser.get<uint64_t>("mem_len");
   const bool verbose = parser.get<bool>("verbose");
+  const std::string config = parser.get<std::string>("config");
+  const bool compact = parser.get<bool>("compact");
+  const uint64_t succRate = parser.get<uint64_t>("succ_rate");
+  const bool numa = parser.get<bool>("numa");
 
-  auto t1 = std::chrono::high_resolution_clock::now();
-  std::cout << "R-index constructing..." << std::endl;
-
-  std::ifstream ifs(in);
-
-  const size_t step = 1000000; // Print status every step characters.
-  size_t last_step = 0;
-
-  using BTreeNodeT = BTreeNode<32>; // BTree arity = {16, 32, 64, 128}
-  using BtmNodeMT = BtmNodeM_StepCode<BTreeNodeT, 32>; // BtmNode arity in {16, 32, 64, 128}.
-  using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>; // Each block has 512 btmNodeM.
-  using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, 8>; // CharT = uint32_t. BtmNode arity = {4, 8, 16, 32, 64, 128}.
-  using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>; // Each block has 1024 btmNodeS.
-  using DynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_WBitsBlockVec<1024>, BtmMInfoT, BtmSInfoT>;
-  using BtmNodeInSucc = BtmNodeForPSumWithVal<32>; // BtmNode arity = {16, 32, 64, 128}.
-  using DynSuccT = DynSuccForRindex<BTreeNodeT, BtmNodeInSucc>;
-  using RindexT = OnlineRlbwtIndex<DynRleT, DynSuccT>;
-  RindexT rindex(1);
-  SizeT pos = 0; // Current txt-pos (0base)
-  char c; // Assume that the input character fits in char.
-  unsigned char uc;
-
-  while (ifs.peek() != std::ios::traits_type::eof()) {
-    ifs.get(c);
-    uc = static_cast<unsigned char>(c);
-    if (verbose) {
-      // if (pos >= 0) {
-      //   std::cerr << "loop: " << pos
-      //             << ", prev = " << rindex.getPrevSamplePos()
-      //             << ", next = " << rindex.getNextSamplePos()
-      //             << ", insert " << (int)c << "(" << c << ")" << " at " << rindex.getEndmarkerPos() << std::endl;
-      // }
-      if (pos > last_step + (step - 1)) {
+  if (in.empty() && loadFile.empty()) {
+    std::cerr << "Error: input or load file must be given." << std::endl;
+    std::cerr << parser.usage();
+    return 1;
+  }
+  if ((resume || ckptChars) && (ckptFile.empty() || in.empty())) {
+    std::cerr << "Error: checkpointing requires input and checkpoint file." << std::endl;
+    std::cerr << parser.usage();
+    return 1;
+  }
+  if (resume && !loadFile.empty()) {
+    std::cerr << "Error: resume and load cannot be used together." << std::endl;
+    return 1;
+  }
+  if (queryFormat != "tsv" && queryFormat != "bin") {
+    std::cerr << "Error: unknown query format " << queryFormat << std::endl;
+    return 1;
+  }
+  if (!queryOut.empty() && !patFile.empty() && !msFile.empty() && queryFormat == "bin") {
+    std::cerr << "Error: results of ms (text) cannot follow binary results of patterns in the same query_out." << std::endl;
+    return 1;
+  }
+  if (succRate && !compact) {
+    std::cerr << "Error: succ_rate requires compact." << std::endl;
+    return 1;
+  }
+  if (groupSize == 0) {
+    std::cerr << "Error: group must be positive." << std::endl;
+    return 1;
+  }
+  if (snapshotChars && (patFile.empty() || in.empty())) {
+    std::cerr << "Error: snapshot_chars requires input and patterns." << std::endl;
+    return 1;
+  }
+
+  uint64_t expectedRuns = 0;
+  uint64_t inputLen = 0;
+  if (!in.empty() && !getExpectedRuns(parser.get<std::string>("expected_runs"), in, expectedRuns, inputLen)) {
+    return 1;
+  }
+
+  std::vector<std::string> pats;
+  if (!patFile.empty()) {
+    std::ifstream pfs(patFile);
+    if (!pfs) {
+      std::cerr << "Error: failed to open " << patFile << std::endl;
+      return 1;
+    }
+    rindexbatch::readPatterns(pfs, pats);
+  }
+
+  return runWithRlbwtConfig(config, in, [&](auto cfg) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    const size_t step = 1000000; // Print status every step characters.
+    size_t last_step = 0;
+
+    using RindexT = typename decltype(cfg)::RindexT; // See RlbwtConfigs.hpp for configurations.
+    SnapshotIndex<RindexT> sindex(1);
+    RindexT & rindex = sindex.getWriter(); // Only this thread updates it.
+    sindex.setNumaInterleave(numa);
+
+    const std::string src = resume ? ckptFile : loadFile;
+    if (!src.empty()) {
+      std::cout << "R-index loading..." << std::endl;
+      if (!rindex.load(src)) {
+        std::cerr << "Error: failed to load " << src << std::endl;
+        return 1;
+      }
+      auto t2 = std::chrono::high_resolution_clock::now();
+      double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
+      std::cout << "R-index loading done. " << sec << " sec" << std::endl;
+    }
+
+    auto writeCheckpoint = [&]() {
+      if (!serialutil::writeFileAtomically(ckptFile, [&](std::ostream &os) { rindex.serialize(os); })) {
+        std::cerr << "Warning: failed to write checkpoint " << ckptFile << std::endl;
+      }
+    };
+
+    if (!in.empty()) {
+      std::cout << "R-index constructing..." << std::endl;
+
+      std::ifstream ifs(in);
+      SizeT pos = 0; // Current txt-pos (0base) in input
+      if (resume) { // Text processed so far is the prefix of input.
+        pos = rindex.getLenWithoutEndmarker();
+        ifs.seekg(pos);
         last_step = pos;
-        std::cout << " " << pos << " characters processed..." << std::endl;
-        // {//debug
-        //   rindex.printDebugInfo(std::cout);
+        std::cout << " resume from " << pos << " characters" << std::endl;
+      }
+      if (expectedRuns) {
+        rindex.reserve(expectedRuns, rindex.getLenWithoutEndmarker() + inputLen);
+      }
+      SizeT last_ckpt = pos;
+      SizeT last_snapshot = pos;
+
+      //// Reader thread counts patterns on the latest snapshot whenever new one is published.
+      std::atomic<bool> done(false);
+      std::thread reader;
+      if (snapshotChars) {
+        reader = std::thread([&]() {
+          uint64_t lastEpoch = 0;
+          while (true) {
+            const bool fin = done.load();
+            const uint64_t epoch = sindex.getEpoch();
+            if (epoch != lastEpoch) {
+              lastEpoch = epoch;
+              const auto snapshot = sindex.acquire();
+              rindexbatch::BatchResult res;
+              rindexbatch::queryBatch(*snapshot, pats, res, false, 0, 1, groupSize);
+              uint64_t sum = 0;
+              for (const auto num : res.numOccs) {
+                sum += num;
+              }
+              std::cerr << " snapshot " << epoch << " (" << snapshot->getLenWithoutEndmarker()
+                        << " characters): total occ of patterns = " << sum << std::endl;
+            } else if (fin) {
+              break;
+            } else {
+              std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+          }
+        });
+      }
+      char c; // Assume that the input character fits in char.
+      unsigned char uc;
+
+      while (ifs.peek() != std::ios::traits_type::eof()) {
+        ifs.get(c);
+        uc = static_cast<unsigned char>(c);
+        if (verbose) {
+          // if (pos >= 0) {
+          //   std::cerr << "loop: " << pos
+          //             << ", prev = " << rindex.getPrevSamplePos()
+          //             << ", next = " << rindex.getNextSamplePos()
+          //             << ", insert " << (int)c << "(" << c << ")" << " at " << rindex.getEndmarkerPos() << std::endl;
+          // }
+          if (pos > last_step + (step - 1)) {
+            last_step = pos;
+            std::cout << " " << pos << " characters processed..." << std::endl;
+            // {//debug
+            //   rindex.printDebugInfo(std::cout);
+            // }
+            // rindex.printStatistics(std::cout, false);
+          }
+        }
+
+        rindex.extend(uc);
+        // if (verbose) {
+        //   if (pos > 0) {
+        //     std::cout << "Status after inserting pos = " << pos << std::endl;
+        //     rindex.printDebugInfo(std::cout);
+        //     // rindex.printStatistics(std::cout);
+        //   }
         // }
-        // rindex.printStatistics(std::cout, false);
+        ++pos;
+        if (ckptChars && pos - last_ckpt >= ckptChars) {
+          last_ckpt = pos;
+          writeCheckpoint();
+        }
+        if (snapshotChars && pos - last_snapshot >= snapshotChars) {
+          last_snapshot = pos;
+          sindex.commit();
+        }
+      }
+      if (snapshotChars) {
+        sindex.commit();
+        done = true;
+        reader.join();
+      }
+
+      ifs.close();
+      if (!ckptFile.empty()) {
+        writeCheckpoint();
       }
+
+      auto t2 = std::chrono::high_resolution_clock::now();
+      double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
+      std::cout << "R-index construction done. " << sec << " sec" << std::endl;
     }
+    rindex.printStatistics(std::cout, false);
 
-    rindex.extend(uc);
-    // if (verbose) {
-    //   if (pos > 0) {
-    //     std::cout << "Status after inserting pos = " << pos << std::endl;
-    //     rindex.printDebugInfo(std::cout);
-    //     // rindex.printStatistics(std::cout);
-    //   }
-    // }
-    ++pos;
-  }
+    if (!saveFile.empty()) {
+      std::ofstream ofs(saveFile, std::ios::out | std::ios::binary);
+      rindex.serialize(ofs);
+      std::cout << "R-index saved to " << saveFile << std::endl;
+    }
 
-  ifs.close();
+    //// Queries run on "qindex", which is the writer itself or its copy interleaved over NUMA nodes.
+    //// The copy is made before releasing the writer, so that memory usage temporarily becomes the writer,
+    //// its serialized bytes and the copy. Query structures built on the copy below are interleaved as well.
+    std::shared_ptr<RindexT> numaCopy;
+    if (numa && (!patFile.empty() || !msFile.empty() || check)) {
+      numaCopy = sindex.makeCopy();
+      if (!numaCopy) {
+        std::cerr << "Error: failed to copy index for NUMA interleaving" << std::endl;
+        return 1;
+      }
+      rindex.clearAll();
+      std::cout << "R-index copied for queries (interleaved over " << numautil::getNumNodes() << " NUMA nodes)" << std::endl;
+    }
+    RindexT & qindex = (numaCopy) ? *numaCopy : rindex;
+    {
+      numautil::ScopedInterleave interleave(static_cast<bool>(numaCopy));
+      if (!patFile.empty() || !msFile.empty() || check) { // Only queries follow.
+        qindex.buildFlatIndex();
+      }
+      if (compact) {
+        const size_t before = qindex.calcMemBytes(true);
+        qindex.compactSucc(succRate);
+        std::cout << "Successor data structure compacted (succ_rate = " << succRate << "): "
+                  << before << " bytes -> " << qindex.calcMemBytes(true) << " bytes" << std::endl;
+      }
+    }
 
-  auto t2 = std::chrono::high_resolution_clock::now();
-  double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
-  std::cout << "R-index construction done. " << sec << " sec" << std::endl;
-  rindex.printStatistics(std::cout, false);
+    if (!patFile.empty()) {
+      t1 = std::chrono::high_resolution_clock::now();
+      rindexbatch::BatchResult res;
+      rindexbatch::queryBatch(qindex, pats, res, locate, maxOccs, numThreads, groupSize);
+      auto t2 = std::chrono::high_resolution_clock::now();
+      double microsec = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+      std::cerr << pats.size() << " patterns " << (locate ? "located" : "counted") << " in " << microsec << " micro sec. "
+                << (pats.empty() ? 0 : microsec / pats.size()) << " micro sec. each." << std::endl;
+
+      std::ofstream qfs;
+      if (!queryOut.empty()) {
+        qfs.open(queryOut, std::ios::out | std::ios::binary);
+        if (!qfs) {
+          std::cerr << "Error: failed to open " << queryOut << std::endl;
+          return 1;
+        }
+      }
+      std::ostream & qos = (queryOut.empty()) ? std::cout : qfs;
+      if (queryFormat == "bin") {
+        rindexbatch::writeResultsBinary(qos, res);
+      } else {
+        rindexbatch::writeResultsTsv(qos, res);
+      }
+      qos.flush();
+    }
+
+    if (!msFile.empty()) {
+      std::ifstream mfs(msFile);
+      if (!mfs) {
+        std::cerr << "Error: failed to open " << msFile << std::endl;
+        return 1;
+      }
+      std::vector<std::string> queries;
+      rindexbatch::readPatterns(mfs, queries);
+      mfs.close();
 
-  if (check) { // check correctness
-    t1 = std::chrono::high_resolution_clock::now();
-    std::cout << "Checking RLBWT inversion..." << std::endl;
-    std::ifstream ifssss(in);
-    if (rindex.checkDecompress(ifssss)) {
+      std::ofstream qfs;
+      if (!queryOut.empty()) { // Appended to results of patterns (tsv) if any, and stale files are truncated otherwise.
+        qfs.open(queryOut, std::ios::out | ((patFile.empty()) ? std::ios::trunc : std::ios::app));
+        if (!qfs) {
+          std::cerr << "Error: failed to open " << queryOut << std::endl;
+          return 1;
+        }
+      }
+      std::ostream & qos = (queryOut.empty()) ? std::cout : qfs;
+      t1 = std::chrono::high_resolution_clock::now();
+      uint64_t totalLen = 0;
+      for (uint64_t q = 0; q < queries.size(); ++q) {
+        totalLen += queries[q].size();
+        if (memLen) { // "query index \t beginning position in query \t length \t occ" per MEM
+          matchingstats::findMems(qindex, queries[q], memLen, [&](uint64_t qBeg, uint64_t len, uint64_t occ) {
+              qos << q << '\t' << qBeg << '\t' << len << '\t' << occ << '\n';
+            });
+        } else { // "query index \t comma-separated lengths \t comma-separated occs (-1 for none)" per query
+          std::string lens, occs;
+          matchingstats::computeMatchingStats(qindex, queries[q], [&](uint64_t i, uint64_t len, uint64_t occ) {
+              if (i) {
+                lens += ',';
+                occs += ',';
+              }
+              lens += std::to_string(len);
+              occs += (occ == matchingstats::NOTFOUND) ? std::string("-1") : std::to_string(occ);
+            });
+          qos << q << '\t' << lens << '\t' << occs << '\n';
+        }
+      }
+      qos.flush();
       auto t2 = std::chrono::high_resolution_clock::now();
-      double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
-      std::cout << "RLBWT decompressed correctly. " << sec << " sec" << std::endl;
-    } else {
-      std::cout << "RLBWT inversion failed." << std::endl;
+      double microsec = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+      std::cerr << queries.size() << " queries (" << totalLen << " characters) matched in " << microsec << " micro sec." << std::endl;
     }
 
-    std::cout << "Checking correctness of data structures..." << std::endl;
-    rindex.printDebugInfo(std::cout);
-    std::cout << "Done." << std::endl;
-  }
+    if (check && !in.empty() && loadFile.empty()) { // check correctness (input must be the whole text)
+      t1 = std::chrono::high_resolution_clock::now();
+      std::cout << "Checking RLBWT inversion..." << std::endl;
+      std::ifstream ifssss(in);
+      if (qindex.checkDecompress(ifssss)) {
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
+        std::cout << "RLBWT decompressed correctly. " << sec << " sec" << std::endl;
+      } else {
+        std::cout << "RLBWT inversion failed." << std::endl;
+      }
+
+      std::cout << "Checking correctness of data structures..." << std::endl;
+      qindex.printDebugInfo(std::cout);
+      std::cout << "Done." << std::endl;
+    }
 
-  return 0;
+    return 0;
+  }, "b32m32s8");
 }
@@ -15,9 +15,15 @@
 
 #include <stdint.h>
 #include <cassert>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
+#include "SerialUtil.hpp"
+#include "NodeArena.hpp"
+#include "MoveTable.hpp"
+#include "StaticSuccForRindex.hpp"
+
 namespace itmmti 
 {
   /*!
@@ -36,6 +42,13 @@ namespace itmmti
     //// the third uint is tracking the idxS from which we can obtain sampled position for "BWT[left]",
     //// and the last uint represents how far we are from the last sampled position.
     using PatTracker = std::tuple<uint64_t, uint64_t, uint64_t, uint64_t>;
+    //// LfMapHint: Result of first stage of "lfMap(PatTracker &, ch)" computed by "prepareLfMap".
+    struct LfMapHint
+    {
+      uint64_t idxM; //!< idxM of run containing left bound of tracker.
+      uint64_t idxS; //!< idxS corresponding to idxM.
+      uint64_t relPos; //!< Relative position of left bound in the run.
+    };
     using CharT = typename DynRle::CharT;
     using BTreeNodeT = typename DynRle::BTreeNodeT;
     static constexpr uintptr_t NOTFOUND{BTreeNodeT::NOTFOUND};
@@ -52,6 +65,8 @@ namespace itmmti
     uint64_t nextSamplePos_; //!< Tracking txt-pos (0base) for character at bwt-position next to current emPos_.
     uint64_t lastSamplePos_; //!< Tracking txt-pos (0base) for last bwt-position.
     CharT em_; //!< End marker. It is used only when bwt[emPos_] is accessed (and does not matter if em_ appears in the input text).
+    StaticSuccForRindex phi_; //!< Compact successor data structure replacing succ_ in query phases (empty unless compactSucc is called).
+    uint64_t phiRate_; //!< Max num of LF steps to recover entries dropped from phi_ (0 if no entry is dropped).
 
 
   public:
@@ -63,7 +78,9 @@ namespace itmmti
      ) :
       drle_(),
       succ_(),
-      em_(em)
+      em_(em),
+      phi_(),
+      phiRate_(0)
     {
       if (initNumBtms) {
         drle_.init(initNumBtms, initSampleUb);
@@ -105,6 +122,8 @@ namespace itmmti
       }
       drle_.clearAll();
       succ_.clearAll();
+      phi_.clear();
+      phiRate_ = 0;
     }
 
 
@@ -189,6 +208,8 @@ namespace itmmti
     (
      const CharT ch //!< Char to append.
      ) {
+      assert(!isSuccCompact()); // succ_ was released by compactSucc.
+
       const uint64_t txtPos = drle_.getSumOfWeight(); //!< Txt-position of "ch" (0base).
       {
         const auto sampleUb = drle_.getSampleUb();
@@ -317,6 +338,10 @@ namespace itmmti
     (
      const uint64_t txtPos //!< Text-position for currently focused character.
      ) const noexcept {
+      if (isSuccCompact()) {
+        assert(phiRate_ == 0); // Dropped entries need bwt-position (see the variant below).
+        return phi_.calcNextPos(txtPos, getLenWithoutEndmarker(), prevSamplePos_, nextSamplePos_);
+      }
       return succ_.calcNextPos(txtPos, getLenWithoutEndmarker(), prevSamplePos_, nextSamplePos_);
       // if (txtPos < tailBeg_) {
       //   return succ_.calcNextPos(txtPos, getLenWithoutEndmarker(), prevSamplePos_, nextSamplePos_);
@@ -326,6 +351,99 @@ namespace itmmti
     }
 
 
+    /*!
+     * @brief Variant of "calcNextPos" reusing "cursor" of successor searches for consecutive calls.
+     */
+    uint64_t calcNextPos
+    (
+     const uint64_t txtPos, //!< Text-position for currently focused character.
+     typename DynSuccT::Cursor & cursor //!< [in,out] Cursor (default constructed for the first call).
+     ) const noexcept {
+      if (isSuccCompact()) {
+        return calcNextPos(txtPos);
+      }
+      return succ_.calcNextPos(txtPos, getLenWithoutEndmarker(), prevSamplePos_, nextSamplePos_, cursor);
+    }
+
+
+    /*!
+     * @brief Variant of "calcNextPos" given also bwt-position of "txtPos", which works even if entries are dropped by compactSucc.
+     * @note
+     *   Let "q" be the successor of "txtPos" in phi_. Entries of keys in [txtPos..q) were dropped only if
+     *   they are within "phiRate_" from the previous key kept, so that LF steps from "bwtPos" reach the dropped key
+     *   (the last row of a run) within "phiRate_" steps, from which its value is recovered by at most "phiRate_" LF steps.
+     *   If no run boundary is found, the answer is computed from "q" as usual.
+     */
+    uint64_t calcNextPos
+    (
+     const uint64_t txtPos, //!< Text-position for currently focused character.
+     uint64_t bwtPos //!< Bwt-position corresponding to "txtPos".
+     ) const noexcept {
+      if (!isSuccCompact()) {
+        return calcNextPos(txtPos);
+      }
+      const uint64_t len = getLenWithoutEndmarker();
+      uint64_t key;
+      const uint64_t val = phi_.searchSucc(txtPos, key);
+      const uint64_t dist = key - txtPos; // distance to sampled position
+      const uint64_t steps = std::min(dist, phiRate_);
+      for (uint64_t k = 0; k < steps; ++k) {
+        if (bwtPos == emPos_) {
+          return nextSamplePos_ - k;
+        } else if (bwtPos + 1 == emPos_) {
+          return len - k;
+        }
+        uint64_t pos = bwtPos - (bwtPos > emPos_);
+        const uint64_t idxM = drle_.searchPosM(pos);
+        uint64_t nextPos;
+        if (pos + 1 == drle_.getWeightFromIdxM(idxM) && calcTxtPosByLf(bwtPos + 1, phiRate_, nextPos)) {
+          return nextPos - k; // Key txtPos + k was dropped (otherwise, adjacent runs have the same character).
+        }
+        bwtPos = lfMap(bwtPos);
+      }
+      if (txtPos <= prevSamplePos_ && prevSamplePos_ - txtPos <= dist) {
+        return len - (prevSamplePos_ - txtPos);
+      } else if (len - txtPos <= dist) {
+        return nextSamplePos_ - (len - txtPos);
+      }
+      return val - dist;
+    }
+
+
+    /*!
+     * @brief Write first "num" occs (ending positions) of valid PatTracker to "out" in the order of BWT rows.
+     * @return Num of occs written, i.e., min("num", getNumOcc(tracker)).
+     * @note Successor searches walking consecutive BWT rows share a cursor, so that they descend from the root
+     *       only when the next text-position leaves the bottom node searched last.
+     */
+    uint64_t locateAll
+    (
+     const PatTracker & tracker, //!< Valid PatTracker.
+     uint64_t * out, //!< [out] Caller-supplied buffer of at least min("num", getNumOcc(tracker)) elements.
+     const uint64_t num = UINT64_MAX //!< Max num of occs to write.
+     ) const noexcept {
+      const uint64_t numOcc = std::min(num, getNumOcc(tracker));
+      if (numOcc == 0) {
+        return 0;
+      }
+      uint64_t endPos = calcFstOcc(tracker);
+      out[0] = endPos;
+      if (isSuccCompact()) {
+        for (uint64_t i = 1; i < numOcc; ++i) {
+          endPos = calcNextPos(endPos, std::get<0>(tracker) + i - 1);
+          out[i] = endPos;
+        }
+        return numOcc;
+      }
+      typename DynSuccT::Cursor cursor;
+      for (uint64_t i = 1; i < numOcc; ++i) {
+        endPos = calcNextPos(endPos, cursor);
+        out[i] = endPos;
+      }
+      return numOcc;
+    }
+
+
     /*!
      * @brief Compute the first occ (ending position) from valid PatTracker.
      */
@@ -338,13 +456,39 @@ namespace itmmti
       }
       const uint64_t idxS = std::get<2>(tracker);
       if (idxS) {
-        const uint64_t key = drle_.getSampleFromIdxS(drle_.getNextIdxS(idxS));
+        const uint64_t nextIdxS = drle_.getNextIdxS(idxS);
+        const uint64_t key = drle_.getSampleFromIdxS(nextIdxS);
+        if (phiRate_) { // Key is at the row previous to the run of "nextIdxS".
+          const uint64_t pos = drle_.calcPosFromIdxM(drle_.idxS2M(nextIdxS)) - 1;
+          return calcNextPos(key, pos + (pos >= emPos_)) + std::get<3>(tracker);
+        }
         return calcNextPos(key) + std::get<3>(tracker);
       }
       return std::get<3>(tracker);
     }
 
 
+    /*!
+     * @brief First stage of "lfMap(PatTracker &, ch)" independent of "ch":
+     *        locate the run containing the left bound of "tracker" and prefetch its bottom node of separated tree.
+     * @note
+     *   Calling it for several independent trackers before calling "lfMap(tracker, ch, hint)" for them
+     *   overlaps cache misses of the queries (see ::rindexbatch::queryBatch).
+     */
+    void prepareLfMap
+    (
+     const PatTracker & tracker, //!< Valid PatTracker.
+     LfMapHint & hint //!< [out]
+     ) const noexcept {
+      assert(std::get<0>(tracker) < std::get<1>(tracker) && std::get<1>(tracker) <= getLenWithEndmarker());
+
+      hint.relPos = std::get<0>(tracker) - (std::get<0>(tracker) > emPos_); // Taking (implicit) end-marker into account.
+      hint.idxM = drle_.searchPosM(hint.relPos); // relPos is modified to relative pos.
+      hint.idxS = drle_.idxM2S(hint.idxM);
+      drle_.prefetchIdxS(hint.idxS);
+    }
+
+
     /*!
      * @brief Compute bwt-interval for cW from bwt-interval for W.
      * @note Intervals are [left..right), where right bound is exclusive.
@@ -353,6 +497,21 @@ namespace itmmti
     (
      PatTracker & tracker, //!< Valid PatTracker.
      const CharT ch
+     ) const noexcept {
+      LfMapHint hint;
+      prepareLfMap(tracker, hint);
+      return lfMap(tracker, ch, hint);
+    }
+
+
+    /*!
+     * @brief Second stage of "lfMap(PatTracker &, ch)" using "hint" given by "prepareLfMap(tracker, hint)".
+     */
+    bool lfMap
+    (
+     PatTracker & tracker, //!< Valid PatTracker.
+     const CharT ch,
+     const LfMapHint & hint //!< Hint computed for current "tracker".
      ) const noexcept {
       // {//debug
       //   std::cerr << __func__ << ": ch = " << ch << ", tracker = {" << std::get<0>(tracker) << ", " << std::get<1>(tracker) << ", " << std::get<2>(tracker) << "}" << std::endl;
@@ -374,15 +533,15 @@ namespace itmmti
         return false;
       }
 
-      uint64_t l_in_drle = std::get<0>(tracker) - (std::get<0>(tracker) > emPos_); // Taking (implicit) end-marker into account.
-      const uint64_t idxM = drle_.searchPosM(l_in_drle); // l_in_drle is modified to relative pos.
+      uint64_t l_in_drle = hint.relPos;
+      const uint64_t idxM = hint.idxM;
       //// In order to get idxS, replicate variant of rank function,
       //// where pos is specified by 'idxM' and 'relativePos' with several modifications.
-      const auto chNow = drle_.getCharFromIdxM(idxM);
+      const auto chNow = drle_.getCharFromIdxS(hint.idxS);
       uint64_t idxS;
       {
         if (ch == chNow) {
-          idxS = drle_.idxM2S(idxM);
+          idxS = hint.idxS;
         } else {
           l_in_drle = 0;
           idxS = drle_.calcPredIdxSFromIdxM(retRootS, ch, idxM); // We know that "ch" already exists by "r_in_dre > 1".
@@ -457,6 +616,18 @@ namespace itmmti
     }
 
 
+    /*!
+     * @brief Build move table of current RLBWT, which gives constant-time LF steps for inversion and backward search.
+     * @note Later updates of this object are not reflected to the table.
+     */
+    MoveTable<CharT> buildMoveTable
+    (
+     const uint64_t maxFanout = MoveTable<CharT>::kDefaultMaxFanout //!< Max fan-out of rows (0 for no splitting).
+     ) const {
+      return MoveTable<CharT>(drle_, emPos_, em_, maxFanout);
+    }
+
+
     /*!
      * @brief Output original text to std::ofstream.
      */
@@ -505,6 +676,219 @@ namespace itmmti
     }
 
 
+    //////////////////////////////// serialization
+    static constexpr uint64_t kSerialMagic{UINT64_C(0x7865646e6952)}; //!< "Rindex"
+    static constexpr uint64_t kSerialVersion{1};
+
+
+    /*!
+     * @brief Write r-index in binary.
+     */
+    void serialize
+    (
+     std::ostream & os
+     ) const {
+      assert(isReady() && !isSuccCompact());
+
+      serialutil::writeHeader(os, kSerialMagic, kSerialVersion);
+      serialutil::writeVal(os, em_);
+      serialutil::writeVal(os, emPos_);
+      serialutil::writeVal(os, prevSamplePos_);
+      serialutil::writeVal(os, nextSamplePos_);
+      serialutil::writeVal(os, lastSamplePos_);
+      drle_.serialize(os);
+      succ_.serialize(os);
+    }
+
+
+    /*!
+     * @brief Load r-index written by serialize (previous data is cleared).
+     * @return false if the format does not match.
+     */
+    bool load
+    (
+     std::istream & is
+     ) {
+      clearAll();
+      if (!serialutil::readHeader(is, kSerialMagic, kSerialVersion) ||
+          !serialutil::readVal(is, em_) ||
+          !serialutil::readVal(is, emPos_) ||
+          !serialutil::readVal(is, prevSamplePos_) ||
+          !serialutil::readVal(is, nextSamplePos_) ||
+          !serialutil::readVal(is, lastSamplePos_)) {
+        return false;
+      }
+      return drle_.load(is) && succ_.load(is);
+    }
+
+
+    /*!
+     * @brief Load r-index from file (mapped by mmap) written by serialize.
+     * @return false if failed.
+     */
+    bool load
+    (
+     const std::string & filename
+     ) {
+      serialutil::MappedFile mf;
+      if (!mf.open(filename)) {
+        return false;
+      }
+      serialutil::MemStreamBuf buf(mf.data(), mf.size());
+      std::istream is(&buf);
+      return load(is);
+    }
+
+
+    /*!
+     * @brief Reserve space for about "numRuns" runs (see DynRleForRlbwt::reserve).
+     * @note If "txtLen" > 0, samples are widened once for text positions up to "txtLen" instead of bit by bit in "extend".
+     */
+    void reserve
+    (
+     const uint64_t numRuns,
+     const uint64_t txtLen = 0
+     ) {
+      drle_.reserve(numRuns);
+      if (txtLen && drle_.getSampleUb()) {
+        drle_.increaseSampleUb(txtLen + 1);
+      }
+    }
+
+
+    /*!
+     * @brief Build read-only snapshot of M-tree of RLBWT to speed up queries (see DynRleForRlbwt::buildFlatIndexM).
+     * @note It is automatically ignored after next "extend", and "clearFlatIndex" releases it.
+     */
+    void buildFlatIndex() {
+      drle_.buildFlatIndexM();
+    }
+
+
+    void clearFlatIndex() {
+      drle_.clearFlatIndexM();
+    }
+
+
+    /*!
+     * @brief Replace successor data structure by compact static one (see ::StaticSuccForRindex) for query phases.
+     * @note
+     *   If "rate" > 0, entry of key "q" is dropped if its value is recovered by at most "rate" LF steps
+     *   from the row next to "q" and "q" is within "rate" from the previous key kept.
+     *   Then "calcNextPos(txtPos, bwtPos)" takes at most 2 * "rate" LF steps, which trades locate latency against space.
+     *   The dynamic successor data structure is released, and thus "extend" and "serialize" are no longer available.
+     */
+    void compactSucc
+    (
+     const uint64_t rate = 0 //!< Max num of LF steps to recover dropped entries (0: no entry is dropped).
+     ) {
+      assert(isReady() && !isSuccCompact());
+
+      //// Collect (key, val) of runs whose sample is recovered by LF steps.
+      std::vector<std::pair<uint64_t, uint64_t>> droppable;
+      if (rate && drle_.getSumOfWeight()) {
+        uint64_t pos = 0; // Beginning position of run in drle_.
+        for (uint64_t idxM = drle_.searchPosM(pos); idxM != BTreeNodeT::NOTFOUND; idxM = drle_.getNextIdxM(idxM)) {
+          const uint64_t bwtPos = pos + (pos >= emPos_);
+          if (pos && (bwtPos + 2 < emPos_ || bwtPos > emPos_ + 2)) { // Rows adjacent to end marker are not dropped.
+            uint64_t val;
+            if (calcTxtPosByLf(bwtPos, rate, val)) {
+              droppable.push_back({getSample(idxM), val});
+            }
+          }
+          pos += drle_.getWeightFromIdxM(idxM);
+        }
+        std::sort(droppable.begin(), droppable.end());
+      }
+
+      std::vector<uint64_t> keys, vals;
+      uint64_t valUb = drle_.getSampleUb();
+      uint64_t bound = rate - 1; // Keys up to "bound" can be dropped.
+      auto it = droppable.begin();
+      succ_.forEachKeyVal([&](const uint64_t key, const uint64_t val) {
+          while (it != droppable.end() && it->first < key) {
+            ++it;
+          }
+          if (rate && key <= bound && it != droppable.end() && it->first == key && it->second == val) {
+            return;
+          }
+          keys.push_back(key);
+          vals.push_back(val);
+          valUb = std::max(valUb, val + 1);
+          bound = key + rate;
+        });
+      std::vector<std::pair<uint64_t, uint64_t>>().swap(droppable);
+      phi_.build(keys, vals, valUb);
+      phiRate_ = rate;
+      succ_.clearAll();
+    }
+
+
+    bool isSuccCompact() const noexcept {
+      return !phi_.empty();
+    }
+
+
+    uint64_t getSuccRate() const noexcept {
+      return phiRate_;
+    }
+
+
+  private:
+    /*!
+     * @brief Get text-position of "BWT[bwtPos]" if it is known without LF steps,
+     *        i.e., "bwtPos" is (adjacent to) end marker or the last row of a run.
+     */
+    bool getKnownTxtPos
+    (
+     const uint64_t bwtPos,
+     uint64_t & txtPos //!< [out]
+     ) const noexcept {
+      if (bwtPos == emPos_) {
+        txtPos = getLenWithoutEndmarker();
+        return true;
+      } else if (bwtPos + 1 == emPos_) {
+        txtPos = prevSamplePos_;
+        return true;
+      } else if (bwtPos == emPos_ + 1) {
+        txtPos = nextSamplePos_;
+        return true;
+      }
+      uint64_t pos = bwtPos - (bwtPos > emPos_);
+      const uint64_t idxM = drle_.searchPosM(pos);
+      if (pos + 1 < drle_.getWeightFromIdxM(idxM)) {
+        return false;
+      }
+      const uint64_t nextIdxM = drle_.getNextIdxM(idxM);
+      txtPos = (nextIdxM != BTreeNodeT::NOTFOUND) ? drle_.getSampleFromIdxM(nextIdxM) : lastSamplePos_;
+      return true;
+    }
+
+
+    /*!
+     * @brief Compute text-position of "BWT[bwtPos]" by at most "maxSteps" LF steps to a row whose text-position is known.
+     * @return false if not found within "maxSteps" steps.
+     */
+    bool calcTxtPosByLf
+    (
+     uint64_t bwtPos,
+     const uint64_t maxSteps,
+     uint64_t & txtPos //!< [out]
+     ) const noexcept {
+      for (uint64_t k = 0; k <= maxSteps; ++k) {
+        if (getKnownTxtPos(bwtPos, txtPos)) {
+          txtPos -= k;
+          return true;
+        }
+        bwtPos = lfMap(bwtPos);
+      }
+      return false;
+    }
+
+
+  public:
+
+
     //////////////////////////////// statistics
     /*!
      * @brief Calculate total memory usage in bytes.
@@ -516,10 +900,22 @@ namespace itmmti
       size_t size = sizeof(*this) * includeThis;
       size += drle_.calcMemBytes(false);
       size += succ_.calcMemBytes(false);
+      size += phi_.calcMemBytes(false);
       return size;
     }
 
 
+    /*!
+     * @brief calcMemBytes plus bytes reserved by ::NodeArena but not in use (see DynRleForRlbwt::calcMemBytesReserved).
+     */
+    size_t calcMemBytesReserved
+    (
+     bool includeThis = true
+     ) const noexcept {
+      return calcMemBytes(includeThis) + NodeArena::getInstance().calcMemBytesOverhead();
+    }
+
+
     /*!
      * @brief Print statistics of ::DynRLE (not of ::OnlineRLBWT).
      */
@@ -532,12 +928,24 @@ namespace itmmti
       os << "emPos_ = " << emPos_ << ", em_ = " << em_
          << ", prevSamplePos_ = " << prevSamplePos_ << ", nextSamplePos_ = " << nextSamplePos_ << std::endl;
       if (isReady()) {
-        const size_t totalBytes = drle_.calcMemBytes(true) + succ_.calcMemBytes(true);
+        const size_t totalBytes = drle_.calcMemBytes(true) + succ_.calcMemBytes(true) + phi_.calcMemBytes(true);
         os << "Total: " << totalBytes << " bytes = "
            << (double)(totalBytes) / 1024 << " KiB = "
            << ((double)(totalBytes) / 1024) / 1024 << " MiB" << std::endl;
+        if (NodeArena::getInstance().isEnabled()) {
+          const size_t reservedBytes = totalBytes + NodeArena::getInstance().calcMemBytesOverhead();
+          os << "Total reserved (with NodeArena overhead): " << reservedBytes << " bytes = "
+             << (double)(reservedBytes) / 1024 << " KiB = "
+             << ((double)(reservedBytes) / 1024) / 1024 << " MiB" << std::endl;
+        }
         drle_.printStatistics(os, verbose);
-        succ_.printStatistics(os, verbose);
+        if (isSuccCompact()) {
+          os << "Compact successor: " << phi_.getNumKeys() << " keys of " << drle_.calcNumRuns() << " runs, "
+             << static_cast<uint64_t>(phi_.getValWidth()) << " bits/value, rate = " << phiRate_ << ", "
+             << phi_.calcMemBytes(true) << " bytes" << std::endl;
+        } else {
+          succ_.printStatistics(os, verbose);
+        }
       } else {
         os << "Data structure is empty (not ready)." << std::endl;
       }
@@ -552,7 +960,9 @@ namespace itmmti
       os << "emPos_ = " << emPos_ << ", em_ = " << em_ << ", prevSamplePos_ = " << prevSamplePos_
          << ", nextSamplePos_ = " << nextSamplePos_ << ", lastSamplePos_ = " << lastSamplePos_ << std::endl;
       // drle_.printDebugInfo(os);
-      succ_.printDebugInfo(os);
+      if (!isSuccCompact()) {
+        succ_.printDebugInfo(os);
+      }
 
       //// Check correctness of sampled position links.
       const auto len = getLenWithoutEndmarker();
@@ -586,7 +996,7 @@ namespace itmmti
             }
           }
         }
-        txtPos = calcNextPos(txtPos);
+        txtPos = calcNextPos(txtPos, bwtPos);
       }
     }
 
@@ -17,11 +17,13 @@
 #include <fstream>
 #include <iomanip>
 #include <chrono>
+#include <string>
 
 #include "cmdline.h"
 #include "OnlineRindex.hpp"
 #include "DynRleForRlbwt.hpp"
 #include "DynSuccForRindex.hpp"
+#include "RlbwtConfigs.hpp"
 
 
 using namespace itmmti;
@@ -33,20 +35,12 @@ void searchOnRindex(const RindexT & rindex, std::string message)
   //// Pattern search Demo
   const uint64_t lenWithoutEm = rindex.getLenWithEndmarker() - 1;
   while (true) {
-    constexpr static uint64_t bufsize = 512;
-    char buffer[bufsize] = "";
+    std::string buffer; // Whole line, so that long patterns are not truncated.
     std::cout << message << std::endl;
-    if (std::fgets(buffer, bufsize, stdin) == NULL || buffer[0] == '\n') {
+    if (!std::getline(std::cin, buffer) || buffer.empty()) {
       break;
     }
-    uint64_t len = std::strlen(buffer);
-    if (len > 0) {
-      if (buffer[len - 1] == '\n') {
-        buffer[--len] = '\0';
-      } else {
-        while (getchar() != '\n') {};
-      }
-    }
+    const uint64_t len = buffer.size();
     std::cout << "\"" << buffer << "\"" << std::endl;
 
     //// Counting...
@@ -54,8 +48,8 @@ void searchOnRindex(const RindexT & rindex, std::string message)
     auto tracker = rindex.getInitialPatTracker();
     bool match = true;
     uint64_t plen = 0;
-    for (unsigned char c = buffer[plen]; c != '\0'; c = buffer[++plen]) {
-      match = rindex.lfMap(tracker, c);
+    for (; plen < len; ++plen) {
+      match = rindex.lfMap(tracker, static_cast<unsigned char>(buffer[plen]));
       if (!match) break;
     }
     auto t2 = std::chrono::high_resolution_clock::now();
@@ -110,8 +104,11 @@ void searchOnRindex(const RindexT & rindex, std::string message)
 int main(int argc, char *argv[])
 {
   cmdline::parser parser;
-  parser.add<std::string>("input", 'i', "input file name", true);
+  parser.add<std::string>("input", 'i', "input file name", false, "");
+  parser.add<std::string>("save", 0, "file name to save the constructed index", false, "");
+  parser.add<std::string>("load", 0, "file name of saved index to load instead of construction", false, "");
   parser.add<size_t>("step", 's', "number of characters to index in a single step", false, 1000000);
+  parser.add<std::string>("config", 0, "template configuration (e.g., b16m32s8u16) or auto (chosen by profiling input)", false, "b16m32s8u16");
   parser.add<bool>("verbose", 'v', "verbose", false, 0);
   parser.add("help", 0, "print help");
 
@@ -119,61 +116,79 @@ int main(int argc, char *argv[])
   const std::string in = parser.get<std::string>("input");
   const bool verbose = parser.get<bool>("verbose");
   const size_t step = parser.get<size_t>("step");
+  const std::string saveFile = parser.get<std::string>("save");
+  const std::string loadFile = parser.get<std::string>("load");
+  const std::string config = parser.get<std::string>("config");
+
+  if (in.empty() && loadFile.empty()) {
+    std::cerr << "Error: input or load file must be given." << std::endl;
+    std::cerr << parser.usage();
+    return 1;
+  }
+
+  return runWithRlbwtConfig(config, in, [&](auto cfg) {
+    using RindexT = typename decltype(cfg)::RindexT; // See RlbwtConfigs.hpp for configurations.
+    RindexT rindex(1);
+    SizeT pos = 0; // Current txt-pos (0base)
+
+    if (!loadFile.empty()) {
+      std::cout << "R-index loading..." << std::endl;
+      if (!rindex.load(loadFile)) {
+        std::cerr << "Error: failed to load " << loadFile << std::endl;
+        return 1;
+      }
+      pos = rindex.getLenWithoutEndmarker();
+    } else {
+      std::cout << "R-index constructing..." << std::endl;
+
+      std::ifstream ifs(in);
+
+      size_t last_step = 0;
+      char c; // Assume that the input character fits in char.
+      unsigned char uc;
+
+      while (ifs.peek() != std::ios::traits_type::eof()) {
+        ifs.get(c);
+        uc = static_cast<unsigned char>(c);
+
+        if (pos > last_step + (step - 1)) {
+          if (verbose) {
+            rindex.printStatistics(std::cout, false);
+          }
+          last_step = pos;
+          const size_t totalBytes = rindex.calcMemBytes(true);
+          std::cout << " " << pos << " characters indexed in "
+                    << totalBytes << " bytes = "
+                    << (double)(totalBytes) / 1024 << " KiB = "
+                    << ((double)(totalBytes) / 1024) / 1024 << " MiB." << std::endl;
+          searchOnRindex(rindex, "Type a pattern to search. Or enter empty string to continue indexing.");
+          std::cout << "Quitted searching phase and continue indexing next " << step << " characters..." << std::endl;
+        }
 
-  std::cout << "R-index constructing..." << std::endl;
-
-  std::ifstream ifs(in);
-
-  size_t last_step = 0;
-
-  using BTreeNodeT = BTreeNode<16>; // BTree arity = {16, 32, 64, 128}
-  using BtmNodeMT = BtmNodeM_StepCode<BTreeNodeT, 32>; // BtmNode arity in {16, 32, 64, 128}.
-  using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>; // Each block has 512 btmNodeM.
-  using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, 8>; // CharT = uint32_t. BtmNode arity = {4, 8, 16, 32, 64, 128}.
-  using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>; // Each block has 1024 btmNodeS.
-  using DynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_WBitsBlockVec<1024>, BtmMInfoT, BtmSInfoT>;
-  using BtmNodeInSucc = BtmNodeForPSumWithVal<16>; // BtmNode arity = {16, 32, 64, 128}.
-  using DynSuccT = DynSuccForRindex<BTreeNodeT, BtmNodeInSucc>;
-  using RindexT = OnlineRlbwtIndex<DynRleT, DynSuccT>;
-  RindexT rindex(1);
-  SizeT pos = 0; // Current txt-pos (0base)
-  char c; // Assume that the input character fits in char.
-  unsigned char uc;
-
-  while (ifs.peek() != std::ios::traits_type::eof()) {
-    ifs.get(c);
-    uc = static_cast<unsigned char>(c);
-
-    if (pos > last_step + (step - 1)) {
-      if (verbose) {
-        rindex.printStatistics(std::cout, false);
+        rindex.extend(uc);
+        ++pos;
       }
-      last_step = pos;
-      const size_t totalBytes = rindex.calcMemBytes(true);
-      std::cout << " " << pos << " characters indexed in "
-                << totalBytes << " bytes = "
-                << (double)(totalBytes) / 1024 << " KiB = "
-                << ((double)(totalBytes) / 1024) / 1024 << " MiB." << std::endl;
-      searchOnRindex(rindex, "Type a pattern to search. Or enter empty string to continue indexing.");
-      std::cout << "Quitted searching phase and continue indexing next " << step << " characters..." << std::endl;
+
+      ifs.close();
     }
 
-    rindex.extend(uc);
-    ++pos;
-  }
+    if (!saveFile.empty()) {
+      std::ofstream ofs(saveFile, std::ios::out | std::ios::binary);
+      rindex.serialize(ofs);
+      std::cout << "R-index saved to " << saveFile << std::endl;
+    }
 
-  ifs.close();
-
-  const size_t totalBytes = rindex.calcMemBytes(true);
-  std::cout << " " << pos << " characters indexed in "
-            << totalBytes << " bytes = "
-            << (double)(totalBytes) / 1024 << " KiB = "
-            << ((double)(totalBytes) / 1024) / 1024 << " MiB." << std::endl;
-  searchOnRindex(rindex, "Type a pattern to search. Or enter empty string to quit.");
-  std::cout << "Quitted." << std::endl;
-  if (verbose) {
-    rindex.printStatistics(std::cout, false);
-  }
+    const size_t totalBytes = rindex.calcMemBytes(true);
+    std::cout << " " << pos << " characters indexed in "
+              << totalBytes << " bytes = "
+              << (double)(totalBytes) / 1024 << " KiB = "
+              << ((double)(totalBytes) / 1024) / 1024 << " MiB." << std::endl;
+    searchOnRindex(rindex, "Type a pattern to search. Or enter empty string to quit.");
+    std::cout << "Quitted." << std::endl;
+    if (verbose) {
+      rindex.printStatistics(std::cout, false);
+    }
 
-  return 0;
+    return 0;
+  }, "b16m32s8u16");
 }
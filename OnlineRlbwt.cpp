@@ -20,6 +20,7 @@
 #include "cmdline.h"
 #include "OnlineRlbwt.hpp"
 #include "DynRleForRlbwt.hpp"
+#include "RlbwtConfigs.hpp"
 
 
 using namespace itmmti;
@@ -30,6 +31,13 @@ int main(int argc, char *argv[])
   parser.add<std::string>("input",'i', "input file name", true);
   parser.add<std::string>("output",'o', "output file name", false);
   parser.add<bool>("check", 0, "check correctness", false, 0);
+  parser.add<bool>("freeze", 0, "decompress via static snapshot of RLBWT (made by freeze())", false, 0);
+  parser.add<bool>("move", 0, "decompress and check via move table of RLBWT", false, 0);
+  parser.add<uint64_t>("fanout", 0, "max fan-out of rows of move table (0 for no splitting)", false, 4);
+  parser.add<bool>("arena", 0, "allocate blocks of bottom nodes from node arena", false, 0);
+  parser.add<bool>("hugepages", 0, "back node arena by huge pages (implies --arena)", false, 0);
+  parser.add<std::string>("config", 0, "template configuration (e.g., b32m32s8) or auto (chosen by profiling input)", false, "b32m32s8");
+  parser.add<std::string>("expected_runs", 0, "num of runs to reserve space for (0 for none) or auto (estimated by profiling input)", false, "0");
   parser.add<bool>("verbose", 'v', "verbose", false, 0);
   parser.add("help", 0, "print help");
 
@@ -37,71 +45,108 @@ int main(int argc, char *argv[])
   const std::string in = parser.get<std::string>("input");
   const std::string out = parser.get<std::string>("output");
   const bool check = parser.get<bool>("check");
+  const bool freeze = parser.get<bool>("freeze");
+  const bool move = parser.get<bool>("move");
+  const uint64_t fanout = parser.get<uint64_t>("fanout");
+  const bool hugePages = parser.get<bool>("hugepages");
+  const bool arena = parser.get<bool>("arena") || hugePages;
   const bool verbose = parser.get<bool>("verbose");
+  const std::string config = parser.get<std::string>("config");
+  uint64_t expectedRuns = 0;
+  uint64_t inputLen = 0;
+  if (!getExpectedRuns(parser.get<std::string>("expected_runs"), in, expectedRuns, inputLen)) {
+    return 1;
+  }
 
-  auto t1 = std::chrono::high_resolution_clock::now();
-  std::cout << "Building RLBWT ..." << std::endl;
-
-	std::ifstream ifs(in);
-
-  size_t j = 0;
-  const size_t step = 1000000; // print status every step characters
-  size_t last_step = 0;
-
-  using BTreeNodeT = BTreeNode<32>;
-  using BtmNodeMT = BtmNodeM_StepCode<BTreeNodeT, 32>;
-  using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>;
-  using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, 8>;
-  using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>;
-  using DynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_Null, BtmMInfoT, BtmSInfoT>;
-  OnlineRlbwt<DynRleT> rlbwt(1);
-
-  char c; // Assume that the input character fits in char.
-  unsigned char uc;
-
-  while (ifs.peek() != std::ios::traits_type::eof()) {
-    ifs.get(c);
-    uc = static_cast<unsigned char>(c);
-    if (verbose) {
-      if(j > last_step + (step - 1)){
-        last_step = j;
-        std::cout << " " << j << " characters processed ..." << std::endl;
-      }
+  if (arena) {
+    NodeArena::getInstance().enable(hugePages);
+  }
+
+  return runWithRlbwtConfig(config, in, [&](auto cfg) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::cout << "Building RLBWT ..." << std::endl;
+
+    std::ifstream ifs(in);
+
+    size_t j = 0;
+    const size_t step = 1000000; // print status every step characters
+    size_t last_step = 0;
+
+    using DynRleT = typename decltype(cfg)::DynRleT;
+    OnlineRlbwt<DynRleT> rlbwt(1);
+    if (expectedRuns) {
+      rlbwt.reserve(expectedRuns);
     }
 
-    rlbwt.extend(uint8_t(uc));
-    ++j;
-  }
+    char c; // Assume that the input character fits in char.
+    unsigned char uc;
+
+    while (ifs.peek() != std::ios::traits_type::eof()) {
+      ifs.get(c);
+      uc = static_cast<unsigned char>(c);
+      if (verbose) {
+        if(j > last_step + (step - 1)){
+          last_step = j;
+          std::cout << " " << j << " characters processed ..." << std::endl;
+        }
+      }
 
-  ifs.close();
-  {
-    auto t2 = std::chrono::high_resolution_clock::now();
-    double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
-    std::cout << "RLBWT construction done. " << sec << " sec" << std::endl;
-  }
+      rlbwt.extend(uint8_t(uc));
+      ++j;
+    }
 
-  rlbwt.printStatistics(std::cout, false);
+    ifs.close();
+    {
+      auto t2 = std::chrono::high_resolution_clock::now();
+      double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
+      std::cout << "RLBWT construction done. " << sec << " sec" << std::endl;
+    }
 
-  if (!(out.empty())) {
-    t1 = std::chrono::high_resolution_clock::now();
-    std::cout << "Decompressing RLBWT ..." << std::endl;
-    std::ofstream ofs(out, std::ios::out);
-    rlbwt.invert(ofs);
-    auto t2 = std::chrono::high_resolution_clock::now();
-    double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
-    std::cout << "RLBWT decompression done. " << sec << " sec" << std::endl;
-  }
+    rlbwt.printStatistics(std::cout, false);
+    if (!move && !freeze && (!out.empty() || check)) { // Only queries follow.
+      rlbwt.buildFlatIndex();
+    }
 
-  if (check) { // check correctness
-    t1 = std::chrono::high_resolution_clock::now();
-    std::cout << "Checking RLBWT inversion ..." << std::endl;
-    std::ifstream ifssss(in);
-    if (rlbwt.checkDecompress(ifssss)) {
+    MoveTable<typename OnlineRlbwt<DynRleT>::CharT> mtable;
+    if (move && (!out.empty() || check)) {
+      t1 = std::chrono::high_resolution_clock::now();
+      mtable = rlbwt.buildMoveTable(fanout);
       auto t2 = std::chrono::high_resolution_clock::now();
       double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
-      std::cout << "RLBWT decompressed correctly. " << sec << " sec" << std::endl;
-    } else {
-      std::cout << "RLBWT inversion failed." << std::endl;
+      std::cout << "Move table construction done. " << sec << " sec" << std::endl;
+      mtable.printStatistics(std::cout, false);
     }
-  }
+
+    if (!(out.empty())) {
+      t1 = std::chrono::high_resolution_clock::now();
+      std::cout << "Decompressing RLBWT ..." << std::endl;
+      std::ofstream ofs(out, std::ios::out);
+      if (move) {
+        mtable.invert(ofs);
+      } else if (freeze) {
+        const auto srlbwt = rlbwt.freeze();
+        srlbwt.printStatistics(std::cout, false);
+        srlbwt.invert(ofs);
+      } else {
+        rlbwt.invert(ofs);
+      }
+      auto t2 = std::chrono::high_resolution_clock::now();
+      double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
+      std::cout << "RLBWT decompression done. " << sec << " sec" << std::endl;
+    }
+
+    if (check) { // check correctness
+      t1 = std::chrono::high_resolution_clock::now();
+      std::cout << "Checking RLBWT inversion ..." << std::endl;
+      std::ifstream ifssss(in);
+      if ((move) ? mtable.checkDecompress(ifssss) : rlbwt.checkDecompress(ifssss)) {
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
+        std::cout << "RLBWT decompressed correctly. " << sec << " sec" << std::endl;
+      } else {
+        std::cout << "RLBWT inversion failed." << std::endl;
+      }
+    }
+    return 0;
+  });
 }
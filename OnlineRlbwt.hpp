@@ -18,6 +18,16 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
+
+#include "BwtWriter.hpp"
+#include "SerialUtil.hpp"
+#include "NodeArena.hpp"
+#include "StaticRleForRlbwt.hpp"
+#include "MoveTable.hpp"
+#include "BuildStats.hpp"
+#include "DocArray.hpp"
 
 namespace itmmti
 {
@@ -40,12 +50,27 @@ namespace itmmti
         static constexpr uint8_t kBtmBM{DynRle::kBtmBM};
         static constexpr uint8_t kBtmBS{DynRle::kBtmBS};
 
+        /*!
+         * @brief Progress of batched construction reported by OnlineRlbwt::appendCollection.
+         */
+        struct AppendStats
+        {
+            uint64_t numSeqs;  //!< Num of separator-terminated sequences appended so far.
+            uint64_t numChars; //!< Num of characters appended so far.
+            uint64_t numRuns;  //!< Num of runs in current RLBWT.
+            double elapsedSec; //!< Elapsed time (in seconds) since appendCollection started.
+        };
+
     private:
         DynRle drle_;
         uint64_t emPos_;       //!< Current position (0base) of end marker.
         CharT em_;             //!< End marker. It is used only when bwt[emPos_] is accessed (and does not matter if em_ appears in the input text).
         uint64_t num_em_;      // the number of em_
         uint64_t sap_s, sap_e; // cur sap interval [sap_s,sap_e]
+        HotCountersT counters_; //!< Counters of sptExtend (empty unless ONLINE_RLBWT_COUNTERS is defined).
+        bool trackDocs_;                //!< If true, sptExtend records fingerprints of sequences (see enableDocTracking).
+        DocFingerprint curFp_;          //!< Fingerprint of current (unterminated) sequence.
+        std::vector<uint64_t> docFps_;  //!< docFps_[d] is fingerprint of d-th sequence terminated after tracking is enabled.
 
     public:
         OnlineRlbwt(
@@ -53,7 +78,8 @@ namespace itmmti
             CharT em = 1              //!< End marker (default UINT64_MAX).
             ) : drle_(initNumBtms, 0),
                 emPos_(0),
-                em_(em)
+                em_(em),
+                trackDocs_(false)
         {
             num_em_ = 1;
             sap_s = 0;
@@ -99,51 +125,155 @@ namespace itmmti
             const CharT ch // !< Character to append.
         )
         {
-            // std::cout << "(sap_s: " << sap_s << " - sap_e: " << sap_e << ")" << std::endl;
-            // 插入当前元素
-            if (sap_s == sap_e) // 代表没有后缀与目标后缀完全相同,只有一个地方可以插入
+            // 插入当前元素, 同时计算下一个有趣区间
+            counters_.inc(HotCounter::kSptExtend);
+            drle_.extendAndAdvance(sap_s, sap_e, ch);
+            if (trackDocs_)
             {
-                uint64_t tmp_sap_s = sap_s;
-                drle_.insertRun(tmp_sap_s, ch);
-            }
-            else
-            {
-                // 计算有趣区间内是否有插入的符号
-                uint64_t s_n = (sap_s == 0 ? 0 : drle_.rank(ch, sap_s - 1, false));
-                uint64_t e_n = drle_.rank(ch, sap_e, false);
-                // std::cout << "(s_n: " << s_n << " - e_n: " << e_n << ")" << std::endl;
-                if (e_n - s_n > 0) // 有趣区间内已经存在插入的那个符号
+                if (ch == em_)
                 {
-                    auto pos = drle_.select(ch, s_n + 1);
-                    drle_.insertRun(pos, ch);
+                    docFps_.push_back(curFp_.get());
+                    curFp_.reset();
                 }
-                else // 有趣区间内不存在插入的那个符号
+                else
                 {
-                    // 插入原则是不从中打断别的run
-                    drle_.optInsert(sap_s, sap_e, ch);
+                    curFp_.put(ch);
                 }
             }
-            // 计算下一个有趣区间
             if (ch == em_)
             {
+                counters_.inc(HotCounter::kSptSeparator);
                 num_em_ += 1;
                 sap_s = 0;
                 sap_e = num_em_ - 1;
             }
-            else
+        }
+
+        /*!
+         * @brief Get num of separator-terminated sequences appended so far.
+         */
+        uint64_t getNumSeqs() const noexcept
+        {
+            return num_em_ - 1;
+        }
+
+        /*!
+         * @brief Start recording ::DocFingerprint of each sequence appended by sptExtend, from which ::DocArray is built.
+         * @note It should be called before appending sequences, as sequences appended before are not tracked.
+         */
+        void enableDocTracking()
+        {
+            trackDocs_ = true;
+        }
+
+        /*!
+         * @brief Return true if fingerprints of all sequences are recorded (i.e., tracking was enabled from the beginning).
+         */
+        bool isDocTrackingComplete() const noexcept
+        {
+            return trackDocs_ && docFps_.size() == getNumSeqs();
+        }
+
+        /*!
+         * @brief Get fingerprints of sequences in the order they were appended.
+         */
+        const std::vector<uint64_t> &getDocFingerprints() const noexcept
+        {
+            return docFps_;
+        }
+
+        /*!
+         * @brief Append characters of "str" by sptExtend.
+         * @return Num of separators (em_) in "str".
+         */
+        uint64_t appendString(
+            const uint8_t *str, //!< Sequence, which is usually terminated by separator (em_).
+            const size_t len    //!< Length of "str".
+        )
+        {
+            uint64_t numSeps = 0;
+            for (size_t i = 0; i < len; ++i)
             {
-                if (sap_s == sap_e)
-                {
-                    auto tmp = drle_.rank(ch, sap_s, true);
-                    sap_s = tmp;
-                    sap_e = tmp;
-                }
-                else
+                const CharT ch = str[i];
+                sptExtend(ch);
+                numSeps += (ch == em_);
+            }
+            return numSeps;
+        }
+
+        /*!
+         * @brief Append collection of separator-terminated sequences by sptExtend.
+         * @return Statistics at the end.
+         * @note "callback" is called with AppendStats every "reportInterval" sequences and once at the end.
+         *       num of runs is computed only when reporting.
+         */
+        template <class Callback>
+        AppendStats appendCollection(
+            const uint8_t *text,          //!< Concatenation of separator-terminated sequences.
+            const size_t len,             //!< Length of "text".
+            Callback &&callback,          //!< Function called as "callback(const AppendStats &)".
+            const uint64_t reportInterval //!< Report interval in num of sequences (0 means reporting only at the end).
+        )
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const uint8_t sep = static_cast<uint8_t>(em_);
+            AppendStats stats{0, 0, 0, 0.0};
+            auto report = [&]()
+            {
+                stats.numRuns = drle_.calcNumRuns();
+                stats.elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                callback(static_cast<const AppendStats &>(stats));
+            };
+
+            const uint8_t *const textEnd = text + len;
+            for (const uint8_t *beg = text; beg < textEnd;)
+            {
+                const uint8_t *end = std::find(beg, textEnd, sep);
+                end += (end < textEnd); // include separator
+                stats.numSeqs += appendString(beg, static_cast<size_t>(end - beg));
+                stats.numChars += static_cast<uint64_t>(end - beg);
+                beg = end;
+                if (reportInterval && beg < textEnd && stats.numSeqs % reportInterval == 0)
                 {
-                    sap_s = drle_.rank(ch, sap_s - 1, true) + 1;
-                    sap_e = drle_.rank(ch, sap_e, true);
+                    report();
                 }
             }
+            report();
+            return stats;
+        }
+
+        /*!
+         * @brief Variant of appendCollection without callback.
+         */
+        AppendStats appendCollection(
+            const uint8_t *text, //!< Concatenation of separator-terminated sequences.
+            const size_t len     //!< Length of "text".
+        )
+        {
+            return appendCollection(text, len, [](const AppendStats &) {}, 0);
+        }
+
+        /*!
+         * @brief Build RLBWT of collection from runs in ["beg", "end") (e.g., BWT made by other tools) in time linear in num of runs,
+         *        so that sptExtend (appendString, appendCollection) can continue appending sequences to it.
+         * @note
+         *   Runs (pair-like of character and exponent) should be BWT of separator(em_)-terminated sequences as built by sptExtend.
+         *   Previous data is cleared.
+         */
+        template <class RunIterator>
+        void bulkLoadCollection(
+            RunIterator beg,
+            RunIterator end,
+            const uint64_t numRunsHint = 0 //!< Expected num of runs (0 if unknown).
+        )
+        {
+            drle_.bulkLoad(beg, end, numRunsHint);
+            docFps_.clear(); // Sequences loaded are not tracked.
+            curFp_.reset();
+            emPos_ = 0;
+            num_em_ = drle_.getSumOfWeight(em_) + 1;
+            sap_s = 0;
+            sap_e = num_em_ - 1;
         }
 
         /*!
@@ -235,6 +365,123 @@ namespace itmmti
             }
         }
 
+        /*!
+         * @brief Make static snapshot of current RLBWT for query-only use (e.g., after construction).
+         */
+        StaticRlbwt<CharT> freeze() const
+        {
+            return StaticRlbwt<CharT>(drle_.freeze(), emPos_, em_);
+        }
+
+        /*!
+         * @brief Build move table of current RLBWT, which gives constant-time LF steps for inversion and backward search.
+         */
+        MoveTable<CharT> buildMoveTable(
+            const uint64_t maxFanout = MoveTable<CharT>::kDefaultMaxFanout //!< Max fan-out of rows (0 for no splitting).
+        ) const
+        {
+            return MoveTable<CharT>(drle_, emPos_, em_, maxFanout);
+        }
+
+        //////////////////////////////// serialization
+        static constexpr uint64_t kSerialMagic{UINT64_C(0x7477626c52)}; //!< "Rlbwt"
+        static constexpr uint64_t kSerialVersion{2}; //!< 2: Fingerprints of sequences are added.
+
+        /*!
+         * @brief Write current RLBWT and states of sptExtend in binary.
+         */
+        void serialize(
+            std::ostream &os) const
+        {
+            serialutil::writeHeader(os, kSerialMagic, kSerialVersion);
+            serialutil::writeVal(os, em_);
+            serialutil::writeVal(os, emPos_);
+            serialutil::writeVal(os, num_em_);
+            serialutil::writeVal(os, sap_s);
+            serialutil::writeVal(os, sap_e);
+            serialutil::writeVal(os, static_cast<uint8_t>(trackDocs_));
+            serialutil::writeVal(os, curFp_);
+            serialutil::writeVal(os, static_cast<uint64_t>(docFps_.size()));
+            for (const auto fp : docFps_)
+            {
+                serialutil::writeVal(os, fp);
+            }
+            drle_.serialize(os);
+        }
+
+        /*!
+         * @brief Load data written by serialize (previous data is cleared).
+         * @return false if the format does not match.
+         */
+        bool load(
+            std::istream &is)
+        {
+            uint8_t trackDocs;
+            uint64_t numFps;
+            if (!serialutil::readHeader(is, kSerialMagic, kSerialVersion) ||
+                !serialutil::readVal(is, em_) ||
+                !serialutil::readVal(is, emPos_) ||
+                !serialutil::readVal(is, num_em_) ||
+                !serialutil::readVal(is, sap_s) ||
+                !serialutil::readVal(is, sap_e) ||
+                !serialutil::readVal(is, trackDocs) ||
+                !serialutil::readVal(is, curFp_) ||
+                !serialutil::readVal(is, numFps))
+            {
+                return false;
+            }
+            trackDocs_ = trackDocs;
+            docFps_.resize(numFps);
+            for (auto &fp : docFps_)
+            {
+                if (!serialutil::readVal(is, fp))
+                {
+                    return false;
+                }
+            }
+            return drle_.load(is);
+        }
+
+        /*!
+         * @brief Load data from file (mapped by mmap) written by serialize.
+         * @return false if failed.
+         */
+        bool load(
+            const std::string &filename)
+        {
+            serialutil::MappedFile mf;
+            if (!mf.open(filename))
+            {
+                return false;
+            }
+            serialutil::MemStreamBuf buf(mf.data(), mf.size());
+            std::istream is(&buf);
+            return load(is);
+        }
+
+        /*!
+         * @brief Reserve space for about "numRuns" runs (see DynRleForRlbwt::reserve).
+         */
+        void reserve(
+            const uint64_t numRuns)
+        {
+            drle_.reserve(numRuns);
+        }
+
+        /*!
+         * @brief Build read-only snapshot of M-tree to speed up queries (see DynRleForRlbwt::buildFlatIndexM).
+         * @note It is automatically ignored after next update, and "clearFlatIndex" releases it.
+         */
+        void buildFlatIndex()
+        {
+            drle_.buildFlatIndexM();
+        }
+
+        void clearFlatIndex()
+        {
+            drle_.clearFlatIndexM();
+        }
+
         //////////////////////////////// statistics
         /*!
          * @brief Calculate total memory usage in bytes.
@@ -244,9 +491,37 @@ namespace itmmti
         {
             size_t size = sizeof(*this) * includeThis;
             size += drle_.calcMemBytes();
+            size += docFps_.capacity() * sizeof(uint64_t);
             return size;
         }
 
+        /*!
+         * @brief calcMemBytes plus bytes reserved by ::NodeArena but not in use (see DynRleForRlbwt::calcMemBytesReserved).
+         */
+        size_t calcMemBytesReserved(
+            bool includeThis = true) const noexcept
+        {
+            return calcMemBytes(includeThis) + NodeArena::getInstance().calcMemBytesOverhead();
+        }
+
+        /*!
+         * @brief Get hot-path counters of OnlineRlbwt and its DynRle (all zero unless ONLINE_RLBWT_COUNTERS is defined).
+         */
+        HotCountersT getCounters() const noexcept
+        {
+            HotCountersT counters = counters_;
+            counters.add(drle_.getCounters());
+            return counters;
+        }
+
+        /*!
+         * @brief Calculate num of runs in current RLBWT.
+         */
+        size_t calcNumRuns() const noexcept
+        {
+            return drle_.calcNumRuns();
+        }
+
         /*!
          * @brief Print statistics
          */
@@ -280,7 +555,59 @@ namespace itmmti
 
         void writeBWT(std::ofstream &ofs)
         {
-            this->drle_.printString(ofs);
+            writeBWT(ofs, BwtFormat::kPlain);
+        }
+
+        /*!
+         * @brief Write current RLBWT in "format" (BwtFormat::kPlain or BwtFormat::kRlePair) with block writes.
+         */
+        void writeBWT(
+            std::ostream &os,       //!< Output stream.
+            const BwtFormat format //!< Output format.
+        ) const
+        {
+            assert(format != BwtFormat::kHeadsLengths); // Use writeBWTHeadsLengths.
+
+            BlockWriter writer(os);
+            if (format == BwtFormat::kRlePair)
+            {
+                drle_.forEachRun([&writer](const CharT ch, const uint64_t exponent)
+                                 {
+                                     writer.putByte(static_cast<uint8_t>(ch));
+                                     writer.putVarint(exponent); });
+            }
+            else
+            {
+                drle_.forEachRun([&writer](const CharT ch, const uint64_t exponent)
+                                 { writer.putRepeat(static_cast<uint8_t>(ch), exponent); });
+            }
+        }
+
+        /*!
+         * @brief Write run heads (one byte per run) and run lengths (little endian of "lenBytes" bytes per run) of current RLBWT.
+         * @return false (without writing anything) if some run length does not fit in "lenBytes" bytes.
+         * @note The default of 5 bytes follows ".bwt.heads"/".bwt.len" of Big-BWT used by r-index tools.
+         */
+        bool writeBWTHeadsLengths(
+            std::ostream &osHeads,   //!< Output stream for run heads.
+            std::ostream &osLens,    //!< Output stream for run lengths.
+            const uint8_t lenBytes = 5 //!< Bytes for each run length.
+        ) const
+        {
+            uint64_t maxExponent = 0;
+            drle_.forEachRun([&maxExponent](const CharT, const uint64_t exponent)
+                             { maxExponent = std::max(maxExponent, exponent); });
+            if (lenBytes < 8 && (maxExponent >> (8 * lenBytes)))
+            {
+                return false;
+            }
+            BlockWriter heads(osHeads);
+            BlockWriter lens(osLens);
+            drle_.forEachRun([&](const CharT ch, const uint64_t exponent)
+                             {
+                                 heads.putByte(static_cast<uint8_t>(ch));
+                                 lens.putLittleEndian(exponent, lenBytes); });
+            return true;
         }
 
         bool checkDecompress(
@@ -0,0 +1,297 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file RindexBatchQuery.hpp
+ * @brief Batched and multi-threaded counting/locating of patterns on r-index (e.g., ::OnlineRlbwtIndex).
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ */
+#ifndef INCLUDE_GUARD_RindexBatchQuery
+#define INCLUDE_GUARD_RindexBatchQuery
+
+#include <stdint.h>
+#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BwtWriter.hpp"
+#include "SerialUtil.hpp"
+
+namespace itmmti
+{
+    namespace rindexbatch
+    {
+        static constexpr uint64_t kResultMagic{UINT64_C(0x6863746162524f)}; //!< "ORbatch"
+        static constexpr uint64_t kResultVersion{1};
+
+        /*!
+         * @brief Results of batch queries.
+         * @note Occurrences of i-th pattern are "occs[occBeg[i]..occBeg[i + 1])" (beginning positions in increasing order).
+         */
+        struct BatchResult
+        {
+            std::vector<uint64_t> numOccs; //!< Num of occurrences of each pattern.
+            std::vector<uint64_t> occBeg;  //!< Offsets to "occs" (size is num of patterns + 1, or 0 when not located).
+            std::vector<uint64_t> occs;    //!< Reported occurrences.
+
+            uint64_t getNumReported(
+                const uint64_t i) const noexcept
+            {
+                return (occBeg.empty()) ? 0 : occBeg[i + 1] - occBeg[i];
+            }
+        };
+
+        /*!
+         * @brief Read patterns from "is", one per line (trailing '\r' is removed).
+         */
+        inline void readPatterns(
+            std::istream &is,
+            std::vector<std::string> &pats //!< [out]
+        )
+        {
+            std::string line;
+            while (std::getline(is, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                {
+                    line.pop_back();
+                }
+                pats.push_back(line);
+            }
+        }
+
+        /*!
+         * @brief Count (and locate if "locate") patterns "pats" on "rindex".
+         * @note
+         *   "rindex" should not be updated during queries, and then its const queries are safe to run in parallel.
+         *   Patterns are split into chunks of "chunkPats", which are dynamically assigned to "numThreads" threads.
+         *   In each thread, "groupSize" patterns are searched in lockstep: first stages of LF steps ("prepareLfMap")
+         *   of all patterns in the group are issued before second stages, so that their cache misses overlap.
+         *   Empty patterns are reported with no occurrence.
+         */
+        template <class RindexT>
+        void queryBatch(
+            const RindexT &rindex,
+            const std::vector<std::string> &pats,
+            BatchResult &res,                            //!< [out]
+            const bool locate,                           //!< Locate occurrences.
+            const uint64_t maxOccs,                      //!< Max num of occurrences reported for each pattern (0 for all).
+            const unsigned numThreads,                   //!< Num of worker threads (0 for hardware concurrency).
+            const unsigned groupSize = 8,                //!< Num of patterns interleaved in a thread.
+            const uint64_t chunkPats = UINT64_C(1) << 12 //!< Num of patterns assigned to a thread at once.
+        )
+        {
+            using PatTracker = typename RindexT::PatTracker;
+            using LfMapHint = typename RindexT::LfMapHint;
+            assert(groupSize > 0 && chunkPats > 0);
+
+            const uint64_t numPats = pats.size();
+            const uint64_t numChunks = (numPats + chunkPats - 1) / chunkPats;
+            const unsigned nt = static_cast<unsigned>(std::min<uint64_t>(
+                (numThreads) ? numThreads : std::max(1u, std::thread::hardware_concurrency()), std::max<uint64_t>(numChunks, 1)));
+            res.numOccs.assign(numPats, 0);
+            std::vector<PatTracker> results((locate) ? numPats : 0); // Trackers of matched patterns for locating.
+            std::vector<std::vector<uint64_t>> chunkOccs((locate) ? numChunks : 0);
+            std::vector<uint64_t> numReported((locate) ? numPats : 0, 0);
+            std::atomic<uint64_t> nextChunk(0);
+
+            auto worker = [&]()
+            {
+                std::vector<PatTracker> trackers(groupSize);
+                std::vector<LfMapHint> hints(groupSize);
+                std::vector<uint64_t> patIdxs(groupSize);
+                std::vector<uint64_t> plens(groupSize); // Num of characters of pattern processed so far.
+                for (uint64_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+                {
+                    const uint64_t end = std::min(numPats, (chunk + 1) * chunkPats);
+                    uint64_t next = chunk * chunkPats;
+                    //// Set next non-empty pattern of chunk to slot "g" if any.
+                    auto fetch = [&](const unsigned g)
+                    {
+                        while (next < end && pats[next].empty())
+                        {
+                            ++next;
+                        }
+                        if (next == end)
+                        {
+                            return false;
+                        }
+                        trackers[g] = rindex.getInitialPatTracker();
+                        patIdxs[g] = next++;
+                        plens[g] = 0;
+                        return true;
+                    };
+                    unsigned numActive = 0;
+                    while (numActive < groupSize && fetch(numActive))
+                    {
+                        ++numActive;
+                    }
+                    while (numActive)
+                    {
+                        for (unsigned g = 0; g < numActive; ++g)
+                        {
+                            rindex.prepareLfMap(trackers[g], hints[g]);
+                        }
+                        for (unsigned g = 0; g < numActive;)
+                        {
+                            const auto &pat = pats[patIdxs[g]];
+                            const auto ch = static_cast<unsigned char>(pat[plens[g]]);
+                            const bool match = rindex.lfMap(trackers[g], ch, hints[g]);
+                            if (match && ++plens[g] < pat.size())
+                            {
+                                ++g;
+                                continue;
+                            }
+                            if (match)
+                            {
+                                res.numOccs[patIdxs[g]] = rindex.getNumOcc(trackers[g]);
+                                if (locate)
+                                {
+                                    results[patIdxs[g]] = trackers[g];
+                                }
+                            }
+                            if (fetch(g))
+                            { // Hint for new pattern is computed in next round.
+                                ++g;
+                            }
+                            else
+                            { // Move last active slot (not yet processed in this round) to "g".
+                                --numActive;
+                                trackers[g] = trackers[numActive];
+                                hints[g] = hints[numActive];
+                                patIdxs[g] = patIdxs[numActive];
+                                plens[g] = plens[numActive];
+                            }
+                        }
+                    }
+
+                    if (locate)
+                    {
+                        auto &occs = chunkOccs[chunk];
+                        for (uint64_t i = chunk * chunkPats; i < end; ++i)
+                        {
+                            const uint64_t num = (maxOccs) ? std::min(maxOccs, res.numOccs[i]) : res.numOccs[i];
+                            if (num == 0)
+                            {
+                                continue;
+                            }
+                            //// Note that occ computed from tracker is end position (exclusive) of pattern.
+                            const uint64_t len = pats[i].size();
+                            const size_t beg = occs.size();
+                            occs.resize(beg + num);
+                            rindex.locateAll(results[i], occs.data() + beg, num);
+                            for (size_t j = beg; j < occs.size(); ++j)
+                            {
+                                occs[j] -= len;
+                            }
+                            std::sort(occs.begin() + beg, occs.end());
+                            numReported[i] = num;
+                        }
+                    }
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < nt; ++t)
+            {
+                workers.emplace_back(worker);
+            }
+            worker();
+            for (auto &w : workers)
+            {
+                w.join();
+            }
+
+            res.occBeg.clear();
+            res.occs.clear();
+            if (locate)
+            {
+                res.occBeg.resize(numPats + 1);
+                res.occBeg[0] = 0;
+                for (uint64_t i = 0; i < numPats; ++i)
+                {
+                    res.occBeg[i + 1] = res.occBeg[i] + numReported[i];
+                }
+                res.occs.reserve(res.occBeg[numPats]);
+                for (auto &occs : chunkOccs)
+                {
+                    res.occs.insert(res.occs.end(), occs.begin(), occs.end());
+                    std::vector<uint64_t>().swap(occs);
+                }
+            }
+        }
+
+        /*!
+         * @brief Write "res" in TSV: "pattern index \t num of occurrences [\t comma-separated occurrences]" per line.
+         */
+        inline void writeResultsTsv(
+            std::ostream &os,
+            const BatchResult &res)
+        {
+            std::string line;
+            for (uint64_t i = 0; i < res.numOccs.size(); ++i)
+            {
+                line = std::to_string(i);
+                line += '\t';
+                line += std::to_string(res.numOccs[i]);
+                if (!res.occBeg.empty())
+                {
+                    line += '\t';
+                    for (uint64_t j = res.occBeg[i]; j < res.occBeg[i + 1]; ++j)
+                    {
+                        if (j > res.occBeg[i])
+                        {
+                            line += ',';
+                        }
+                        line += std::to_string(res.occs[j]);
+                    }
+                }
+                line += '\n';
+                os.write(line.data(), static_cast<std::streamsize>(line.size()));
+            }
+        }
+
+        /*!
+         * @brief Write "res" in compact binary.
+         * @note
+         *   After header (kResultMagic, kResultVersion) and LEB128 varints of num of patterns and flag of locating,
+         *   each pattern has LEB128 varints of num of occurrences, and if located,
+         *   num of reported occurrences followed by gaps between consecutive (sorted) occurrences.
+         */
+        inline void writeResultsBinary(
+            std::ostream &os,
+            const BatchResult &res)
+        {
+            serialutil::writeHeader(os, kResultMagic, kResultVersion);
+            BlockWriter writer(os);
+            const bool located = !res.occBeg.empty();
+            writer.putVarint(res.numOccs.size());
+            writer.putVarint(located);
+            for (uint64_t i = 0; i < res.numOccs.size(); ++i)
+            {
+                writer.putVarint(res.numOccs[i]);
+                if (located)
+                {
+                    writer.putVarint(res.getNumReported(i));
+                    uint64_t prev = 0;
+                    for (uint64_t j = res.occBeg[i]; j < res.occBeg[i + 1]; ++j)
+                    {
+                        writer.putVarint(res.occs[j] - prev);
+                        prev = res.occs[j];
+                    }
+                }
+            }
+        }
+    } // namespace rindexbatch
+} // namespace itmmti
+
+#endif
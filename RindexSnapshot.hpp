@@ -0,0 +1,169 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file RindexSnapshot.hpp
+ * @brief Single writer and concurrent readers of online index via published snapshots (epochs).
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Bottom nodes and B-tree nodes of indexes are updated in place by "extend", and B-tree nodes live in external modules,
+ *   so that readers cannot share them with the writer. Instead, the writer "commit"s its current index as a new snapshot,
+ *   which is an independent copy (made by serialize/load in memory) and is immutable after publication.
+ *   Readers "acquire" the latest snapshot as std::shared_ptr, which keeps it alive until the last reader releases it,
+ *   so that readers always see a consistent prefix of the input and ingestion is never paused for them.
+ */
+#ifndef INCLUDE_GUARD_RindexSnapshot
+#define INCLUDE_GUARD_RindexSnapshot
+
+#include <stdint.h>
+#include <cassert>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "NumaUtil.hpp"
+#include "SerialUtil.hpp"
+
+namespace itmmti
+{
+    /*!
+     * @brief Wrapper of online index "IndexT" (e.g., ::OnlineRlbwtIndex, ::OnlineRlbwt) for a writer thread and reader threads.
+     * @note
+     *   "IndexT" should have "serialize(std::ostream &)", "load(std::istream &)" and "getLenWithEndmarker()",
+     *   and its const queries should be safe to run in parallel.
+     *   "extend", "getWriter" and "commit" should be called only by the writer thread, and "acquire" by any thread.
+     *   Commit takes time and memory linear to the size of the index (not to the text),
+     *   so that it is meant to be called per batch of sequences.
+     */
+    template <class IndexT>
+    class SnapshotIndex
+    {
+    public:
+        using IndexType = IndexT;
+        using SnapshotPtr = std::shared_ptr<const IndexT>;
+
+    private:
+        IndexT writer_;               //!< Index updated by writer.
+        SnapshotPtr snapshot_;        //!< Latest published snapshot (accessed by std::atomic_load/atomic_store).
+        std::atomic<uint64_t> epoch_; //!< Num of snapshots published.
+        bool numaInterleave_;         //!< Interleave pages of copies over NUMA nodes.
+
+    public:
+        template <class... Args>
+        explicit SnapshotIndex(
+            Args &&...args //!< Arguments to construct writer index.
+            ) : writer_(std::forward<Args>(args)...),
+                snapshot_(nullptr),
+                epoch_(0),
+                numaInterleave_(false)
+        {
+        }
+
+        SnapshotIndex(const SnapshotIndex &) = delete;
+        SnapshotIndex &operator=(const SnapshotIndex &) = delete;
+
+        /*!
+         * @brief Get writer index (only for writer thread).
+         */
+        IndexT &getWriter() noexcept
+        {
+            return writer_;
+        }
+
+        /*!
+         * @brief Extend writer index (only for writer thread).
+         */
+        template <class CharT>
+        void extend(
+            const CharT ch)
+        {
+            writer_.extend(ch);
+        }
+
+        /*!
+         * @brief Publish copy of current writer index as the latest snapshot (only for writer thread).
+         * @return false if copying failed (previous snapshot is kept).
+         */
+        bool commit()
+        {
+            std::shared_ptr<IndexT> copy = makeCopy();
+            if (!copy)
+            {
+                return false;
+            }
+            std::atomic_store(&snapshot_, SnapshotPtr(std::move(copy)));
+            epoch_.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+
+        /*!
+         * @brief Make independent copy of current writer index (nullptr if copying failed).
+         * @note
+         *   With "setNumaInterleave(true)", pages of the copy are interleaved over NUMA nodes (see numautil::ScopedInterleave),
+         *   which suits copies queried by threads on all nodes.
+         *   At its peak, it holds the writer, one serialized buffer and the loaded copy.
+         */
+        std::shared_ptr<IndexT> makeCopy() const
+        {
+            std::string bytes;
+            {
+                serialutil::StringStreamBuf obuf(bytes);
+                std::ostream os(&obuf);
+                writer_.serialize(os);
+            }
+            numautil::ScopedInterleave interleave(numaInterleave_);
+            std::shared_ptr<IndexT> copy = std::make_shared<IndexT>(0);
+            serialutil::MemStreamBuf buf(bytes.data(), bytes.size());
+            std::istream is(&buf);
+            if (!copy->load(is))
+            {
+                return nullptr;
+            }
+            return copy;
+        }
+
+        /*!
+         * @brief Interleave pages of copies made by "commit" and "makeCopy" over NUMA nodes (only for writer thread).
+         */
+        void setNumaInterleave(
+            const bool interleave) noexcept
+        {
+            numaInterleave_ = interleave;
+        }
+
+        /*!
+         * @brief Acquire the latest snapshot (nullptr if nothing is committed yet).
+         * @note Snapshot is valid while the returned pointer (or its copy) is held, even if newer ones are committed.
+         */
+        SnapshotPtr acquire() const
+        {
+            return std::atomic_load(&snapshot_);
+        }
+
+        /*!
+         * @brief Num of snapshots published so far, which readers can use to notice newer snapshots cheaply.
+         */
+        uint64_t getEpoch() const noexcept
+        {
+            return epoch_.load(std::memory_order_acquire);
+        }
+
+        /*!
+         * @brief Length (with end marker) of text indexed in the latest snapshot (0 if nothing is committed yet).
+         */
+        uint64_t getCommittedLenWithEndmarker() const
+        {
+            const auto snapshot = acquire();
+            return (snapshot) ? snapshot->getLenWithEndmarker() : 0;
+        }
+    };
+} // namespace itmmti
+
+#endif
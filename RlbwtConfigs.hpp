@@ -0,0 +1,345 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file RlbwtConfigs.hpp
+ * @brief Curated template configurations of ::DynRleForRlbwt (and r-index over it) selected at runtime by name or by profiling input.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Drivers write their body once as a generic function of configuration and call runWithRlbwtConfig,
+ *   which instantiates it for every configuration of ::CuratedRlbwtConfigs and runs the one selected.
+ *   Name of configuration "b<kB>m<kBtmBM>s<kBtmBS>" gives arities of internal nodes of B+trees,
+ *   bottom nodes of M-tree and bottom nodes of S-tree, e.g., "b32m32s8" is the one hard-coded in drivers before.
+ */
+#ifndef INCLUDE_GUARD_RlbwtConfigs
+#define INCLUDE_GUARD_RlbwtConfigs
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "DynRleForRlbwt.hpp"
+#include "DynSuccForRindex.hpp"
+#include "OnlineRindex.hpp"
+
+namespace itmmti
+{
+    /*!
+     * @brief Type stack of RLBWT and r-index with given arities.
+     * @note
+     *   "tparam_kBtmBSucc" is bottom arity of successor data structure of r-index (default: "tparam_kBtmBM"),
+     *   which is appended to the name as "u<arity>" only if it differs from "tparam_kBtmBM".
+     */
+    template <uint8_t tparam_kB, uint8_t tparam_kBtmBM, uint8_t tparam_kBtmBS, uint8_t tparam_kBtmBSucc = tparam_kBtmBM>
+    struct RlbwtConfig
+    {
+        static constexpr uint8_t kB{tparam_kB};
+        static constexpr uint8_t kBtmBM{tparam_kBtmBM};
+        static constexpr uint8_t kBtmBS{tparam_kBtmBS};
+        static constexpr uint8_t kBtmBSucc{tparam_kBtmBSucc};
+        using BTreeNodeT = BTreeNode<kB>;
+        using BtmNodeMT = BtmNodeM_StepCode<BTreeNodeT, kBtmBM>;
+        using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>; // Each block has 512 btmNodeM.
+        using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, kBtmBS>;
+        using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>; // Each block has 1024 btmNodeS.
+        using DynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_Null, BtmMInfoT, BtmSInfoT>;
+        using DynRleWithSamplesT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_WBitsBlockVec<1024>, BtmMInfoT, BtmSInfoT>;
+        using DynSuccT = DynSuccForRindex<BTreeNodeT, BtmNodeForPSumWithVal<kBtmBSucc>>;
+        using RindexT = OnlineRlbwtIndex<DynRleWithSamplesT, DynSuccT>;
+
+        static std::string getName()
+        {
+            return "b" + std::to_string(kB) + "m" + std::to_string(kBtmBM) + "s" + std::to_string(kBtmBS) +
+                   ((kBtmBSucc == kBtmBM) ? "" : "u" + std::to_string(kBtmBSucc));
+        }
+    };
+
+    /*!
+     * @brief List of configurations dispatched by name.
+     */
+    template <class... ConfigTs>
+    struct RlbwtConfigList;
+
+    template <>
+    struct RlbwtConfigList<>
+    {
+        template <class Func>
+        static bool dispatch(
+            const std::string &,
+            Func &&,
+            int &)
+        {
+            return false;
+        }
+
+        static void appendNames(
+            std::string &)
+        {
+        }
+    };
+
+    template <class HeadT, class... TailTs>
+    struct RlbwtConfigList<HeadT, TailTs...>
+    {
+        /*!
+         * @brief Call "ret = func(ConfigT())" for configuration named "name".
+         * @return false if there is no configuration named "name".
+         */
+        template <class Func>
+        static bool dispatch(
+            const std::string &name,
+            Func &&func,
+            int &ret //!< [out] Return value of "func".
+        )
+        {
+            if (name == HeadT::getName())
+            {
+                ret = func(HeadT());
+                return true;
+            }
+            return RlbwtConfigList<TailTs...>::dispatch(name, func, ret);
+        }
+
+        /*!
+         * @brief Append space-separated names of configurations to "names".
+         */
+        static void appendNames(
+            std::string &names)
+        {
+            names += (names.empty()) ? "" : " ";
+            names += HeadT::getName();
+            RlbwtConfigList<TailTs...>::appendNames(names);
+        }
+    };
+
+    using CuratedRlbwtConfigs = RlbwtConfigList<
+        RlbwtConfig<16, 16, 8>,
+        RlbwtConfig<16, 32, 8>,
+        RlbwtConfig<16, 32, 8, 16>, // Default of OnlineRindex_Demo.
+        RlbwtConfig<32, 32, 8>,
+        RlbwtConfig<32, 32, 16>,
+        RlbwtConfig<32, 64, 16>,
+        RlbwtConfig<64, 64, 16>>;
+
+    /*!
+     * @brief Profile of input to choose configuration.
+     * @note
+     *   Repetitiveness is estimated as num of sampled k-mers over num of distinct ones among them,
+     *   where k-mers are sampled by their hash values (so that the same k-mers are always sampled).
+     *   It is 1 for texts without repeats of length k and grows with num of copies in repetitive collections.
+     */
+    struct InputProfile
+    {
+        uint64_t numChars;    //!< Num of characters profiled.
+        uint64_t numSampled;  //!< Num of sampled k-mers.
+        uint64_t numDistinct; //!< Num of distinct sampled k-mers.
+        uint64_t sigma;       //!< Alphabet size.
+
+        double getRepetitiveness() const noexcept
+        {
+            return (numDistinct) ? static_cast<double>(numSampled) / numDistinct : 1.0;
+        }
+    };
+
+    /*!
+     * @brief Profile prefix of file "file" of at most "maxChars" characters.
+     * @return false if the file cannot be opened.
+     */
+    inline bool profileInput(
+        const std::string &file,
+        InputProfile &profile,                          //!< [out]
+        const uint64_t maxChars = UINT64_C(1) << 28,    //!< Max num of characters profiled.
+        const uint8_t kmerLen = 32,                     //!< Length of k-mers (<= 64).
+        const uint64_t sampleMask = (UINT64_C(1) << 8) - 1 //!< k-mer is sampled if (hash & sampleMask) == 0.
+    )
+    {
+        std::ifstream ifs(file, std::ios::in | std::ios::binary);
+        if (!ifs)
+        {
+            return false;
+        }
+        constexpr uint64_t kBase{UINT64_C(0x100000001b3)};
+        uint64_t basePow = 1; // kBase^{kmerLen} (mod 2^64)
+        for (uint8_t i = 0; i < kmerLen; ++i)
+        {
+            basePow *= kBase;
+        }
+        std::vector<unsigned char> window(kmerLen, 0);
+        std::unordered_set<uint64_t> distinct;
+        bool occ[256] = {};
+        profile = InputProfile{0, 0, 0, 0};
+        uint64_t hash = 0;
+        std::vector<char> buf(UINT64_C(1) << 20);
+        while (profile.numChars < maxChars && ifs)
+        {
+            ifs.read(buf.data(), static_cast<std::streamsize>(std::min<uint64_t>(buf.size(), maxChars - profile.numChars)));
+            const uint64_t len = static_cast<uint64_t>(ifs.gcount());
+            for (uint64_t i = 0; i < len; ++i)
+            {
+                const auto uc = static_cast<unsigned char>(buf[i]);
+                auto &out = window[profile.numChars % kmerLen];
+                hash = hash * kBase + uc - basePow * out; // Rolling hash of the last kmerLen characters.
+                out = uc;
+                occ[uc] = true;
+                if (++profile.numChars >= kmerLen)
+                {
+                    uint64_t h = hash; // Finalizer of splitmix64 to decide sampling by well-mixed bits.
+                    h = (h ^ (h >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+                    h = (h ^ (h >> 27)) * UINT64_C(0x94d049bb133111eb);
+                    h ^= h >> 31;
+                    if ((h & sampleMask) == 0)
+                    {
+                        ++profile.numSampled;
+                        distinct.insert(h);
+                    }
+                }
+            }
+        }
+        profile.numDistinct = distinct.size();
+        for (const bool o : occ)
+        {
+            profile.sigma += o;
+        }
+        return true;
+    }
+
+    /*!
+     * @brief Choose name of configuration for input of "profile" (heuristic).
+     * @note
+     *   Larger bottom nodes of M-tree shrink RLE of highly repetitive texts (only few runs are updated frequently),
+     *   while smaller ones are faster to update when runs are short. Bottom nodes of S-tree are runs of one character,
+     *   which are many for small alphabets (e.g., DNA) and few for large alphabets.
+     */
+    inline std::string chooseRlbwtConfig(
+        const InputProfile &profile)
+    {
+        if (profile.numChars < (UINT64_C(1) << 20))
+        {
+            return "b16m16s8";
+        }
+        const double rep = profile.getRepetitiveness();
+        const bool smallSigma = profile.sigma <= 16;
+        if (rep < 4.0)
+        {
+            return "b32m32s8";
+        }
+        else if (rep < 64.0)
+        {
+            return (smallSigma) ? "b32m32s16" : "b32m64s16";
+        }
+        return "b64m64s16";
+    }
+
+    /*!
+     * @brief Estimate num of runs of RLBWT of text of length "txtLen" having "profile" (heuristic for reservation).
+     * @note
+     *   Each repeat of a k-mer mostly extends existing runs, so n / r is estimated to grow with repetitiveness,
+     *   and to be about 2 for texts without repeats.
+     */
+    inline uint64_t estimateNumRuns(
+        const InputProfile &profile,
+        const uint64_t txtLen)
+    {
+        const double avgRunLen = std::max(2.0, profile.getRepetitiveness());
+        return static_cast<uint64_t>(static_cast<double>(txtLen) / avgRunLen) + 1;
+    }
+
+    /*!
+     * @brief Shared option of drivers: get num of runs to reserve from "spec" and size of input file "file".
+     * @note
+     *   "spec" is either num of runs ("0" for no reservation) or "auto" (estimated by profiling "file").
+     *   Errors are reported to std::cerr with return value false.
+     */
+    inline bool getExpectedRuns(
+        const std::string &spec,
+        const std::string &file,
+        uint64_t &numRuns, //!< [out]
+        uint64_t &txtLen   //!< [out] Size of "file" in bytes.
+    )
+    {
+        std::ifstream ifs(file, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!ifs)
+        {
+            std::cerr << "Error: failed to open " << file << std::endl;
+            return false;
+        }
+        txtLen = static_cast<uint64_t>(ifs.tellg());
+        if (spec == "auto")
+        {
+            InputProfile profile;
+            if (!profileInput(file, profile))
+            {
+                std::cerr << "Error: failed to open " << file << std::endl;
+                return false;
+            }
+            numRuns = estimateNumRuns(profile, txtLen);
+            return true;
+        }
+        char *end = nullptr;
+        numRuns = std::strtoull(spec.c_str(), &end, 10);
+        if (spec.empty() || *end != '\0')
+        {
+            std::cerr << "Error: invalid num of expected runs " << spec << " (number or auto)" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /*!
+     * @brief Shared entry of drivers: run "func(ConfigT())" for configuration "name" and return its return value.
+     * @note
+     *   If "name" is "auto", configuration is chosen by profiling "file" (or is "fallback" if "file" is empty).
+     *   Errors are reported to std::cerr with return value 1.
+     */
+    template <class Func>
+    int runWithRlbwtConfig(
+        const std::string &name,                    //!< Name of configuration or "auto".
+        const std::string &file,                    //!< Input file to profile for "auto".
+        Func &&func,                                //!< Generic function called with configuration.
+        const std::string &fallback = "b32m32s8"   //!< Configuration for "auto" without input.
+    )
+    {
+        std::string chosen = name;
+        if (name == "auto")
+        {
+            InputProfile profile;
+            if (file.empty())
+            {
+                chosen = fallback;
+            }
+            else if (!profileInput(file, profile))
+            {
+                std::cerr << "Error: failed to open " << file << std::endl;
+                return 1;
+            }
+            else
+            {
+                chosen = chooseRlbwtConfig(profile);
+                std::cout << "Profiled " << profile.numChars << " characters: sigma = " << profile.sigma
+                          << ", repetitiveness = " << profile.getRepetitiveness() << std::endl;
+            }
+        }
+        std::cout << "Configuration: " << chosen << std::endl;
+        int ret = 0;
+        if (!CuratedRlbwtConfigs::dispatch(chosen, func, ret))
+        {
+            std::string names;
+            CuratedRlbwtConfigs::appendNames(names);
+            std::cerr << "Error: unknown configuration " << chosen << " (available: auto " << names << ")" << std::endl;
+            return 1;
+        }
+        return ret;
+    }
+} // namespace itmmti
+
+#endif
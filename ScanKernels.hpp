@@ -0,0 +1,228 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file ScanKernels.hpp
+ * @brief Scanning kernels for node-local searches (character search, search of prefix sums of weights).
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   Implementation is selected at compile time by target macros (AVX-512, AVX2, NEON or scalar),
+ *   so that "-march=native" (set in CMakeLists.txt for Release) picks the widest one available.
+ *   Define SCANKERNELS_SCALAR to force the scalar implementation.
+ *   They serve byte arrays of run heads (::StaticRleForRlbwt) and plain prefix sums (::BtmNodeM_Plain, ::FlatPSumIndex).
+ *   Loops over children in ::DynRleForRlbwt with step codes (e.g., calcPredIdxSFromIdxM, calcSumOfWeightOfBtmS) are not
+ *   vectorized, since characters of M-tree children are found through S-tree and weights are variable-length codes.
+ */
+#ifndef INCLUDE_GUARD_ScanKernels
+#define INCLUDE_GUARD_ScanKernels
+
+#include <stdint.h>
+#include <cassert>
+
+#if !defined(SCANKERNELS_SCALAR)
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#define SCANKERNELS_AVX512
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define SCANKERNELS_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SCANKERNELS_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace itmmti
+{
+    namespace scankernels
+    {
+        static constexpr uint64_t NOTFOUND{UINT64_MAX};
+
+        /*!
+         * @brief Return name of selected implementation.
+         */
+        inline const char *getImplName() noexcept
+        {
+#if defined(SCANKERNELS_AVX512)
+            return "avx512";
+#elif defined(SCANKERNELS_AVX2)
+            return "avx2";
+#elif defined(SCANKERNELS_NEON)
+            return "neon";
+#else
+            return "scalar";
+#endif
+        }
+
+        /*!
+         * @brief Return largest i < "n" s.t. "vals[i] == c" (NOTFOUND if none).
+         */
+        inline uint64_t findLastEq(
+            const uint8_t *vals,
+            uint64_t n,
+            const uint8_t c) noexcept
+        {
+#if defined(SCANKERNELS_AVX512)
+            const __m512i cv = _mm512_set1_epi8(static_cast<char>(c));
+            for (; n >= 64; n -= 64)
+            {
+                const __m512i v = _mm512_loadu_si512(reinterpret_cast<const void *>(vals + n - 64));
+                const uint64_t m = _mm512_cmpeq_epi8_mask(v, cv);
+                if (m)
+                {
+                    return n - 64 + 63 - static_cast<uint64_t>(__builtin_clzll(m));
+                }
+            }
+#elif defined(SCANKERNELS_AVX2)
+            const __m256i cv = _mm256_set1_epi8(static_cast<char>(c));
+            for (; n >= 32; n -= 32)
+            {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(vals + n - 32));
+                const uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, cv)));
+                if (m)
+                {
+                    return n - 32 + 31 - static_cast<uint64_t>(__builtin_clz(m));
+                }
+            }
+#elif defined(SCANKERNELS_NEON)
+            const uint8x16_t cv = vdupq_n_u8(c);
+            for (; n >= 16; n -= 16)
+            {
+                const uint8x16_t eq = vceqq_u8(vld1q_u8(vals + n - 16), cv);
+                // 4 bits per byte.
+                const uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+                if (m)
+                {
+                    return n - 16 + (63 - static_cast<uint64_t>(__builtin_clzll(m))) / 4;
+                }
+            }
+#endif
+            while (n)
+            {
+                if (vals[--n] == c)
+                {
+                    return n;
+                }
+            }
+            return NOTFOUND;
+        }
+
+        /*!
+         * @brief Return smallest i < "n" s.t. "vals[i] == c" (NOTFOUND if none).
+         */
+        inline uint64_t findFirstEq(
+            const uint8_t *vals,
+            const uint64_t n,
+            const uint8_t c) noexcept
+        {
+            uint64_t i = 0;
+#if defined(SCANKERNELS_AVX512)
+            const __m512i cv = _mm512_set1_epi8(static_cast<char>(c));
+            for (; i + 64 <= n; i += 64)
+            {
+                const __m512i v = _mm512_loadu_si512(reinterpret_cast<const void *>(vals + i));
+                const uint64_t m = _mm512_cmpeq_epi8_mask(v, cv);
+                if (m)
+                {
+                    return i + static_cast<uint64_t>(__builtin_ctzll(m));
+                }
+            }
+#elif defined(SCANKERNELS_AVX2)
+            const __m256i cv = _mm256_set1_epi8(static_cast<char>(c));
+            for (; i + 32 <= n; i += 32)
+            {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(vals + i));
+                const uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, cv)));
+                if (m)
+                {
+                    return i + static_cast<uint64_t>(__builtin_ctz(m));
+                }
+            }
+#elif defined(SCANKERNELS_NEON)
+            const uint8x16_t cv = vdupq_n_u8(c);
+            for (; i + 16 <= n; i += 16)
+            {
+                const uint8x16_t eq = vceqq_u8(vld1q_u8(vals + i), cv);
+                const uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+                if (m)
+                {
+                    return i + static_cast<uint64_t>(__builtin_ctzll(m)) / 4;
+                }
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                if (vals[i] == c)
+                {
+                    return i;
+                }
+            }
+            return NOTFOUND;
+        }
+
+        /*!
+         * @brief Return smallest i < "n" s.t. "psums[i] > pos" for non-decreasing "psums" (inclusive prefix sums of weights),
+         *        i.e., index of the element containing "pos" (n if none).
+         * @attention Values should be less than 2^63 (for signed comparison of AVX2).
+         */
+        inline uint64_t searchPSum(
+            const uint64_t *psums,
+            const uint64_t n,
+            const uint64_t pos) noexcept
+        {
+            uint64_t i = 0;
+#if defined(SCANKERNELS_AVX512)
+            const __m512i pv = _mm512_set1_epi64(static_cast<long long>(pos));
+            for (; i + 8 <= n; i += 8)
+            {
+                const __m512i v = _mm512_loadu_si512(reinterpret_cast<const void *>(psums + i));
+                const uint32_t m = _mm512_cmpgt_epu64_mask(v, pv);
+                if (m)
+                {
+                    return i + static_cast<uint64_t>(__builtin_ctz(m));
+                }
+            }
+#elif defined(SCANKERNELS_AVX2)
+            const __m256i pv = _mm256_set1_epi64x(static_cast<long long>(pos));
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(psums + i));
+                const uint32_t m = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, pv))));
+                if (m)
+                {
+                    return i + static_cast<uint64_t>(__builtin_ctz(m));
+                }
+            }
+#elif defined(SCANKERNELS_NEON)
+            const uint64x2_t pv = vdupq_n_u64(pos);
+            for (; i + 2 <= n; i += 2)
+            {
+                const uint64x2_t gt = vcgtq_u64(vld1q_u64(psums + i), pv);
+                if (vgetq_lane_u64(gt, 0))
+                {
+                    return i;
+                }
+                if (vgetq_lane_u64(gt, 1))
+                {
+                    return i + 1;
+                }
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                if (psums[i] > pos)
+                {
+                    return i;
+                }
+            }
+            return n;
+        }
+    } // namespace scankernels
+} // namespace itmmti
+
+#endif
@@ -0,0 +1,256 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file SerialUtil.hpp
+ * @brief Utilities for binary serialization and mmap-based loading.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ */
+#ifndef INCLUDE_GUARD_SerialUtil
+#define INCLUDE_GUARD_SerialUtil
+
+#include <stdint.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace itmmti
+{
+    namespace serialutil
+    {
+        /*!
+         * @brief Write trivially copyable "val" in native byte order.
+         */
+        template <typename T>
+        void writeVal(
+            std::ostream &os,
+            const T &val)
+        {
+            os.write(reinterpret_cast<const char *>(&val), sizeof(T));
+        }
+
+        /*!
+         * @brief Read trivially copyable "val" written by writeVal.
+         * @return false if reading failed.
+         */
+        template <typename T>
+        bool readVal(
+            std::istream &is,
+            T &val //!< [out]
+        )
+        {
+            is.read(reinterpret_cast<char *>(&val), sizeof(T));
+            return static_cast<bool>(is);
+        }
+
+        /*!
+         * @brief Write header of serialized object ("magic" and "version").
+         */
+        inline void writeHeader(
+            std::ostream &os,
+            const uint64_t magic,
+            const uint64_t version)
+        {
+            writeVal(os, magic);
+            writeVal(os, version);
+        }
+
+        /*!
+         * @brief Read and check header written by writeHeader.
+         * @return false if it does not match.
+         */
+        inline bool readHeader(
+            std::istream &is,
+            const uint64_t magic,
+            const uint64_t version)
+        {
+            uint64_t m = 0, v = 0;
+            return readVal(is, m) && readVal(is, v) && m == magic && v == version;
+        }
+
+        /*!
+         * @brief Write file by "func(std::ostream &)" via temporary file, which replaces "filename" only when writing succeeded.
+         * @return false if failed.
+         */
+        template <class Func>
+        bool writeFileAtomically(
+            const std::string &filename,
+            Func &&func)
+        {
+            const std::string tmpName = filename + ".tmp";
+            {
+                std::ofstream ofs(tmpName, std::ios::out | std::ios::binary | std::ios::trunc);
+                if (!ofs)
+                {
+                    return false;
+                }
+                func(static_cast<std::ostream &>(ofs));
+                ofs.flush();
+                if (!ofs)
+                {
+                    std::remove(tmpName.c_str());
+                    return false;
+                }
+            }
+            return std::rename(tmpName.c_str(), filename.c_str()) == 0;
+        }
+
+        /*!
+         * @brief Read-only memory-mapped file.
+         */
+        class MappedFile
+        {
+            const char *data_;
+            size_t size_;
+
+        public:
+            MappedFile() : data_(nullptr),
+                           size_(0)
+            {
+            }
+
+            ~MappedFile()
+            {
+                close();
+            }
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            /*!
+             * @brief Map file.
+             * @return false if failed.
+             */
+            bool open(
+                const std::string &filename)
+            {
+                close();
+                const int fd = ::open(filename.c_str(), O_RDONLY);
+                if (fd < 0)
+                {
+                    return false;
+                }
+                struct stat st;
+                if (fstat(fd, &st) != 0)
+                {
+                    ::close(fd);
+                    return false;
+                }
+                size_ = static_cast<size_t>(st.st_size);
+                if (size_)
+                {
+                    void *ptr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+                    if (ptr == MAP_FAILED)
+                    {
+                        ::close(fd);
+                        size_ = 0;
+                        return false;
+                    }
+                    data_ = static_cast<const char *>(ptr);
+                }
+                ::close(fd); // mapping stays valid
+                return true;
+            }
+
+            void close()
+            {
+                if (data_ != nullptr)
+                {
+                    munmap(const_cast<char *>(data_), size_);
+                    data_ = nullptr;
+                }
+                size_ = 0;
+            }
+
+            const char *data() const noexcept
+            {
+                return data_;
+            }
+
+            size_t size() const noexcept
+            {
+                return size_;
+            }
+        };
+
+        /*!
+         * @brief std::streambuf reading directly from memory (e.g., MappedFile) without copying it to a stream buffer.
+         */
+        class MemStreamBuf : public std::streambuf
+        {
+        public:
+            MemStreamBuf(
+                const char *data,
+                const size_t size)
+            {
+                char *p = const_cast<char *>(data);
+                setg(p, p, p + size);
+            }
+
+        protected:
+            std::streamsize xsgetn(
+                char *s,
+                std::streamsize n) override
+            {
+                const std::streamsize avail = egptr() - gptr();
+                if (n > avail)
+                {
+                    n = avail;
+                }
+                std::char_traits<char>::copy(s, gptr(), static_cast<size_t>(n));
+                setg(eback(), gptr() + n, egptr());
+                return n;
+            }
+        };
+
+        /*!
+         * @brief std::streambuf appending written bytes directly to std::string owned by caller.
+         * @note Unlike std::ostringstream, bytes are not copied again to get them as std::string.
+         */
+        class StringStreamBuf : public std::streambuf
+        {
+            std::string &str_;
+
+        public:
+            explicit StringStreamBuf(
+                std::string &str //!< [out] Written bytes are appended.
+                ) : str_(str)
+            {
+            }
+
+        protected:
+            int_type overflow(
+                int_type ch) override
+            {
+                if (!traits_type::eq_int_type(ch, traits_type::eof()))
+                {
+                    str_.push_back(traits_type::to_char_type(ch));
+                }
+                return traits_type::not_eof(ch);
+            }
+
+            std::streamsize xsputn(
+                const char *s,
+                std::streamsize n) override
+            {
+                str_.append(s, static_cast<size_t>(n));
+                return n;
+            }
+        };
+    } // namespace serialutil
+} // namespace itmmti
+
+#endif
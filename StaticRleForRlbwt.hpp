@@ -0,0 +1,717 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file StaticRleForRlbwt.hpp
+ * @brief Static (frozen) snapshot of dynamic RLE of BWT for fast queries.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ */
+#ifndef INCLUDE_GUARD_StaticRleForRlbwt
+#define INCLUDE_GUARD_StaticRleForRlbwt
+
+#include <stdint.h>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "ScanKernels.hpp"
+
+namespace itmmti
+{
+    /*!
+     * @brief Elias-Fano representation of non-decreasing sequence of integers.
+     * @note
+     *   Low bits are packed in fixed width, and high bits are unary coded in a bit vector,
+     *   in which every "kSelSample"-th one and zero are sampled for select.
+     */
+    class EliasFano
+    {
+    public:
+        static constexpr uint64_t kSelSample{128};
+
+    private:
+        uint64_t size_;
+        uint64_t numBuckets_; //!< Num of zeros in high_.
+        uint8_t lowWidth_;
+        std::vector<uint64_t> low_;
+        std::vector<uint64_t> high_;
+        std::vector<uint64_t> sel1_; //!< sel1_[k] = pos of (k * kSelSample)-th one in high_.
+        std::vector<uint64_t> sel0_; //!< sel0_[k] = pos of (k * kSelSample)-th zero in high_.
+
+    public:
+        EliasFano() : size_(0),
+                      numBuckets_(0),
+                      lowWidth_(0)
+        {
+        }
+
+        /*!
+         * @brief Build from non-decreasing "vals", each of which is at most "universe".
+         */
+        EliasFano(
+            const std::vector<uint64_t> &vals,
+            const uint64_t universe) : size_(vals.size()),
+                                       numBuckets_(0),
+                                       lowWidth_(0)
+        {
+            if (size_ && universe / size_ > 1)
+            {
+                lowWidth_ = static_cast<uint8_t>(63 - __builtin_clzll(universe / size_));
+            }
+            numBuckets_ = (universe >> lowWidth_) + 1;
+            const uint64_t numHighBits = size_ + numBuckets_;
+            low_.assign((size_ * lowWidth_ + 63) / 64 + 1, 0);
+            high_.assign(numHighBits / 64 + 1, 0);
+            for (uint64_t i = 0; i < size_; ++i)
+            {
+                assert(vals[i] <= universe);
+                assert(i == 0 || vals[i - 1] <= vals[i]);
+
+                writeLow(i, vals[i]);
+                const uint64_t bitPos = (vals[i] >> lowWidth_) + i;
+                high_[bitPos / 64] |= UINT64_C(1) << (bitPos % 64);
+            }
+            uint64_t num1 = 0, num0 = 0;
+            for (uint64_t bitPos = 0; bitPos < numHighBits; ++bitPos)
+            {
+                if ((high_[bitPos / 64] >> (bitPos % 64)) & 1)
+                {
+                    if (num1 % kSelSample == 0)
+                    {
+                        sel1_.push_back(bitPos);
+                    }
+                    ++num1;
+                }
+                else
+                {
+                    if (num0 % kSelSample == 0)
+                    {
+                        sel0_.push_back(bitPos);
+                    }
+                    ++num0;
+                }
+            }
+        }
+
+        uint64_t size() const noexcept
+        {
+            return size_;
+        }
+
+        /*!
+         * @brief Get "i"-th value (0base).
+         */
+        uint64_t access(
+            const uint64_t i //!< in [0..size()).
+        ) const noexcept
+        {
+            assert(i < size_);
+
+            return ((selectHigh<true>(i) - i) << lowWidth_) | readLow(i);
+        }
+
+        /*!
+         * @brief Compute num of values <= "x".
+         */
+        uint64_t countLeq(
+            const uint64_t x) const noexcept
+        {
+            const uint64_t bucket = x >> lowWidth_;
+            if (bucket >= numBuckets_)
+            {
+                return size_;
+            }
+            uint64_t bitPos = (bucket == 0) ? 0 : selectHigh<false>(bucket - 1) + 1;
+            uint64_t i = bitPos - bucket; // num of values in smaller buckets
+            const uint64_t lowX = x & lowMask();
+            while (((high_[bitPos / 64] >> (bitPos % 64)) & 1) && readLow(i) <= lowX)
+            {
+                ++bitPos;
+                ++i;
+            }
+            return i;
+        }
+
+        size_t calcMemBytes(
+            bool includeThis = true) const noexcept
+        {
+            size_t size = sizeof(*this) * includeThis;
+            size += sizeof(uint64_t) * (low_.capacity() + high_.capacity() + sel1_.capacity() + sel0_.capacity());
+            return size;
+        }
+
+    private:
+        uint64_t lowMask() const noexcept
+        {
+            return (UINT64_C(1) << lowWidth_) - 1;
+        }
+
+        void writeLow(
+            const uint64_t i,
+            const uint64_t val) noexcept
+        {
+            if (lowWidth_ == 0)
+            {
+                return;
+            }
+            const uint64_t bitPos = i * lowWidth_;
+            const uint64_t v = val & lowMask();
+            low_[bitPos / 64] |= v << (bitPos % 64);
+            if (bitPos % 64 + lowWidth_ > 64)
+            {
+                low_[bitPos / 64 + 1] |= v >> (64 - bitPos % 64);
+            }
+        }
+
+        uint64_t readLow(
+            const uint64_t i) const noexcept
+        {
+            if (lowWidth_ == 0)
+            {
+                return 0;
+            }
+            const uint64_t bitPos = i * lowWidth_;
+            uint64_t v = low_[bitPos / 64] >> (bitPos % 64);
+            if (bitPos % 64 + lowWidth_ > 64)
+            {
+                v |= low_[bitPos / 64 + 1] << (64 - bitPos % 64);
+            }
+            return v & lowMask();
+        }
+
+        /*!
+         * @brief Return pos of "rank"-th (0base) one (if "kOne") or zero (otherwise) in high_.
+         */
+        template <bool kOne>
+        uint64_t selectHigh(
+            uint64_t rank) const noexcept
+        {
+            const auto &samples = (kOne) ? sel1_ : sel0_;
+            const uint64_t bitPos = samples[rank / kSelSample];
+            rank %= kSelSample;
+            uint64_t wIdx = bitPos / 64;
+            uint64_t word = ((kOne) ? high_[wIdx] : ~high_[wIdx]) & (~UINT64_C(0) << (bitPos % 64));
+            while (true)
+            {
+                const uint64_t cnt = static_cast<uint64_t>(__builtin_popcountll(word));
+                if (rank < cnt)
+                {
+                    for (; rank; --rank)
+                    {
+                        word &= word - 1;
+                    }
+                    return wIdx * 64 + static_cast<uint64_t>(__builtin_ctzll(word));
+                }
+                rank -= cnt;
+                ++wIdx;
+                word = (kOne) ? high_[wIdx] : ~high_[wIdx];
+            }
+        }
+    };
+
+    /*!
+     * @brief Static RLE of BWT made from a finished ::DynRleForRlbwt by DynRleForRlbwt::freeze.
+     * @note
+     *   Runs are stored in three arrays of num of runs:
+     *   run heads (coded in dense alphabet), run starts (Elias-Fano) and rank of head character before each run.
+     *   In addition, rank of each character is sampled every "kRunBlock" runs.
+     *   rank/select/operator[] have the same interface as those of ::DynRleForRlbwt.
+     *   Up to 256 distinct characters are supported.
+     */
+    template <typename CharT>
+    class StaticRleForRlbwt
+    {
+    public:
+        static constexpr uint64_t NOTFOUND{UINTPTR_MAX};
+        static constexpr uint64_t kRunBlock{64}; //!< Rank of each character is sampled every kRunBlock runs.
+        static constexpr uint64_t kMaxSigma{256};
+
+    private:
+        uint64_t len_;                 //!< |T|.
+        uint64_t numRuns_;             //!< Num of runs.
+        std::vector<CharT> alph_;      //!< Sorted alphabet.
+        std::vector<uint8_t> heads_;   //!< Code of run heads.
+        EliasFano starts_;             //!< Starting pos of runs followed by |T|.
+        std::vector<uint64_t> runRank_; //!< runRank_[j] = num of occ of heads_[j] before j-th run.
+        std::vector<uint64_t> blockRank_; //!< blockRank_[b * sigma + c] = num of occ of c before (b * kRunBlock)-th run.
+        std::vector<uint64_t> C_;      //!< C_[c] = num of occ of characters smaller than c.
+
+    public:
+        StaticRleForRlbwt() : len_(0),
+                              numRuns_(0)
+        {
+        }
+
+        /*!
+         * @brief Build from "drle", which has "forEachRun(func(ch, exponent))" (e.g., ::DynRleForRlbwt).
+         */
+        template <class DynRle>
+        explicit StaticRleForRlbwt(
+            const DynRle &drle) : len_(0),
+                                  numRuns_(0)
+        {
+            drle.forEachRun([this](const CharT ch, const uint64_t exponent)
+                            {
+                                ++numRuns_;
+                                len_ += exponent;
+                                if (std::find(alph_.begin(), alph_.end(), ch) == alph_.end())
+                                {
+                                    alph_.push_back(ch);
+                                } });
+            if (alph_.size() > kMaxSigma)
+            {
+                std::cerr << "Error: StaticRleForRlbwt supports up to " << kMaxSigma << " characters. exiting..." << std::endl;
+                exit(-1);
+            }
+            std::sort(alph_.begin(), alph_.end());
+            const uint64_t sigma = alph_.size();
+
+            std::vector<uint64_t> starts;
+            starts.reserve(numRuns_ + 1);
+            heads_.reserve(numRuns_);
+            runRank_.reserve(numRuns_);
+            blockRank_.reserve((numRuns_ / kRunBlock + 1) * sigma);
+            std::vector<uint64_t> occ(sigma, 0);
+            uint64_t pos = 0;
+            drle.forEachRun([&](const CharT ch, const uint64_t exponent)
+                            {
+                                if (heads_.size() % kRunBlock == 0)
+                                {
+                                    blockRank_.insert(blockRank_.end(), occ.begin(), occ.end());
+                                }
+                                const auto c = static_cast<uint8_t>(std::lower_bound(alph_.begin(), alph_.end(), ch) - alph_.begin());
+                                heads_.push_back(c);
+                                starts.push_back(pos);
+                                runRank_.push_back(occ[c]);
+                                occ[c] += exponent;
+                                pos += exponent; });
+            starts.push_back(pos);
+            starts_ = EliasFano(starts, len_);
+            C_.assign(sigma + 1, 0);
+            for (uint64_t c = 0; c < sigma; ++c)
+            {
+                C_[c + 1] = C_[c] + occ[c];
+            }
+        }
+
+        /*!
+         * @brief Return |T|.
+         */
+        uint64_t getSumOfWeight() const noexcept
+        {
+            return len_;
+        }
+
+        /*!
+         * @brief Compute num of occ of "ch" in T.
+         */
+        uint64_t getSumOfWeight(
+            const uint64_t ch) const noexcept
+        {
+            const uint64_t c = charToCode(ch);
+            return (c == NOTFOUND) ? 0 : C_[c + 1] - C_[c];
+        }
+
+        /*!
+         * @brief Compute num of occ of characters in T smaller than "ch" ("ch" may not occur in T).
+         */
+        uint64_t countSmaller(
+            const uint64_t ch) const noexcept
+        {
+            return (C_.empty()) ? 0 : C_[std::lower_bound(alph_.begin(), alph_.end(), ch) - alph_.begin()];
+        }
+
+        uint64_t getNumRuns() const noexcept
+        {
+            return numRuns_;
+        }
+
+        /*!
+         * @brief Return T[pos].
+         */
+        CharT operator[](
+            const uint64_t pos //!< in [0..|T|).
+        ) const noexcept
+        {
+            assert(pos < len_);
+
+            return alph_[heads_[starts_.countLeq(pos) - 1]];
+        }
+
+        /*!
+         * @brief Return end pos (exclusive) of the run containing T[pos].
+         */
+        uint64_t getRunEnd(
+            const uint64_t pos //!< in [0..|T|).
+        ) const noexcept
+        {
+            assert(pos < len_);
+
+            return starts_.access(starts_.countLeq(pos));
+        }
+
+        /*!
+         * @brief Return index (0base) of the run containing T[pos].
+         */
+        uint64_t getRunIdx(
+            const uint64_t pos //!< in [0..|T|).
+        ) const noexcept
+        {
+            assert(pos < len_);
+
+            return starts_.countLeq(pos) - 1;
+        }
+
+        /*!
+         * @brief Return starting pos of "run"-th run (|T| for "run == getNumRuns()").
+         */
+        uint64_t getRunStart(
+            const uint64_t run //!< in [0..getNumRuns()].
+        ) const noexcept
+        {
+            assert(run <= numRuns_);
+
+            return starts_.access(run);
+        }
+
+        /*!
+         * @brief Compute rank_{ch}[0..pos], i.e., num of ch in T[0..pos].
+         */
+        uint64_t rank(
+            const uint64_t ch,       //!< 64bit-char.
+            uint64_t pos,            //!< Pos (0base) < |T|.
+            const bool calcTotalRank //!< If true, compute 'rank_{ch}[0..pos] + num of occ of characters in T smaller than ch'.
+        ) const noexcept
+        {
+            const uint64_t c = charToCode(ch);
+            if (c == NOTFOUND)
+            {
+                return 0;
+            }
+            // "pos == UINT64_MAX" means the position before T (as in DynRleForRlbwt::rank).
+            const uint64_t ret = (pos == UINT64_MAX) ? 0 : calcOccBefore(c, std::min(pos, len_ - 1) + 1);
+            return ret + ((calcTotalRank) ? C_[c] : 0);
+        }
+
+        /*!
+         * @brief LF map without end marker, i.e., 'num of occ of characters smaller than T[pos]' + 'rank_{T[pos]}[0..pos)'.
+         * @note T[pos] is also returned via "ch" so that one run search suffices.
+         */
+        uint64_t lfMap(
+            const uint64_t pos, //!< Pos (0base) < |T|.
+            CharT &ch           //!< [out] T[pos].
+        ) const noexcept
+        {
+            assert(pos < len_);
+
+            const uint64_t run = starts_.countLeq(pos) - 1;
+            const uint64_t c = heads_[run];
+            ch = alph_[c];
+            return C_[c] + runRank_[run] + pos - starts_.access(run);
+        }
+
+        /*!
+         * @brief Compute smallest pos (0base) s.t. 'rank == rank_{ch}[0..pos]'.
+         * @attention Rank is 1base.
+         */
+        uint64_t select(
+            const uint64_t ch,  //!< character for select query.
+            const uint64_t rank //!< Rank > 0.
+        ) const noexcept
+        {
+            assert(rank > 0);
+
+            const uint64_t c = charToCode(ch);
+            if (c == NOTFOUND || rank > C_[c + 1] - C_[c])
+            {
+                return NOTFOUND;
+            }
+            const uint64_t sigma = alph_.size();
+            uint64_t lo = 0, hi = (numRuns_ - 1) / kRunBlock + 1; // Find last block b s.t. blockRank_ < rank.
+            while (hi - lo > 1)
+            {
+                const uint64_t mid = (lo + hi) / 2;
+                if (blockRank_[mid * sigma + c] < rank)
+                {
+                    lo = mid;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            for (uint64_t j = lo * kRunBlock; j < numRuns_; ++j)
+            {
+                const uint64_t k = scankernels::findFirstEq(heads_.data() + j, numRuns_ - j, static_cast<uint8_t>(c));
+                if (k == scankernels::NOTFOUND)
+                {
+                    break;
+                }
+                j += k;
+                const uint64_t beg = starts_.access(j);
+                if (runRank_[j] + starts_.access(j + 1) - beg >= rank)
+                {
+                    return beg + (rank - runRank_[j] - 1);
+                }
+            }
+            return NOTFOUND;
+        }
+
+        /*!
+         * @brief Compute smallest pos s.t. 'totalRank == totalRank_{ch}[0..pos]'.
+         * @attention TotalRank is 1base.
+         */
+        uint64_t select(
+            const uint64_t totalRank //!< TotalRank > 0.
+        ) const noexcept
+        {
+            assert(totalRank > 0);
+
+            if (totalRank > len_)
+            {
+                return NOTFOUND;
+            }
+            const uint64_t c = static_cast<uint64_t>(std::lower_bound(C_.begin(), C_.end(), totalRank) - C_.begin()) - 1;
+            return select(alph_[c], totalRank - C_[c]);
+        }
+
+        /*!
+         * @brief Call "func(ch, exponent)" for each run from the beginning.
+         */
+        template <class Func>
+        void forEachRun(
+            Func &&func) const
+        {
+            uint64_t beg = 0;
+            for (uint64_t j = 0; j < numRuns_; ++j)
+            {
+                const uint64_t end = starts_.access(j + 1);
+                func(alph_[heads_[j]], end - beg);
+                beg = end;
+            }
+        }
+
+        //////////////////////////////// statistics
+        size_t calcMemBytes(
+            bool includeThis = true) const noexcept
+        {
+            size_t size = sizeof(*this) * includeThis;
+            size += sizeof(CharT) * alph_.capacity();
+            size += sizeof(uint8_t) * heads_.capacity();
+            size += starts_.calcMemBytes(false);
+            size += sizeof(uint64_t) * (runRank_.capacity() + blockRank_.capacity() + C_.capacity());
+            return size;
+        }
+
+        void printStatistics(
+            std::ostream &os,
+            const bool verbose) const noexcept
+        {
+            os << "StaticRleForRlbwt object (" << this << ") " << __func__ << "(" << verbose << ") BEGIN" << std::endl;
+            os << "Len = " << len_ << ", num of runs = " << numRuns_ << ", alphabet size = " << alph_.size() << std::endl;
+            os << "Total: " << calcMemBytes() << " bytes" << std::endl;
+            if (verbose)
+            {
+                os << "heads_: " << heads_.capacity() << " bytes, starts_: " << starts_.calcMemBytes() << " bytes, runRank_: "
+                   << sizeof(uint64_t) * runRank_.capacity() << " bytes, blockRank_: " << sizeof(uint64_t) * blockRank_.capacity() << " bytes" << std::endl;
+            }
+            os << "StaticRleForRlbwt object (" << this << ") " << __func__ << "(" << verbose << ") END" << std::endl;
+        }
+
+    private:
+        uint64_t charToCode(
+            const uint64_t ch) const noexcept
+        {
+            const auto it = std::lower_bound(alph_.begin(), alph_.end(), ch);
+            return (it == alph_.end() || *it != ch) ? NOTFOUND : static_cast<uint64_t>(it - alph_.begin());
+        }
+
+        /*!
+         * @brief Compute num of occ of character coded by "c" in T[0..pos).
+         */
+        uint64_t calcOccBefore(
+            const uint64_t c,
+            const uint64_t pos //!< in [0..|T|].
+        ) const noexcept
+        {
+            assert(pos <= len_);
+
+            if (pos == 0)
+            {
+                return 0;
+            }
+            const uint64_t run = starts_.countLeq(pos - 1) - 1;
+            if (heads_[run] == c)
+            {
+                return runRank_[run] + pos - starts_.access(run);
+            }
+            const uint64_t blockBeg = run - run % kRunBlock;
+            const uint64_t k = scankernels::findLastEq(heads_.data() + blockBeg, run - blockBeg, static_cast<uint8_t>(c));
+            if (k != scankernels::NOTFOUND)
+            {
+                const uint64_t j = blockBeg + k;
+                return runRank_[j] + starts_.access(j + 1) - starts_.access(j);
+            }
+            return blockRank_[(run / kRunBlock) * alph_.size() + c];
+        }
+    };
+
+    /*!
+     * @brief Static RLBWT with implicit end marker made by OnlineRlbwt::freeze.
+     * @note Query interface is the same as that of ::OnlineRlbwt.
+     */
+    template <typename CharT>
+    class StaticRlbwt
+    {
+    public:
+        using bwtintvl = std::pair<uint64_t, uint64_t>;
+
+    private:
+        StaticRleForRlbwt<CharT> srle_;
+        uint64_t emPos_; //!< Position (0base) of end marker.
+        CharT em_;       //!< End marker.
+
+    public:
+        StaticRlbwt() : srle_(),
+                        emPos_(0),
+                        em_(0)
+        {
+        }
+
+        StaticRlbwt(
+            StaticRleForRlbwt<CharT> &&srle,
+            const uint64_t emPos,
+            const CharT em) : srle_(std::move(srle)),
+                              emPos_(emPos),
+                              em_(em)
+        {
+        }
+
+        const StaticRleForRlbwt<CharT> &getRle() const noexcept
+        {
+            return srle_;
+        }
+
+        CharT getEm() const noexcept
+        {
+            return em_;
+        }
+
+        uint64_t getEndmarkerPos() const noexcept
+        {
+            return emPos_;
+        }
+
+        uint64_t getLenWithEndmarker() const noexcept
+        {
+            return srle_.getSumOfWeight() + 1;
+        }
+
+        /*!
+         * @brief Access to RLBWT by [] operator.
+         */
+        CharT operator[](
+            uint64_t pos //!< in [0..StaticRlbwt::getLenWithEndmarker()].
+        ) const noexcept
+        {
+            assert(pos < getLenWithEndmarker());
+
+            if (pos == emPos_)
+            {
+                return em_;
+            }
+            pos -= (pos > emPos_);
+            return srle_[pos];
+        }
+
+        /*!
+         * @brief Return 'rank of ch at pos' + 'num of total occ of characters smaller than ch'.
+         */
+        uint64_t totalRank(
+            const CharT ch,
+            uint64_t pos //!< in [0..StaticRlbwt::getLenWithEndmarker()].
+        ) const noexcept
+        {
+            assert(pos < getLenWithEndmarker());
+
+            pos -= (pos > emPos_);
+            return srle_.rank(ch, pos, true);
+        }
+
+        /*!
+         * @brief Compute bwt-interval for cW from bwt-interval for W
+         * @note Intervals are [left, right) : right bound is excluded
+         */
+        bwtintvl lfMap(
+            const bwtintvl intvl,
+            const CharT ch) const noexcept
+        {
+            assert(intvl.first <= getLenWithEndmarker() && intvl.second <= getLenWithEndmarker());
+
+            if (srle_.getSumOfWeight(ch) == 0 || intvl.first >= intvl.second)
+            {
+                return {0, 0};
+            }
+            const uint64_t l = intvl.first - (intvl.first > emPos_);
+            const uint64_t r = intvl.second - (intvl.second > emPos_);
+            //// +1 for end marker in F.
+            return {
+                ((l) ? srle_.rank(ch, l - 1, true) : srle_.rank(ch, UINT64_MAX, true)) + 1,
+                srle_.rank(ch, r - 1, true) + 1};
+        }
+
+        /*!
+         * @brief LF map.
+         */
+        uint64_t lfMap(
+            uint64_t i) const noexcept
+        {
+            assert(i < getLenWithEndmarker());
+
+            i -= (i > emPos_);
+            return srle_.rank(srle_[i], i, true);
+        }
+
+        /*!
+         * @brief Output original text to std::ofstream.
+         */
+        void invert(
+            std::ofstream &ofs) const noexcept
+        {
+            uint64_t pos = 0;
+            for (uint64_t i = 0; i < getLenWithEndmarker() - 1; ++i)
+            {
+                pos -= (pos > emPos_);
+                const auto ch = srle_[pos];
+                ofs.put(static_cast<signed char>(static_cast<unsigned char>(ch)));
+                pos = srle_.rank(ch, pos, true);
+            }
+        }
+
+        size_t calcMemBytes(
+            bool includeThis = true) const noexcept
+        {
+            return sizeof(*this) * includeThis + srle_.calcMemBytes(false);
+        }
+
+        void printStatistics(
+            std::ostream &os,
+            const bool verbose) const noexcept
+        {
+            os << "StaticRlbwt object (" << this << ") " << __func__ << "(" << verbose << ") BEGIN" << std::endl;
+            os << "Len with endmarker = " << getLenWithEndmarker() << std::endl;
+            os << "emPos_ = " << emPos_ << ", em_ = " << em_ << std::endl;
+            srle_.printStatistics(os, verbose);
+            os << "StaticRlbwt object (" << this << ") " << __func__ << "(" << verbose << ") END" << std::endl;
+        }
+    };
+} // namespace itmmti
+
+#endif
@@ -0,0 +1,189 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file StaticSuccForRindex.hpp
+ * @brief Static, compact successor data structure with values used in query phases of r-index.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   It answers the same successor queries as ::DynSuccForRindex after construction is done:
+ *   keys (sampled text-positions) are stored by ::EliasFano, and values (text-positions) are packed in
+ *   w bits, where w is the bit width of the upper bound of sample positions (see ::Samples_WBitsBlockVec).
+ *   So each entry takes about w + 2 + log(n / r) bits instead of two 64-bit words and B+tree nodes.
+ *   The set of keys may be a subset of the dynamic one (see OnlineRlbwtIndex::compactSucc).
+ */
+#ifndef INCLUDE_GUARD_StaticSuccForRindex
+#define INCLUDE_GUARD_StaticSuccForRindex
+
+#include <stdint.h>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include "StaticRleForRlbwt.hpp"
+
+namespace itmmti
+{
+    class StaticSuccForRindex
+    {
+        EliasFano keys_;             //!< Keys in increasing order.
+        std::vector<uint64_t> vals_; //!< Values packed in "valWidth_" bits.
+        uint8_t valWidth_;           //!< Bit width of values.
+
+    public:
+        StaticSuccForRindex() : keys_(),
+                                vals_(),
+                                valWidth_(0)
+        {
+        }
+
+        /*!
+         * @brief Build from (keys[i], vals[i]) pairs, where keys are strictly increasing and vals are less than "valUb".
+         */
+        void build(
+            const std::vector<uint64_t> &keys,
+            const std::vector<uint64_t> &vals,
+            const uint64_t valUb)
+        {
+            assert(keys.size() == vals.size());
+
+            clear();
+            const uint64_t num = keys.size();
+            keys_ = EliasFano(keys, (num) ? keys.back() : 0);
+            valWidth_ = (valUb > 1) ? static_cast<uint8_t>(64 - __builtin_clzll(valUb - 1)) : 1;
+            vals_.assign((num * valWidth_ + 63) / 64 + 1, 0);
+            for (uint64_t i = 0; i < num; ++i)
+            {
+                assert(vals[i] < valUb);
+                writeVal(i, vals[i]);
+            }
+        }
+
+        void clear()
+        {
+            keys_ = EliasFano();
+            std::vector<uint64_t>().swap(vals_);
+            valWidth_ = 0;
+        }
+
+        bool empty() const noexcept
+        {
+            return vals_.empty();
+        }
+
+        uint64_t getNumKeys() const noexcept
+        {
+            return keys_.size();
+        }
+
+        uint8_t getValWidth() const noexcept
+        {
+            return valWidth_;
+        }
+
+        /*!
+         * @brief Get value of the smallest key >= "txtPos".
+         * @return UINT64_MAX (with key = UINT64_MAX - 1 as sentinel of ::DynSuccForRindex) if there is no such key.
+         */
+        uint64_t searchSucc(
+            const uint64_t txtPos,
+            uint64_t &key //!< [out] Smallest key >= "txtPos".
+        ) const noexcept
+        {
+            const uint64_t i = (txtPos) ? keys_.countLeq(txtPos - 1) : 0;
+            if (i == keys_.size())
+            {
+                key = UINT64_MAX - 1;
+                return UINT64_MAX;
+            }
+            key = keys_.access(i);
+            return readVal(i);
+        }
+
+        /*!
+         * @brief Get value of "key" if it is stored.
+         */
+        bool find(
+            const uint64_t key,
+            uint64_t &val //!< [out]
+        ) const noexcept
+        {
+            const uint64_t i = keys_.countLeq(key);
+            if (i == 0 || keys_.access(i - 1) != key)
+            {
+                return false;
+            }
+            val = readVal(i - 1);
+            return true;
+        }
+
+        /*!
+         * @brief Function to get text-position for "BWT[bwtpos + 1]", where "BWT[bwtpos]" corresponds to "T[txtpos]".
+         * @note Same as DynSuccForRindex::calcNextPos, which is valid only if no key is dropped.
+         */
+        uint64_t calcNextPos(
+            const uint64_t txtPos, //!< Text-position for currently focused character.
+            const uint64_t txtLen, //!< Text length without end marker.
+            const uint64_t emPrev, //!< Text-position for previous character of implicit end marker.
+            const uint64_t emNext  //!< Text-position for next character of implicit end marker.
+        ) const noexcept
+        {
+            assert(txtPos <= txtLen);
+
+            uint64_t key;
+            const uint64_t val = searchSucc(txtPos, key);
+            const uint64_t dist = key - txtPos; // distance to sampled position
+            if (txtPos <= emPrev && emPrev - txtPos <= dist)
+            {
+                return txtLen - (emPrev - txtPos);
+            }
+            else if (txtLen - txtPos <= dist)
+            {
+                return emNext - (txtLen - txtPos);
+            }
+            return val - dist;
+        }
+
+        size_t calcMemBytes(
+            const bool includeThis = true) const noexcept
+        {
+            size_t size = sizeof(*this) * includeThis;
+            size += keys_.calcMemBytes(false);
+            size += sizeof(uint64_t) * vals_.capacity();
+            return size;
+        }
+
+    private:
+        uint64_t readVal(
+            const uint64_t i) const noexcept
+        {
+            const uint64_t bitPos = i * valWidth_;
+            const uint64_t mask = (valWidth_ == 64) ? UINT64_MAX : (UINT64_C(1) << valWidth_) - 1;
+            uint64_t val = vals_[bitPos / 64] >> (bitPos % 64);
+            if (bitPos % 64 + valWidth_ > 64)
+            {
+                val |= vals_[bitPos / 64 + 1] << (64 - bitPos % 64);
+            }
+            return val & mask;
+        }
+
+        void writeVal(
+            const uint64_t i,
+            const uint64_t val) noexcept
+        {
+            const uint64_t bitPos = i * valWidth_;
+            vals_[bitPos / 64] |= val << (bitPos % 64);
+            if (bitPos % 64 + valWidth_ > 64)
+            {
+                vals_[bitPos / 64 + 1] |= val >> (64 - bitPos % 64);
+            }
+        }
+    };
+} // namespace itmmti
+
+#endif
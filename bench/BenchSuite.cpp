@@ -0,0 +1,416 @@
+/*!
+ * Copyright (c) 2025 Xinwu Yu
+ *
+ * This program is released under the MIT License.
+ * http://opensource.org/licenses/mit-license.php
+ */
+/*!
+ * @file BenchSuite.cpp
+ * @brief Micro and macro benchmarks of DynRleForRlbwt, OnlineRlbwt and OnlineRlbwtIndex over template configurations, reported in JSON.
+ * @author Xinwu Yu
+ * @date 2025-2-14
+ * @note
+ *   For each configuration (arity of BTreeNode x arity of BtmNodeM), benchmarks are
+ *   - macro: construction of OnlineRlbwt by extend (insertRun), of sptBWT by sptExtend (optInsert) and of OnlineRlbwtIndex,
+ *   - micro: searchPosM (also with flat index of DynRleForRlbwt::buildFlatIndexM), rank, select, lfMap, insertRun, optInsert and calcNextPos at random positions.
+ *   All random choices are seeded by --seed, and dataset is either a file or generated by --gen_len,
+ *   so that runs are reproducible. Checksums of queries should coincide among configurations.
+ */
+#include <stdint.h>
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cmdline.h"
+#include "OnlineRlbwt.hpp"
+#include "OnlineRindex.hpp"
+#include "DynRleForRlbwt.hpp"
+#include "DynSuccForRindex.hpp"
+
+
+using namespace itmmti;
+
+namespace {
+  double elapsedSec
+  (
+   const std::chrono::high_resolution_clock::time_point t1
+   ) {
+    auto t2 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+  }
+
+
+  std::string jsonEscape
+  (
+   const std::string & str
+   ) {
+    std::string ret;
+    for (const char c : str) {
+      if (c == '"' || c == '\\') {
+        ret += '\\';
+        ret += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        ret += ' ';
+      } else {
+        ret += c;
+      }
+    }
+    return ret;
+  }
+
+
+  /*!
+   * @brief Collector of measurements written as JSON array of objects.
+   */
+  class BenchReport
+  {
+    std::vector<std::string> records_;
+
+  public:
+    void add
+    (
+     const std::string & config,
+     const std::string & kind, //!< "macro" or "micro".
+     const std::string & op,
+     const uint64_t numOps,
+     const double sec,
+     const uint64_t checksum,
+     const std::string & extra = "" //!< Additional JSON members (starting with ',').
+     ) {
+      std::ostringstream oss;
+      oss << "{\"config\": \"" << config << "\", \"kind\": \"" << kind << "\", \"op\": \"" << op
+          << "\", \"num_ops\": " << numOps << ", \"sec\": " << sec
+          << ", \"ns_per_op\": " << ((numOps) ? sec * 1e9 / numOps : 0.0)
+          << ", \"checksum\": " << checksum << extra << "}";
+      records_.push_back(oss.str());
+      std::cerr << "  " << config << " " << op << ": " << sec << " sec" << std::endl;
+    }
+
+
+    void write
+    (
+     std::ostream & os,
+     const std::string & header //!< JSON members describing the run.
+     ) const {
+      os << "{" << header << ",\n \"results\": [\n";
+      for (size_t i = 0; i < records_.size(); ++i) {
+        os << "  " << records_[i] << ((i + 1 < records_.size()) ? ",\n" : "\n");
+      }
+      os << " ]}" << std::endl;
+    }
+  };
+
+
+  /*!
+   * @brief Generate repetitive DNA collection: "numCopies" copies of random base string, each mutated at rate "mutRate".
+   */
+  void generateCollection
+  (
+   const uint64_t len, //!< Total length (approx.).
+   const uint64_t numCopies,
+   const double mutRate,
+   const uint64_t seed,
+   std::vector<std::string> & seqs //!< [out]
+   ) {
+    static const char kAlph[] = "ACGT";
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> distCh(0, 3);
+    std::uniform_real_distribution<double> distMut(0.0, 1.0);
+    std::string base(std::max<uint64_t>(len / numCopies, 1), 'A');
+    for (auto & c : base) {
+      c = kAlph[distCh(rng)];
+    }
+    seqs.clear();
+    for (uint64_t k = 0; k < numCopies; ++k) {
+      std::string seq = base;
+      for (auto & c : seq) {
+        if (distMut(rng) < mutRate) {
+          c = kAlph[distCh(rng)];
+        }
+      }
+      seqs.push_back(std::move(seq));
+    }
+  }
+
+
+  template <uint8_t kB, uint8_t kBtmBM>
+  struct BenchConfig
+  {
+    using BTreeNodeT = BTreeNode<kB>;
+    using BtmNodeMT = BtmNodeM_StepCode<BTreeNodeT, kBtmBM>;
+    using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>;
+    using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, 8>;
+    using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>;
+    using DynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_Null, BtmMInfoT, BtmSInfoT>;
+    using DynRleWithSamplesT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_WBitsBlockVec<1024>, BtmMInfoT, BtmSInfoT>;
+    using DynSuccT = DynSuccForRindex<BTreeNodeT, BtmNodeForPSumWithVal<kBtmBM>>;
+    using RindexT = OnlineRlbwtIndex<DynRleWithSamplesT, DynSuccT>;
+
+    static std::string getName() {
+      return "BTreeNode<" + std::to_string(kB) + ">,BtmNodeM<" + std::to_string(kBtmBM) + ">";
+    }
+  };
+
+
+  /*!
+   * @brief Run all benchmarks for configuration "ConfigT".
+   */
+  template <class ConfigT>
+  void runConfig
+  (
+   const std::vector<unsigned char> & text, //!< Text for OnlineRlbwt and OnlineRlbwtIndex.
+   const std::vector<uint8_t> & collection, //!< Concatenation of separator-terminated sequences for sptExtend.
+   const uint64_t numQueries,
+   const uint64_t seed,
+   const bool withRindex,
+   BenchReport & report
+   ) {
+    using DynRleT = typename ConfigT::DynRleT;
+    const std::string config = ConfigT::getName();
+    std::cerr << config << std::endl;
+
+    //// macro: construction by extend
+    OnlineRlbwt<DynRleT> rlbwt(1);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (const auto uc : text) {
+      rlbwt.extend(uint8_t(uc));
+    }
+    report.add(config, "macro", "construct_extend", text.size(), elapsedSec(t1), rlbwt.calcNumRuns(),
+               ", \"runs\": " + std::to_string(rlbwt.calcNumRuns()) + ", \"bytes\": " + std::to_string(rlbwt.calcMemBytes()));
+
+    //// macro: construction by sptExtend
+    if (!collection.empty()) {
+      OnlineRlbwt<DynRleT> spt(1);
+      t1 = std::chrono::high_resolution_clock::now();
+      spt.appendCollection(collection.data(), collection.size(), [](const typename OnlineRlbwt<DynRleT>::AppendStats &) {}, 0);
+      report.add(config, "macro", "construct_spt", collection.size(), elapsedSec(t1), spt.calcNumRuns(),
+                 ", \"runs\": " + std::to_string(spt.calcNumRuns()) + ", \"bytes\": " + std::to_string(spt.calcMemBytes()));
+    }
+
+    //// Runs of BWT (without end marker) to bulk-load DynRle for micro benchmarks.
+    std::vector<std::pair<uint32_t, uint64_t>> runs;
+    rlbwt.freeze().getRle().forEachRun([&runs](const uint32_t ch, const uint64_t exponent) {
+        runs.emplace_back(ch, exponent);
+      });
+    DynRleT drle(1, 0);
+    t1 = std::chrono::high_resolution_clock::now();
+    drle.bulkLoad(runs.begin(), runs.end(), runs.size());
+    report.add(config, "macro", "bulk_load", runs.size(), elapsedSec(t1), drle.getSumOfWeight());
+    const uint64_t n = drle.getSumOfWeight();
+    std::vector<uint32_t> alph;
+    for (const auto & run : runs) {
+      if (std::find(alph.begin(), alph.end(), run.first) == alph.end()) {
+        alph.push_back(run.first);
+      }
+    }
+
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint64_t> distPos(0, n - 1);
+    std::uniform_int_distribution<size_t> distCh(0, alph.size() - 1);
+    std::vector<uint64_t> poss(numQueries);
+    std::vector<uint32_t> chs(numQueries);
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      poss[i] = distPos(rng);
+      chs[i] = alph[distCh(rng)];
+    }
+
+    uint64_t sum = 0;
+    t1 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      uint64_t pos = poss[i];
+      sum += drle.searchPosM(pos) + pos;
+    }
+    report.add(config, "micro", "searchPosM", numQueries, elapsedSec(t1), sum);
+
+    drle.buildFlatIndexM();
+    sum = 0;
+    t1 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      uint64_t pos = poss[i];
+      sum += drle.searchPosM(pos) + pos;
+    }
+    report.add(config, "micro", "searchPosM_flat", numQueries, elapsedSec(t1), sum);
+    drle.clearFlatIndexM();
+
+    sum = 0;
+    t1 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      sum += drle.rank(chs[i], poss[i], true);
+    }
+    report.add(config, "micro", "rank", numQueries, elapsedSec(t1), sum);
+
+    std::vector<uint64_t> ranks(numQueries);
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      ranks[i] = poss[i] % drle.getSumOfWeight(chs[i]) + 1;
+    }
+    sum = 0;
+    t1 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      sum += drle.select(chs[i], ranks[i]);
+    }
+    report.add(config, "micro", "select", numQueries, elapsedSec(t1), sum);
+
+    uint64_t pos = 0;
+    sum = 0;
+    t1 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < numQueries; ++i) {
+      pos = rlbwt.lfMap(pos);
+      sum += pos;
+    }
+    report.add(config, "micro", "lfMap", numQueries, elapsedSec(t1), sum);
+
+    //// Updates are measured on copies made by bulk-loading.
+    {
+      DynRleT drle2(1, 0);
+      drle2.bulkLoad(runs.begin(), runs.end(), runs.size());
+      sum = 0;
+      t1 = std::chrono::high_resolution_clock::now();
+      for (uint64_t i = 0; i < numQueries; ++i) {
+        uint64_t p = poss[i] % (drle2.getSumOfWeight() + 1);
+        sum += drle2.insertRun(p, chs[i]) + p;
+      }
+      report.add(config, "micro", "insertRun", numQueries, elapsedSec(t1), sum);
+    }
+    {
+      DynRleT drle2(1, 0);
+      drle2.bulkLoad(runs.begin(), runs.end(), runs.size());
+      sum = 0;
+      t1 = std::chrono::high_resolution_clock::now();
+      for (uint64_t i = 0; i < numQueries; ++i) { // sap-intervals of width up to 16.
+        const uint64_t s = poss[i] % drle2.getSumOfWeight();
+        const uint64_t e = std::min(s + (ranks[i] & 15), drle2.getSumOfWeight() - 1);
+        sum += drle2.optInsert(s, e, chs[i]);
+      }
+      report.add(config, "micro", "optInsert", numQueries, elapsedSec(t1), sum);
+    }
+
+    //// macro and micro benchmarks of OnlineRlbwtIndex
+    if (withRindex) {
+      typename ConfigT::RindexT rindex(1);
+      t1 = std::chrono::high_resolution_clock::now();
+      for (const auto uc : text) {
+        rindex.extend(uint8_t(uc));
+      }
+      report.add(config, "macro", "construct_rindex", text.size(), elapsedSec(t1), rindex.getLenWithEndmarker(),
+                 ", \"bytes\": " + std::to_string(rindex.calcMemBytes()));
+      sum = 0;
+      t1 = std::chrono::high_resolution_clock::now();
+      for (uint64_t i = 0; i < numQueries; ++i) {
+        sum += rindex.calcNextPos(poss[i] % text.size());
+      }
+      report.add(config, "micro", "calcNextPos", numQueries, elapsedSec(t1), sum);
+    }
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  cmdline::parser parser;
+  parser.add<std::string>("input", 'i', "input file name (plain text, or FASTA with --fasta)", false, "");
+  parser.add<bool>("fasta", 0, "input is (multi-)FASTA, whose records are also used as collection for sptExtend", false, 0);
+  parser.add<uint64_t>("gen_len", 0, "generate repetitive DNA collection of given length instead of input", false, 0);
+  parser.add<uint64_t>("gen_copies", 0, "num of copies (sequences) in generated collection", false, 16);
+  parser.add<double>("gen_mut", 0, "mutation rate of copies in generated collection", false, 0.001);
+  parser.add<std::string>("name", 0, "dataset name reported in JSON (default: input file name)", false, "");
+  parser.add<uint64_t>("queries", 'q', "num of queries for micro benchmarks", false, 1000000);
+  parser.add<uint64_t>("seed", 0, "seed of random queries and generated dataset", false, 0);
+  parser.add<bool>("no_rindex", 0, "skip benchmarks of OnlineRlbwtIndex", false, 0);
+  parser.add<std::string>("json", 'o', "output JSON file name (default: stdout)", false, "");
+  parser.add("help", 0, "print help");
+
+  parser.parse_check(argc, argv);
+  const std::string in = parser.get<std::string>("input");
+  const bool fasta = parser.get<bool>("fasta");
+  const uint64_t genLen = parser.get<uint64_t>("gen_len");
+  const uint64_t numQueries = parser.get<uint64_t>("queries");
+  const uint64_t seed = parser.get<uint64_t>("seed");
+  const bool withRindex = !parser.get<bool>("no_rindex");
+  const std::string jsonFile = parser.get<std::string>("json");
+  std::string name = parser.get<std::string>("name");
+  if (in.empty() == (genLen == 0)) {
+    std::cerr << "error: either --input or --gen_len should be given" << std::endl;
+    exit(1);
+  }
+
+  //// "text" is indexed by extend, and "collection" (separator-terminated sequences) by sptExtend.
+  std::vector<unsigned char> text;
+  std::vector<uint8_t> collection;
+  auto addSeq = [&](const std::string & seq) {
+    text.insert(text.end(), seq.begin(), seq.end());
+    collection.insert(collection.end(), seq.rbegin(), seq.rend()); // sptExtend takes reversed sequences.
+    collection.push_back(1);
+  };
+  if (genLen) {
+    std::vector<std::string> seqs;
+    generateCollection(genLen, std::max<uint64_t>(parser.get<uint64_t>("gen_copies"), 1), parser.get<double>("gen_mut"), seed, seqs);
+    for (const auto & seq : seqs) {
+      addSeq(seq);
+    }
+    if (name.empty()) {
+      name = "gen_" + std::to_string(genLen);
+    }
+  } else {
+    std::ifstream ifs(in, std::ios::in | std::ios::binary);
+    if (!ifs) {
+      std::cerr << "error: failed to open " << in << std::endl;
+      exit(1);
+    }
+    if (fasta) {
+      std::string line, seq;
+      while (std::getline(ifs, line)) {
+        if (!line.empty() && line[0] == '>') {
+          if (!seq.empty()) {
+            addSeq(seq);
+          }
+          seq.clear();
+        } else {
+          seq += line;
+        }
+      }
+      if (!seq.empty()) {
+        addSeq(seq);
+      }
+    } else {
+      text.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+    if (name.empty()) {
+      name = in;
+    }
+  }
+  if (text.empty() || numQueries == 0) {
+    std::cerr << "error: dataset and num of queries should be non-empty" << std::endl;
+    exit(1);
+  }
+
+  BenchReport report;
+  runConfig<BenchConfig<16, 16>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<16, 32>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<16, 64>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<32, 16>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<32, 32>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<32, 64>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<64, 16>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<64, 32>>(text, collection, numQueries, seed, withRindex, report);
+  runConfig<BenchConfig<64, 64>>(text, collection, numQueries, seed, withRindex, report);
+
+  std::ostringstream header;
+  header << "\"dataset\": \"" << jsonEscape(name) << "\", \"len\": " << text.size()
+         << ", \"num_seqs\": " << std::count(collection.begin(), collection.end(), 1)
+         << ", \"queries\": " << numQueries << ", \"seed\": " << seed
+         << ", \"scan_kernels\": \"" << scankernels::getImplName() << "\"";
+  if (jsonFile.empty()) {
+    report.write(std::cout, header.str());
+  } else {
+    std::ofstream ofs(jsonFile);
+    report.write(ofs, header.str());
+  }
+}
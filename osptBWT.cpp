@@ -16,8 +16,11 @@
 
 #include <time.h>
 #include <iostream>
+#include <fstream>
 #include <iomanip>
 #include <chrono>
+#include <algorithm>
+#include <thread>
 #include <sys/resource.h>
 #include <sys/time.h>
 
@@ -25,20 +28,129 @@
 #include "OnlineRlbwt.hpp"
 #include "DynRleForRlbwt.hpp"
 #include "IOutils.hpp"
+#include "CollectionInverter.hpp"
+#include "CollectionMerger.hpp"
+#include "BuildStats.hpp"
+#include "DocArray.hpp"
+#include "RlbwtConfigs.hpp"
 
 using namespace itmmti;
 using SizeT = uint64_t;
 
+constexpr uint64_t kCkptMagic{UINT64_C(0x74706b437470736f)}; //!< "osptCkpt"
+constexpr uint64_t kCkptVersion{1};
+
 int main(int argc, char *argv[])
 {
 
     cmdline::parser parser;
     parser.add<std::string>("input", 'i', "input file name", true);
     parser.add<std::string>("output", 'o', "output file name BWT", false);
+    parser.add<bool>("in_memory", 'm', "load whole text before construction (default: stream records one by one)", false, 0);
+    parser.add<std::string>("format", 'f', "output format of BWT: plain, rle (char + varint length) or heads_lengths (<output>.heads and <output>.len)", false, "plain");
+    parser.add<uint64_t>("report", 'r', "report progress every given number of sequences (0: only at the end)", false, 10000);
+    parser.add<std::string>("checkpoint", 'c', "checkpoint file name (written periodically in streaming mode)", false, "");
+    parser.add<uint64_t>("ckpt_seqs", 0, "write checkpoint every given number of sequences (0: disabled)", false, 0);
+    parser.add<uint64_t>("ckpt_chars", 0, "write checkpoint every given number of characters (0: disabled)", false, 0);
+    parser.add<bool>("resume", 0, "resume from checkpoint, skipping sequences already processed", false, 0);
+    parser.add<bool>("append", 0, "load checkpoint and append all sequences of input to it (incremental construction)", false, 0);
+    parser.add<std::string>("invert", 0, "file name to write sequences recovered from BWT (one per line) for validation", false, "");
+    parser.add<unsigned>("threads", 't', "num of threads for inversion and merging of shards (0: hardware concurrency)", false, 0);
+    parser.add<unsigned>("shards", 0, "build BWTs of given num of shards of input in parallel and merge them (requires --in_memory)", false, 1);
+    parser.add<std::string>("import", 0, "BWT file to start from (e.g., output of previous run), bulk-loaded before appending input; its terminating character 0 is dropped", false, "");
+    parser.add<std::string>("import_format", 0, "format of imported BWT: plain or rle", false, "plain");
+    parser.add<bool>("arena", 0, "allocate blocks of bottom nodes from node arena", false, 0);
+    parser.add<bool>("hugepages", 0, "back node arena by huge pages (implies --arena)", false, 0);
+    parser.add<std::string>("stats_format", 0, "format of progress reports: text, json (one object per line) or csv", false, "text");
+    parser.add<std::string>("stats_file", 0, "file name to write progress reports (default: stdout)", false, "");
+    parser.add<std::string>("doc_patterns", 0, "file of patterns (one per line) to list sequence IDs (0base input order) containing them, which tracks sequences during construction", false, "");
+    parser.add<uint64_t>("topk", 0, "num of sequences with most occurrences listed for each pattern of --doc_patterns", false, 10);
+    parser.add<uint64_t>("doc_rate", 0, "max num of LF steps between samples of document array along sequences (0: only run heads)", false, DocArray::kDefaultSampleRate);
+    parser.add<std::string>("expected_runs", 0, "num of runs to reserve space for (0 for none) or auto (estimated by profiling input)", false, "0");
 
     parser.parse_check(argc, argv);
     const std::string in = parser.get<std::string>("input");
     const std::string out = parser.get<std::string>("output");
+    const bool inMemory = parser.get<bool>("in_memory");
+    const uint64_t reportInterval = parser.get<uint64_t>("report");
+    const std::string ckptFile = parser.get<std::string>("checkpoint");
+    const uint64_t ckptSeqs = parser.get<uint64_t>("ckpt_seqs");
+    const uint64_t ckptChars = parser.get<uint64_t>("ckpt_chars");
+    const bool resume = parser.get<bool>("resume");
+    const bool append = parser.get<bool>("append");
+    const std::string invertFile = parser.get<std::string>("invert");
+    const unsigned numThreads = parser.get<unsigned>("threads");
+    const std::string importFile = parser.get<std::string>("import");
+    const unsigned numShards = parser.get<unsigned>("shards");
+    const bool hugePages = parser.get<bool>("hugepages");
+    const bool arena = parser.get<bool>("arena") || hugePages;
+    const std::string statsFile = parser.get<std::string>("stats_file");
+    const std::string docPatFile = parser.get<std::string>("doc_patterns");
+    const uint64_t docRate = parser.get<uint64_t>("doc_rate");
+    const uint64_t topk = parser.get<uint64_t>("topk");
+    const bool trackDocs = !docPatFile.empty();
+    uint64_t expectedRuns = 0;
+    uint64_t inputLen = 0;
+    if (!getExpectedRuns(parser.get<std::string>("expected_runs"), in, expectedRuns, inputLen))
+    {
+        std::cerr << "exiting..." << std::endl;
+        exit(-1);
+    }
+    if ((resume || append || ckptSeqs || ckptChars) && (ckptFile.empty() || inMemory))
+    {
+        std::cerr << "Error: checkpointing requires --checkpoint and streaming mode. exiting..." << std::endl;
+        exit(-1);
+    }
+    BwtFormat format;
+    if (!parseBwtFormat(parser.get<std::string>("format"), format))
+    {
+        std::cerr << "Error: unknown output format " << parser.get<std::string>("format") << ". exiting..." << std::endl;
+        exit(-1);
+    }
+    BwtFormat importFormat;
+    if (!parseBwtFormat(parser.get<std::string>("import_format"), importFormat) || importFormat == BwtFormat::kHeadsLengths)
+    {
+        std::cerr << "Error: unsupported import format " << parser.get<std::string>("import_format") << ". exiting..." << std::endl;
+        exit(-1);
+    }
+    if (!importFile.empty() && (resume || append))
+    {
+        std::cerr << "Error: --import cannot be combined with --resume or --append. exiting..." << std::endl;
+        exit(-1);
+    }
+    if (trackDocs && !importFile.empty())
+    {
+        std::cerr << "Error: --doc_patterns cannot be combined with --import (imported sequences are not tracked). exiting..." << std::endl;
+        exit(-1);
+    }
+    if (numShards == 0 || (numShards > 1 && (!inMemory || !importFile.empty())))
+    {
+        std::cerr << "Error: --shards should be positive, and more than one shard requires --in_memory without --import. exiting..." << std::endl;
+        exit(-1);
+    }
+
+    StatsFormat statsFormat;
+    if (!parseStatsFormat(parser.get<std::string>("stats_format"), statsFormat))
+    {
+        std::cerr << "Error: unknown stats format " << parser.get<std::string>("stats_format") << ". exiting..." << std::endl;
+        exit(-1);
+    }
+    std::ofstream statsOfs;
+    if (!statsFile.empty())
+    {
+        statsOfs.open(statsFile, std::ios::out);
+        if (!statsOfs)
+        {
+            std::cerr << "Error: failed to open " << statsFile << ". exiting..." << std::endl;
+            exit(-1);
+        }
+    }
+    StatsEmitter statsEmitter((statsFile.empty()) ? std::cout : statsOfs, statsFormat);
+
+    if (arena)
+    {
+        NodeArena::getInstance().enable(hugePages);
+    }
 
     auto t1 = std::chrono::high_resolution_clock::now();
 
@@ -46,55 +158,272 @@ int main(int argc, char *argv[])
     using BtmNodeMT = BtmNodeM_StepCode<BTreeNodeT, 32>;
     using BtmMInfoT = BtmMInfo_BlockVec<BtmNodeMT, 512>;
     using BtmNodeST = BtmNodeS<BTreeNodeT, uint32_t, 8>;
-    using BtmSInfoT = BtmSInfo_BlockVec<BtmNodeST, 1024>;
+    using BtmSInfoT = BtmSInfo_SmallSigma<BtmNodeST, 1024>; // Direct access to separated trees for {A,C,G,T,N,\x01,\x00}.
     using RynRleT = DynRleForRlbwt<WBitsBlockVec<1024>, Samples_Null, BtmMInfoT, BtmSInfoT>;
     OnlineRlbwt<RynRleT> rlbwt(1);
+    if (!importFile.empty())
+    { // Runs are bulk-loaded in time linear in num of runs, and input sequences are appended to them.
+        std::ifstream ifs(importFile, std::ios::in | std::ios::binary);
+        std::vector<std::pair<uint8_t, uint64_t>> runs;
+        if (!ifs || !readBwtRuns(ifs, importFormat, runs))
+        {
+            std::cerr << "Error: failed to read BWT " << importFile << ". exiting..." << std::endl;
+            exit(-1);
+        }
+        // Drop terminating character 0 put by sptExtend(0) at the end, which gives BWT before it.
+        runs.erase(std::remove_if(runs.begin(), runs.end(), [](const std::pair<uint8_t, uint64_t> &run)
+                                  { return run.first == 0; }),
+                   runs.end());
+        rlbwt.bulkLoadCollection(runs.begin(), runs.end(), runs.size());
+        std::cout << "Imported BWT: len = " << rlbwt.getLenWithEndmarker() - 1 << ", runs = " << rlbwt.calcNumRuns() << std::endl;
+    }
 
-    std::vector<char> Text;
-    uint64_t n = 0, ns = 0;
+    auto reserveExpectedRuns = [&](OnlineRlbwt<RynRleT> &target, const uint64_t numRuns)
+    { // Runs already loaded (by --import or checkpoint) are added to the given hint.
+        if (numRuns)
+        {
+            target.reserve(target.calcNumRuns() + numRuns);
+        }
+    };
 
-    load_fasta(in, Text, n, ns);
-    auto start = std::chrono::steady_clock::now();
-    uint64_t cur_ns, cur_n = 0;
-    // std::cout << cur_ns;
-    for (unsigned char c : Text)
-    {
-        rlbwt.sptExtend(uint8_t(c));
-        cur_n++;
-        if (c == '\x01')
+    using AppendStatsT = OnlineRlbwt<RynRleT>::AppendStats;
+    HotCountersT shardCounters; // Counters of shards merged into "rlbwt".
+    std::vector<uint64_t> shardDocFps; // Fingerprints of sequences of shards in input order.
+    auto printProgress = [&](const AppendStatsT &stats)
+    {
+        HotCountersT counters = rlbwt.getCounters();
+        counters.add(shardCounters);
+        statsEmitter.emit(stats.numSeqs, stats.numChars, stats.numRuns, rlbwt.calcMemBytes(), rlbwt.calcMemBytesReserved(), stats.elapsedSec, counters);
+    };
+    if (inMemory)
+    {
+        std::vector<char> Text;
+        uint64_t n = 0, ns = 0;
+
+        load_fasta(in, Text, n, ns);
+        const uint8_t *text = reinterpret_cast<const uint8_t *>(Text.data());
+        if (numShards > 1)
+        { // Shards of whole sequences are built independently, merged, and bulk-loaded as if imported.
+            const uint8_t sep = static_cast<uint8_t>(rlbwt.getEm());
+            std::vector<size_t> bounds{0};
+            for (unsigned k = 1; k < numShards; ++k)
+            {
+                const size_t beg = std::max(bounds.back(), Text.size() / numShards * k);
+                const size_t end = static_cast<size_t>(std::find(text + beg, text + Text.size(), sep) - text);
+                bounds.push_back(end + (end < Text.size())); // include separator
+            }
+            bounds.push_back(Text.size());
+            using CharT = OnlineRlbwt<RynRleT>::CharT;
+            std::vector<StaticRleForRlbwt<CharT>> shards(numShards);
+            std::vector<HotCountersT> countersOfShards(numShards);
+            std::vector<std::vector<uint64_t>> docFpsOfShards(numShards);
+            std::vector<std::thread> builders;
+            for (unsigned k = 0; k < numShards; ++k)
+            {
+                builders.emplace_back([&, k]()
+                                      {
+                                          if (bounds[k] == bounds[k + 1])
+                                          {
+                                              return;
+                                          }
+                                          OnlineRlbwt<RynRleT> shard(1);
+                                          reserveExpectedRuns(shard, (expectedRuns) ? expectedRuns / numShards + 1 : 0);
+                                          if (trackDocs)
+                                          {
+                                              shard.enableDocTracking();
+                                          }
+                                          shard.appendCollection(text + bounds[k], bounds[k + 1] - bounds[k], [](const AppendStatsT &) {}, 0);
+                                          shards[k] = shard.freeze().getRle();
+                                          countersOfShards[k] = shard.getCounters();
+                                          docFpsOfShards[k] = shard.getDocFingerprints(); });
+            }
+            for (auto &builder : builders)
+            {
+                builder.join();
+            }
+            for (unsigned k = 0; k < numShards; ++k)
+            {
+                shardCounters.add(countersOfShards[k]);
+                shardDocFps.insert(shardDocFps.end(), docFpsOfShards[k].begin(), docFpsOfShards[k].end());
+            }
+            const auto tShards = std::chrono::high_resolution_clock::now();
+            std::cout << "Built " << numShards << " shards. " << std::chrono::duration<double>(tShards - t1).count() << " sec" << std::endl;
+            std::vector<std::pair<CharT, uint64_t>> runs;
+            mergeShards(shards, sep, runs, numThreads);
+            std::cout << "Merged shards. " << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tShards).count() << " sec" << std::endl;
+            rlbwt.bulkLoadCollection(runs.begin(), runs.end(), runs.size());
+            printProgress(AppendStatsT{ns, Text.size(), rlbwt.calcNumRuns(), std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t1).count()});
+        }
+        else
         {
-            cur_ns++;
-            // std::cout << cur_ns;
-            if (cur_ns % 10000 == 0)
+            if (trackDocs)
             {
-                auto end = std::chrono::steady_clock::now();
-                std::cout << "===================extend over=======================" << std::endl;
-                std::cout << "cur_ns:" << cur_ns << "  cur_n:" << cur_n << std::endl;
-                std::cout << "Elapsed time in seconds: "
-                          << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
-                          << " milliseconds" << std::endl;
-
-                // start = std::chrono::steady_clock::now();
-                // break;
+                rlbwt.enableDocTracking();
             }
+            reserveExpectedRuns(rlbwt, expectedRuns);
+            rlbwt.appendCollection(text, Text.size(), printProgress, reportInterval);
+        }
+    }
+    else
+    { // Only the current record (reversed) is held in memory.
+        const auto start = std::chrono::steady_clock::now();
+        AppendStatsT stats{0, 0, 0, 0.0};
+        auto report = [&]()
+        {
+            stats.numRuns = rlbwt.calcNumRuns();
+            stats.elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printProgress(stats);
+        };
+        SeqFileReader reader(in, static_cast<uint8_t>(rlbwt.getEm()));
+        if (resume || append)
+        { // Checkpoint consists of input offset (num of sequences and characters) and OnlineRlbwt.
+            serialutil::MappedFile mf;
+            bool ok = mf.open(ckptFile);
+            if (ok)
+            {
+                serialutil::MemStreamBuf buf(mf.data(), mf.size());
+                std::istream is(&buf);
+                ok = serialutil::readHeader(is, kCkptMagic, kCkptVersion) &&
+                     serialutil::readVal(is, stats.numSeqs) &&
+                     serialutil::readVal(is, stats.numChars) &&
+                     rlbwt.load(is);
+            }
+            if (!ok)
+            {
+                std::cerr << "Error: failed to load checkpoint " << ckptFile << ". exiting..." << std::endl;
+                exit(-1);
+            }
+            std::cout << "Loaded checkpoint: cur_ns:" << stats.numSeqs << "  cur_n:" << stats.numChars << std::endl;
+            if (resume)
+            {
+                reader.setNumSkip(stats.numSeqs);
+            }
+        }
+        reserveExpectedRuns(rlbwt, expectedRuns);
+        if (trackDocs)
+        { // Sequences of checkpoint written without tracking make the tracking incomplete, which is checked later.
+            rlbwt.enableDocTracking();
+        }
+        uint64_t lastCkptChars = stats.numChars;
+        auto writeCheckpoint = [&]()
+        {
+            const bool ok = serialutil::writeFileAtomically(ckptFile, [&](std::ostream &os)
+                                                            {
+                                                                serialutil::writeHeader(os, kCkptMagic, kCkptVersion);
+                                                                serialutil::writeVal(os, stats.numSeqs);
+                                                                serialutil::writeVal(os, stats.numChars);
+                                                                rlbwt.serialize(os); });
+            if (!ok)
+            {
+                std::cerr << "Warning: failed to write checkpoint " << ckptFile << std::endl;
+            }
+            lastCkptChars = stats.numChars;
+        };
+        reader.forEachReversedSeq([&](const uint8_t *seq, size_t len)
+                                  {
+                                      stats.numSeqs += rlbwt.appendString(seq, len);
+                                      stats.numChars += len;
+                                      if (reportInterval && stats.numSeqs % reportInterval == 0)
+                                      {
+                                          report();
+                                      }
+                                      if ((ckptSeqs && stats.numSeqs % ckptSeqs == 0) ||
+                                          (ckptChars && stats.numChars - lastCkptChars >= ckptChars))
+                                      {
+                                          writeCheckpoint();
+                                      } });
+        report();
+        if (!ckptFile.empty())
+        {
+            writeCheckpoint();
         }
     }
-    auto end = std::chrono::steady_clock::now();
-    std::cout << "===================extend over=======================" << std::endl;
-    std::cout << "cur_ns:" << cur_ns << "  cur_n:" << cur_n << std::endl;
-    std::cout << "Elapsed time in seconds: "
-              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
-              << " milliseconds" << std::endl;
     rlbwt.printStatistics(std::cout, true);
+    const bool docsComplete = (numShards > 1) ? shardDocFps.size() == rlbwt.getNumSeqs() : rlbwt.isDocTrackingComplete();
+    if (trackDocs && !docsComplete)
+    {
+        std::cerr << "Error: not all sequences are tracked for --doc_patterns (e.g., checkpoint written without it). exiting..." << std::endl;
+        exit(-1);
+    }
+    if (!out.empty() || !invertFile.empty() || trackDocs)
+    {
+        rlbwt.sptExtend(0);
+    }
     // 判断输出文件是否被提供
     if (!(out.empty()))
     {
-        std::ofstream ofs(out, std::ios::out);
-        rlbwt.sptExtend(0);
         // rlbwt.printDetailInfo();
-        rlbwt.writeBWT(ofs);
+        if (format == BwtFormat::kHeadsLengths)
+        {
+            std::ofstream ofsHeads(out + ".heads", std::ios::out | std::ios::binary);
+            std::ofstream ofsLens(out + ".len", std::ios::out | std::ios::binary);
+            if (!rlbwt.writeBWTHeadsLengths(ofsHeads, ofsLens))
+            {
+                std::cerr << "Error: some run is too long for 5-byte run lengths of " << out << ".len. exiting..." << std::endl;
+                exit(-1);
+            }
+        }
+        else
+        {
+            std::ofstream ofs(out, std::ios::out | std::ios::binary);
+            rlbwt.writeBWT(ofs, format);
+        }
         auto t2 = std::chrono::high_resolution_clock::now();
         double sec = std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
         std::cout << "RLBWT write done. " << sec << " sec" << std::endl;
     }
-}
\ No newline at end of file
+    decltype(rlbwt.freeze()) srlbwt;
+    if (!invertFile.empty() || trackDocs)
+    {
+        srlbwt = rlbwt.freeze();
+    }
+    if (!invertFile.empty())
+    { // Each sequence is decoded from the row of its separator, independently of the others.
+        const auto t3 = std::chrono::high_resolution_clock::now();
+        std::ofstream ofs(invertFile, std::ios::out | std::ios::binary);
+        const uint64_t numSeqs = invertCollection(srlbwt.getRle(), rlbwt.getEm(), ofs, numThreads);
+        auto t4 = std::chrono::high_resolution_clock::now();
+        double sec = std::chrono::duration_cast<std::chrono::seconds>(t4 - t3).count();
+        std::cout << "Inversion of " << numSeqs << " sequences done. " << sec << " sec" << std::endl;
+    }
+    if (trackDocs)
+    { // Each line of results: pattern, num of occurrences, num of sequences, and top-k "ID:occurrences".
+        const auto t5 = std::chrono::high_resolution_clock::now();
+        const auto &srle = srlbwt.getRle();
+        DocArray docs;
+        if (!docs.build(srle, rlbwt.getEm(), (numShards > 1) ? shardDocFps : rlbwt.getDocFingerprints(), numThreads, docRate))
+        {
+            exit(-1);
+        }
+        const auto t6 = std::chrono::high_resolution_clock::now();
+        std::cout << "Document array of " << docs.getNumDocs() << " sequences built. " << std::chrono::duration<double>(t6 - t5).count()
+                  << " sec, " << docs.calcMemBytes() << " bytes" << std::endl;
+        std::ifstream ifs(docPatFile);
+        if (!ifs)
+        {
+            std::cerr << "Error: failed to open " << docPatFile << ". exiting..." << std::endl;
+            exit(-1);
+        }
+        std::string pat;
+        uint64_t numPats = 0;
+        std::vector<std::pair<uint32_t, uint64_t>> docCounts;
+        while (std::getline(ifs, pat))
+        {
+            if (pat.empty())
+            {
+                continue;
+            }
+            const auto intvl = DocArray::calcBwtIntvl(srle, pat);
+            const uint64_t numDocs = docs.listTopDocs(srle, intvl.first, intvl.second, topk, docCounts);
+            std::cout << pat << "\t" << intvl.second - intvl.first << "\t" << numDocs << "\t";
+            for (uint64_t i = 0; i < docCounts.size(); ++i)
+            {
+                std::cout << ((i) ? "," : "") << docCounts[i].first << ":" << docCounts[i].second;
+            }
+            std::cout << std::endl;
+            ++numPats;
+        }
+        std::cout << "Document listing of " << numPats << " patterns done. "
+                  << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t6).count() << " sec" << std::endl;
+    }
+}